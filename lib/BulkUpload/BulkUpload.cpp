@@ -0,0 +1,114 @@
+#include "BulkUpload.h"
+#include <time.h>
+
+size_t BufferedPrint::write(const uint8_t *data, size_t size)
+{
+  for (size_t i = 0; i < size; i++)
+  {
+    if (used == sizeof(buffer))
+      send();
+    buffer[used++] = data[i];
+  }
+  return size;
+}
+
+bool BufferedPrint::send()
+{
+  if (used && out.write(buffer, used) != used)
+    failed = true;
+  sent += used;
+  used = 0;
+  return !failed;
+}
+
+static void formatCreatedAt(time_t time, char *stamp, size_t size) // the time ThingSpeak files a reading under
+{
+  struct tm utc;
+  gmtime_r(&time, &utc);
+  strftime(stamp, size, "%Y-%m-%d %H:%M:%S +0000", &utc);
+}
+
+BulkBatch writeBulkJson(Print &out, FlashLog &log, const char *apiKey, uint32_t from, uint32_t defaultDeltaT)
+{
+  out.print("{\"write_api_key\":\"");
+  out.print(apiKey);
+  out.print("\",\"updates\":[");
+
+  FlashLogReader reader(log, from);
+  LogEntry entry;
+  LogEntry previous;
+  BulkBatch batch = {from, 0, false};
+  uint32_t start = 0; // of the boot of entry
+  char stamp[32];
+  char item[80];
+  while (batch.entries < BULK_MAX_ENTRIES && reader.next(entry))
+  {
+    bool newBoot = batch.entries == 0 || entry.boot != previous.boot;
+    if (newBoot)
+      start = log.bootStart(entry.boot);
+    if (batch.entries && newBoot && (batch.relative || start == 0))
+      break; // the next batch starts with this entry
+    int length;
+    if (start)
+    {
+      formatCreatedAt(start + entry.seconds, stamp, sizeof(stamp));
+      length = snprintf(item, sizeof(item), "%s{\"created_at\":\"%s\",\"field1\":%lu}", batch.entries ? "," : "",
+                        stamp, (unsigned long)entry.cpm);
+    }
+    else
+    {
+      uint32_t deltaT = defaultDeltaT;
+      if (batch.entries && entry.seconds > previous.seconds)
+        deltaT = entry.seconds - previous.seconds;
+      length = snprintf(item, sizeof(item), "%s{\"delta_t\":%lu,\"field1\":%lu}", batch.entries ? "," : "",
+                        (unsigned long)deltaT, (unsigned long)entry.cpm);
+      batch.relative = true;
+    }
+    out.write((const uint8_t *)item, length);
+    previous = entry;
+    batch.end = entry.seq + 1;
+    batch.entries++;
+  }
+  out.print("]}");
+  return batch;
+}
+
+size_t writeOutboxJson(char *out, size_t size, const char *apiKey, const char *field, const OutboxEntry *entries,
+                       uint16_t count, uint16_t &used)
+{
+  used = 0;
+  int length = snprintf(out, size, "{\"write_api_key\":\"%s\",\"updates\":[", apiKey);
+  if (length < 0 || (size_t)length >= size)
+    return 0;
+  bool first = true;
+  char item[80];
+  for (; used < count; used++)
+  {
+    if (entries[used].time == 0)
+      continue;
+    char stamp[32];
+    formatCreatedAt(entries[used].time, stamp, sizeof(stamp));
+    int itemLength = snprintf(item, sizeof(item), "%s{\"created_at\":\"%s\",\"%s\":%lu}", first ? "" : ",", stamp,
+                              field, (unsigned long)entries[used].value);
+    if (length + itemLength + 2 >= (int)size)
+      break; // the rest goes with the next request
+    memcpy(out + length, item, itemLength);
+    length += itemLength;
+    first = false;
+  }
+  if (used == 0)
+    return 0;
+  memcpy(out + length, "]}", 3);
+  return length + 2;
+}
+
+int readHttpStatus(Stream &response)
+{
+  char line[48];
+  size_t length = response.readBytesUntil('\n', line, sizeof(line) - 1);
+  line[length] = 0;
+  int status = 0;
+  if (sscanf(line, "HTTP/%*d.%*d %d", &status) != 1)
+    return 0;
+  return status;
+}
@@ -0,0 +1,68 @@
+/*  Streaming ThingSpeak bulk update
+    writeBulkJson() reads log entries one at a time and prints the bulk_update.json body straight to a Print, so the
+    upload needs a few hundred bytes of RAM however much is logged. Run it into a CountingPrint first for the
+    Content-Length, then into a BufferedPrint around the WiFiClient: the same arguments give the same bytes.
+    Entries of a boot with a start time in the log are sent with created_at. ThingSpeak dates the last entry of a
+    delta_t batch at the time it receives it, which puts an old batch hours or days late, so delta_t is only the
+    fallback for a boot that never had the clock, e.g. logging in the field: such a boot goes in batches of its own
+    and is still uploaded, placed as if it had just ended.
+*/
+#ifndef BULK_UPLOAD_H
+#define BULK_UPLOAD_H
+
+#include <Arduino.h>
+#include <FlashLog.h>
+#include <Outbox.h>
+
+#define BULK_MAX_ENTRIES 960      // ThingSpeak takes at most this many messages in one bulk update
+#define BULK_BUFFER_BYTES 256     // one TCP write per this many bytes instead of one per JSON field
+#define BULK_BATCH_MILLIS 15000   // ThingSpeak accepts one update per channel every 15 s on a free account
+
+class CountingPrint : public Print // measures what would be printed
+{
+public:
+  using Print::write;
+  size_t write(uint8_t) { count++; return 1; }
+  size_t write(const uint8_t *, size_t size) { count += size; return size; }
+
+  uint32_t count = 0;
+};
+
+class BufferedPrint : public Print
+{
+public:
+  BufferedPrint(Print &out) : out(out) {}
+  using Print::write;
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *data, size_t size);
+  bool send();                    // pass on what is buffered, false if any write came up short
+  uint32_t total() const { return sent + used; }
+
+private:
+  Print &out;
+  uint8_t buffer[BULK_BUFFER_BYTES];
+  uint16_t used = 0;
+  uint32_t sent = 0;
+  bool failed = false;
+};
+
+struct BulkBatch
+{
+  uint32_t end;      // seq after the last entry printed, where the next upload starts
+  uint16_t entries;  // nothing more to send when 0
+  bool relative;     // delta_t, the boot has no start time
+};
+
+// prints {"write_api_key":...,"updates":[...]} with the entries from seq on, at most BULK_MAX_ENTRIES. A batch
+// ends before a boot without a start time and after the last entry of one, so it is either all created_at or all
+// delta_t of a single boot. defaultDeltaT is for the first entry of a delta_t batch
+BulkBatch writeBulkJson(Print &out, FlashLog &log, const char *apiKey, uint32_t from, uint32_t defaultDeltaT);
+
+// the same with absolute times, for readings from the outbox. Entries with time 0 can't be placed and are left out.
+// Writes into out, returns the length and in used how many entries it covers, 0 if not even one fitted
+size_t writeOutboxJson(char *out, size_t size, const char *apiKey, const char *field, const OutboxEntry *entries,
+                       uint16_t count, uint16_t &used);
+
+int readHttpStatus(Stream &response); // status code from the response line, 0 if none came before the stream's timeout
+
+#endif
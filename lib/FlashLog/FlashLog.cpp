@@ -0,0 +1,299 @@
+#include "FlashLog.h"
+
+#define FLASH_LOG_SENT "/log/sent"
+#define FLASH_LOG_BOOTS "/log/boots"   // FLASH_LOG_BOOT_SLOTS records of boot, start and a check word
+
+void FlashLog::segmentPath(uint8_t segment, char *path)
+{
+  snprintf(path, 16, "/log/seg%u", segment);
+}
+
+int8_t FlashLog::readBlock(File &file, LogBlockHeader &header, LogSample *samples)
+{
+  uint8_t payload[LOG_BLOCK_MAX_PAYLOAD];
+  if (file.read((uint8_t *)&header, sizeof(header)) != sizeof(header))
+    return 0;
+  uint16_t bytes = logBlockPayload(header);
+  if (bytes == 0 || file.read(payload, bytes) != bytes)
+    return 0; // nothing sane after this point, the length of the block is unknown
+  if (!logBlockCrcValid(header, payload) || decodeLogBlock(header, payload, samples) != header.count)
+    return -1;
+  return 1;
+}
+
+bool FlashLog::begin()
+{
+  mounted = LittleFS.begin(); // formats the partition on first use
+  if (!mounted)
+    return false;
+  LittleFS.mkdir("/log");
+
+  char path[16];
+  LogBlockHeader header;
+  bool found = false;
+  for (uint8_t s = 0; s < FLASH_LOG_SEGMENTS; s++)
+  {
+    segmentFirst[s] = UINT32_MAX;
+    segmentPath(s, path);
+    File file = LittleFS.open(path, "r");
+    if (!file)
+      continue;
+    if (readBlock(file, header, buffer) == 1)
+    {
+      segmentFirst[s] = header.firstSeq;
+      if (!found || header.firstSeq > segmentFirst[current])
+        current = s;
+      found = true;
+    }
+    file.close();
+  }
+  if (found)
+    scanSegment(current); // the newest segment, its last block tells where the log goes on
+  while (bootStart(boot))
+    boot++; // an earlier boot that logged nothing filed its start under this number
+
+  File file = LittleFS.open(FLASH_LOG_SENT, "r");
+  if (file)
+  {
+    uint32_t saved[2];
+    if (file.read((uint8_t *)saved, sizeof(saved)) == sizeof(saved) && saved[1] == ~saved[0])
+      sentSeq = saved[0];
+    file.close();
+  }
+  return true;
+}
+
+void FlashLog::scanSegment(uint8_t segment)
+{
+  char path[16];
+  segmentPath(segment, path);
+  File file = LittleFS.open(path, "r");
+  LogBlockHeader header;
+  uint32_t validBytes = 0;
+  int8_t result;
+  while ((result = readBlock(file, header, buffer)) != 0)
+  {
+    if (result == 1)
+    {
+      nextSeq = header.firstSeq + header.count;
+      boot = header.boot + 1;
+    }
+    validBytes = file.position(); // a block with a bad CRC still has a sane length, keep what follows it
+  }
+  uint32_t size = file.size();
+  file.close();
+  if (size > validBytes)
+  {
+    file = LittleFS.open(path, "r+"); // cut off a torn or garbage tail so appends follow a good block
+    file.truncate(validBytes);
+    file.close();
+  }
+  currentBytes = validBytes;
+}
+
+void FlashLog::append(uint32_t seconds, uint32_t cpm)
+{
+  if (buffered == LOG_BLOCK_RECORDS)
+    return; // the last flush failed, keep the older entries
+  buffer[buffered].seconds = seconds;
+  buffer[buffered].cpm = cpm;
+  buffered++;
+  if (buffered == LOG_BLOCK_RECORDS)
+    flush();
+}
+
+bool FlashLog::flush()
+{
+  if (buffered == 0)
+    return true;
+  if (!mounted)
+    return false;
+
+  LogBlockHeader header;
+  header.count = buffered;
+  header.boot = boot;
+  header.firstSeq = nextSeq;
+  uint8_t payload[LOG_BLOCK_MAX_PAYLOAD];
+  encodeLogBlock(header, buffer, payload);
+  size_t bytes = header.bytes;
+
+  char path[16];
+  if (currentBytes + sizeof(header) + bytes > FLASH_LOG_SEGMENT_BYTES)
+  {
+    current = (current + 1) % FLASH_LOG_SEGMENTS; // reuse the oldest segment
+    segmentPath(current, path);
+    LittleFS.remove(path);
+    segmentFirst[current] = UINT32_MAX;
+    currentBytes = 0;
+  }
+  segmentPath(current, path);
+  File file = LittleFS.open(path, "a");
+  if (!file)
+    return false;
+  bool written = file.write((uint8_t *)&header, sizeof(header)) == sizeof(header) && file.write(payload, bytes) == bytes;
+  if (!written)
+    file.truncate(currentBytes); // filesystem full or failing, try again with the next block
+  file.close();
+  if (!written)
+    return false;
+
+  if (segmentFirst[current] == UINT32_MAX)
+    segmentFirst[current] = nextSeq;
+  currentBytes += sizeof(header) + bytes;
+  nextSeq += buffered;
+  buffered = 0;
+  return true;
+}
+
+void FlashLog::startBoot()
+{
+  flush();
+  boot++;
+  while (bootStart(boot))
+    boot++;
+  bootStarted = false;
+}
+
+void FlashLog::setBootStart(uint32_t time)
+{
+  if (bootStarted || !mounted)
+    return;
+  File file = LittleFS.open(FLASH_LOG_BOOTS, "r+");
+  if (!file)
+  {
+    file = LittleFS.open(FLASH_LOG_BOOTS, "w"); // all slots at once, an empty one fails its check
+    uint32_t empty[3] = {0, 0, 0};
+    for (uint8_t s = 0; file && s < FLASH_LOG_BOOT_SLOTS; s++)
+      file.write((uint8_t *)empty, sizeof(empty));
+  }
+  if (!file)
+    return;
+  uint32_t record[3] = {boot, time, ~(boot ^ time)};
+  bootStarted = file.seek(boot % FLASH_LOG_BOOT_SLOTS * sizeof(record)) &&
+                file.write((uint8_t *)record, sizeof(record)) == sizeof(record);
+  file.close();
+}
+
+uint32_t FlashLog::bootStart(uint16_t boot) const
+{
+  File file = LittleFS.open(FLASH_LOG_BOOTS, "r");
+  if (!file)
+    return 0;
+  uint32_t record[3];
+  bool found = file.seek(boot % FLASH_LOG_BOOT_SLOTS * sizeof(record)) &&
+               file.read((uint8_t *)record, sizeof(record)) == sizeof(record) && record[0] == boot &&
+               record[2] == ~(record[0] ^ record[1]);
+  file.close();
+  return found ? record[1] : 0;
+}
+
+void FlashLog::clear()
+{
+  char path[16];
+  for (uint8_t s = 0; s < FLASH_LOG_SEGMENTS; s++)
+  {
+    segmentPath(s, path);
+    LittleFS.remove(path);
+    segmentFirst[s] = UINT32_MAX;
+  }
+  LittleFS.remove(FLASH_LOG_SENT);
+  LittleFS.remove(FLASH_LOG_BOOTS);
+  bootStarted = false;
+  current = 0;
+  currentBytes = 0;
+  nextSeq = 0;
+  sentSeq = 0;
+  buffered = 0;
+}
+
+uint32_t FlashLog::oldest() const
+{
+  uint32_t first = nextSeq;
+  for (uint8_t s = 0; s < FLASH_LOG_SEGMENTS; s++)
+    if (segmentFirst[s] < first)
+      first = segmentFirst[s];
+  return first;
+}
+
+uint32_t FlashLog::pending() const
+{
+  uint32_t from = sentSeq > oldest() ? sentSeq : oldest(); // overwritten entries are gone, sent or not
+  return end() > from ? end() - from : 0;
+}
+
+void FlashLog::markSent(uint32_t seq)
+{
+  sentSeq = seq;
+  uint32_t saved[2] = {seq, ~seq};
+  File file = LittleFS.open(FLASH_LOG_SENT, "w");
+  if (!file)
+    return;
+  file.write((uint8_t *)saved, sizeof(saved));
+  file.close();
+}
+
+FlashLogReader::FlashLogReader(FlashLog &log, uint32_t fromSeq) : log(log), fromSeq(fromSeq)
+{
+  for (uint8_t s = 0; s < FLASH_LOG_SEGMENTS; s++) // sort the segments in use by their first entry
+  {
+    if (log.segmentFirst[s] == UINT32_MAX)
+      continue;
+    uint8_t i = segmentCount++;
+    while (i > 0 && log.segmentFirst[order[i - 1]] > log.segmentFirst[s])
+    {
+      order[i] = order[i - 1];
+      i--;
+    }
+    order[i] = s;
+  }
+  while (nextSegment + 1 < segmentCount && log.segmentFirst[order[nextSegment + 1]] <= fromSeq)
+    nextSegment++; // fromSeq is beyond this segment
+}
+
+bool FlashLogReader::openNext()
+{
+  char path[16];
+  while (nextSegment < segmentCount)
+  {
+    FlashLog::segmentPath(order[nextSegment++], path);
+    file = LittleFS.open(path, "r");
+    if (file)
+      return true;
+  }
+  return false;
+}
+
+bool FlashLogReader::next(LogEntry &entry)
+{
+  while (true)
+  {
+    if (haveBlock && position < header.count)
+    {
+      uint32_t seq = header.firstSeq + position;
+      LogSample &sample = samples[position++];
+      if (seq < fromSeq)
+        continue;
+      entry.seq = seq;
+      entry.boot = header.boot;
+      entry.seconds = sample.seconds;
+      entry.cpm = sample.cpm;
+      return true;
+    }
+    haveBlock = false;
+    if (file)
+    {
+      int8_t result = FlashLog::readBlock(file, header, samples);
+      if (result == 1)
+      {
+        haveBlock = true;
+        position = 0;
+        continue;
+      }
+      if (result < 0)
+        continue; // bad block, its entries are skipped
+      file.close();
+    }
+    if (!openNext())
+      return false;
+  }
+}
@@ -0,0 +1,87 @@
+/*  Append-only measurement log on LittleFS
+    Entries are collected in RAM and written a block at a time, one flash write per LOG_BLOCK_RECORDS entries.
+    Blocks are delta/varint packed (see LogBlock.h) and carry a CRC-32, a bad block is skipped when reading. The log is a ring of segment files: when the
+    newest is full the oldest is emptied and reused, so the oldest data is overwritten instead of logging stopping.
+    Entries are numbered from the first one ever written; the uploader keeps its place with markSent().
+    Entry times are uptime, which restarts on every boot. Once SNTP has set the clock, setBootStart() files the UTC
+    time of the current boot's start, so its entries can be dated later; a boot that never saw the clock has none.
+*/
+#ifndef FLASH_LOG_H
+#define FLASH_LOG_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <LogBlock.h>
+
+#define FLASH_LOG_SEGMENTS 8            // 8 x 64 KB, over 100 days of one minute entries at background rates
+#define FLASH_LOG_SEGMENT_BYTES 65536   // a block of LOG_BLOCK_RECORDS is a quarter hour, lost at most on a power cut
+#define FLASH_LOG_BOOT_SLOTS 64         // boot start times kept, by boot number modulo this
+
+struct LogEntry
+{
+  uint32_t seq;      // position in the log since it was created
+  uint16_t boot;     // seconds restart from zero on every boot
+  uint32_t seconds;  // uptime at the end of the logged interval
+  uint32_t cpm;
+};
+
+class FlashLog
+{
+public:
+  bool begin();                               // mounts the filesystem and finds the end of the log
+  void append(uint32_t seconds, uint32_t cpm);
+  bool flush();                               // write buffered entries now, e.g. before a reset
+  void startBoot();                           // entries from here on belong to a new boot, e.g. after importing old data
+  void clear();
+
+  uint32_t oldest() const;                    // seq of the oldest entry still stored
+  uint32_t end() const { return nextSeq + buffered; } // seq the next entry will get
+  uint16_t currentBoot() const { return boot; } // boot of the entries appended now
+  void setBootStart(uint32_t time);           // UTC seconds at uptime 0 of the current boot, written once per boot
+  uint32_t bootStart(uint16_t boot) const;    // 0 if that boot never had the clock
+  uint32_t sent() const { return sentSeq; }
+  uint32_t pending() const;                   // entries not yet marked as sent
+  void markSent(uint32_t seq);                // everything before seq has been uploaded
+
+private:
+  friend class FlashLogReader;
+
+  static int8_t readBlock(File &file, LogBlockHeader &header, LogSample *samples); // 1 good, -1 bad CRC, 0 end of data
+  static void segmentPath(uint8_t segment, char *path);
+  void scanSegment(uint8_t segment);
+
+  bool mounted = false;
+  uint8_t current = 0;                        // segment being appended to
+  uint32_t currentBytes = 0;
+  uint32_t segmentFirst[FLASH_LOG_SEGMENTS];  // first seq of each segment, UINT32_MAX when empty
+  uint32_t nextSeq = 0;                       // seq of the first buffered entry
+  uint32_t sentSeq = 0;
+  uint16_t boot = 0;
+  bool bootStarted = false;                   // setBootStart() was done for this boot
+  LogSample buffer[LOG_BLOCK_RECORDS];
+  uint8_t buffered = 0;
+};
+
+class FlashLogReader // walks the stored entries oldest first, call flush() before if the newest matter
+{
+public:
+  FlashLogReader(FlashLog &log, uint32_t fromSeq);
+  ~FlashLogReader() { file.close(); }
+  bool next(LogEntry &entry);
+
+private:
+  bool openNext();
+
+  FlashLog &log;
+  uint32_t fromSeq;
+  uint8_t order[FLASH_LOG_SEGMENTS];          // segments by first seq
+  uint8_t segmentCount = 0;
+  uint8_t nextSegment = 0;
+  File file;
+  LogBlockHeader header;
+  LogSample samples[LOG_BLOCK_RECORDS];
+  uint8_t position = 0;                       // next record in the block
+  bool haveBlock = false;
+};
+
+#endif
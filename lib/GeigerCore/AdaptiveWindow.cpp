@@ -0,0 +1,61 @@
+#include "AdaptiveWindow.h"
+#include <math.h>
+
+#define RATE_RATIO 2.0f   // size of the change the test is tuned for
+#define THRESHOLD 8.0f    // CUSUM decision level, about one false alarm in five hours at background
+#define MIN_RATE 0.05f    // counts per second, keeps the test defined with an empty window
+
+void AdaptiveWindow::update(const BinHistory &history)
+{
+  detected = false;
+  if (history.filled() < 2)
+    return;
+
+  uint16_t reference = window;
+  if (reference > history.filled() - 1)
+    reference = history.filled() - 1;
+  float rate = float(history.sum(reference + 1) - history.bin(0)) / reference; // mean rate before the newest bin
+  if (rate < MIN_RATE)
+    rate = MIN_RATE;
+  float x = history.bin(0);
+
+  // log-likelihood ratio of rate * RATE_RATIO (up) and rate / RATE_RATIO (down) against the current rate
+  upSum += x * logf(RATE_RATIO) - rate * (RATE_RATIO - 1.0f);
+  downSum += rate * (1.0f - 1.0f / RATE_RATIO) - x * logf(RATE_RATIO);
+
+  if (upSum > 0)
+    upRun++;
+  else
+  {
+    upSum = 0;
+    upRun = 0;
+  }
+  if (downSum > 0)
+    downRun++;
+  else
+  {
+    downSum = 0;
+    downRun = 0;
+  }
+
+  if (upSum > THRESHOLD || downSum > THRESHOLD)
+  {
+    uint16_t run = (upSum > THRESHOLD) ? upRun : downRun;
+    window = run < ADAPTIVE_MIN_SECONDS ? ADAPTIVE_MIN_SECONDS : run; // keep only the bins after the change
+    upSum = downSum = 0;
+    upRun = downRun = 0;
+    detected = true;
+  }
+  else if (window < ADAPTIVE_MAX_SECONDS)
+  {
+    window++;
+  }
+}
+
+void AdaptiveWindow::reset()
+{
+  window = ADAPTIVE_MIN_SECONDS;
+  upSum = downSum = 0;
+  upRun = downRun = 0;
+  detected = false;
+}
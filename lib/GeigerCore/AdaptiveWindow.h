@@ -0,0 +1,33 @@
+/*  Adaptive integration window
+    Runs a two-sided Poisson CUSUM test on the per-second bins. While the rate is stable the window widens by one
+    second per bin up to ADAPTIVE_MAX_SECONDS. When the rate is found to have doubled or halved, the window
+    shrinks to the bins collected since the change began, so the reading follows the new level within seconds.
+*/
+#ifndef ADAPTIVE_WINDOW_H
+#define ADAPTIVE_WINDOW_H
+
+#include <stdint.h>
+#include "BinHistory.h"
+
+#define ADAPTIVE_MIN_SECONDS 5
+#define ADAPTIVE_MAX_SECONDS 180
+
+class AdaptiveWindow
+{
+public:
+  void update(const BinHistory &history); // call once after every bin added to the history
+  void reset();
+
+  uint16_t seconds() const { return window; }
+  bool changeDetected() const { return detected; } // true if the last update found a rate change
+
+private:
+  uint16_t window = ADAPTIVE_MIN_SECONDS;
+  float upSum = 0;       // log-likelihood CUSUM for a rate increase
+  float downSum = 0;     // and for a decrease
+  uint16_t upRun = 0;    // bins since upSum was last zero, estimates when the change started
+  uint16_t downRun = 0;
+  bool detected = false;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#include "BinHistory.h"
+
+#define RING_SIZE (BIN_HISTORY_SECONDS + 1)
+
+void BinHistory::add(uint32_t counts)
+{
+  uint32_t total = runningTotal[newest] + counts;
+  newest++;
+  if (newest == RING_SIZE)
+    newest = 0;
+  runningTotal[newest] = total;
+  if (filledBins < BIN_HISTORY_SECONDS)
+    filledBins++;
+}
+
+uint32_t BinHistory::sum(uint16_t seconds) const
+{
+  if (seconds > filledBins)
+    seconds = filledBins;
+  uint16_t oldest = (newest >= seconds) ? newest - seconds : newest + RING_SIZE - seconds;
+  return runningTotal[newest] - runningTotal[oldest];
+}
+
+uint32_t BinHistory::cpm(uint16_t seconds) const
+{
+  if (seconds > filledBins)
+    seconds = filledBins; // average over what has been collected so far instead of reading low during warm-up
+  if (seconds == 0)
+    return 0;
+  return (uint64_t)sum(seconds) * 60 / seconds;
+}
+
+uint32_t BinHistory::bin(uint16_t age) const
+{
+  if (age >= filledBins)
+    return 0;
+  return sum(age + 1) - sum(age);
+}
+
+void BinHistory::reset()
+{
+  runningTotal[0] = 0;
+  newest = 0;
+  filledBins = 0;
+}
@@ -0,0 +1,31 @@
+/*  Per-second count history
+    One ring of running totals, one entry per closed 1 second bin. The number of counts in any window up to
+    BIN_HISTORY_SECONDS long is the difference of two entries, so every integration time is read in O(1) and
+    switching between them never throws history away.
+*/
+#ifndef BIN_HISTORY_H
+#define BIN_HISTORY_H
+
+#include <stdint.h>
+
+#define BIN_HISTORY_SECONDS 3600 // longest window that can be read back (1 hour)
+
+class BinHistory
+{
+public:
+  BinHistory() { reset(); }
+
+  void add(uint32_t counts);               // close one 1 second bin
+  uint32_t sum(uint16_t seconds) const;    // counts in the most recent bins, window clamped to filled()
+  uint32_t cpm(uint16_t seconds) const;    // average counts per minute over the window
+  uint32_t bin(uint16_t age) const;        // counts in a single bin, 0 = most recent
+  uint16_t filled() const { return filledBins; }
+  void reset();
+
+private:
+  uint32_t runningTotal[BIN_HISTORY_SECONDS + 1]; // total counts after each bin, wraps harmlessly
+  uint16_t newest;
+  uint16_t filledBins;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "DeadTime.h"
+#include "DoseMath.h"
+#include <string.h>
+
+#define SATURATION_ENTER 850   // thousandths of the maximum observable rate 1 / (e tau) that flag saturation
+#define SATURATION_EXIT 300    // and the fraction the observed rate has to fall below before it is cleared
+#define PEAK_BUSY 22072766470ULL // 6e10 / e, the largest observable m tau in CPM ns
+
+void DeadTime::begin(uint32_t cycles)
+{
+  cyclesPerMicro = cycles;
+  memset(histogram, 0, sizeof(histogram));
+  inRange = 0;
+  havePrevious = false;
+}
+
+void DeadTime::addPulse(uint32_t stamp)
+{
+  if (havePrevious)
+  {
+    uint32_t micros = (stamp - previousStamp) / cyclesPerMicro;
+    uint32_t index = micros / DEAD_TIME_BIN_MICROS;
+    if (index < DEAD_TIME_BINS)
+    {
+      if (histogram[index] == 0xFFFF) // halve everything so old data fades out instead of saturating the bins
+      {
+        inRange = 0;
+        for (uint16_t b = 0; b < DEAD_TIME_BINS; b++)
+        {
+          histogram[b] >>= 1;
+          inRange += histogram[b];
+        }
+      }
+      histogram[index]++;
+      inRange++;
+    }
+  }
+  previousStamp = stamp;
+  havePrevious = true;
+}
+
+void DeadTime::resync()
+{
+  havePrevious = false;
+}
+
+void DeadTime::rebase(uint32_t before, uint32_t after, uint32_t cycles)
+{
+  if (havePrevious) // move the last pulse to where it would be on the new clock, the next interval stays exact
+    previousStamp = after - (uint32_t)((uint64_t)(before - previousStamp) * cycles / cyclesPerMicro);
+  cyclesPerMicro = cycles;
+}
+
+void DeadTime::restore(uint32_t nanos)
+{
+  if (nanos < DEAD_TIME_BIN_MICROS * 1000 || nanos > DEAD_TIME_BINS * DEAD_TIME_BIN_MICROS * 1000)
+    return; // not something fit() could have produced
+  tauNanos = nanos;
+  tau = nanos / 1000.0f;
+}
+
+bool DeadTime::fit()
+{
+  if (inRange < DEAD_TIME_MIN_SAMPLES)
+    return false;
+
+  uint16_t peak = 0;
+  for (uint16_t b = 1; b < DEAD_TIME_BINS; b++)
+  {
+    if (histogram[b] > histogram[peak])
+      peak = b;
+  }
+
+  // dead time is where the histogram first rises to half the peak, interpolated within the bin
+  float half = histogram[peak] / 2.0f;
+  uint16_t edge = 0;
+  while (edge < peak && histogram[edge] < half)
+    edge++;
+  float fraction = 0;
+  if (edge > 0 && histogram[edge] > histogram[edge - 1])
+    fraction = (half - histogram[edge - 1]) / float(histogram[edge] - histogram[edge - 1]);
+  tau = (edge - 1 + fraction) * DEAD_TIME_BIN_MICROS + DEAD_TIME_BIN_MICROS / 2.0f;
+  if (tau < DEAD_TIME_BIN_MICROS)
+    tau = DEAD_TIME_BIN_MICROS;
+  tauNanos = uint32_t(tau * 1000.0f);
+
+  hasFit = true;
+  return true;
+}
+
+void DeadTime::updateSaturation(uint32_t cpm)
+{
+  // near the peak an observed rate can come from two true rates, and beyond it a rising field reads lower.
+  // Once that region is reached the flag holds until the observed rate has dropped well clear of it
+  uint64_t busy = (uint64_t)cpm * tauNanos * 1000; // m tau, scaled by 6e13
+  if (busy >= PEAK_BUSY * SATURATION_ENTER)
+    isSaturated = true;
+  else if (busy < PEAK_BUSY * SATURATION_EXIT)
+    isSaturated = false;
+}
+
+uint32_t DeadTime::correct(uint32_t cpm) const
+{
+  if (model == DEAD_TIME_NON_PARALYZABLE)
+    return correctNonParalyzable(cpm, tauNanos);
+  else if (model == DEAD_TIME_PARALYZABLE)
+    return correctParalyzable(cpm, tauNanos);
+  return cpm;
+}
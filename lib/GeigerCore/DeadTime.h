@@ -0,0 +1,58 @@
+/*  Dead time measurement and correction
+    Builds a histogram of the intervals between recorded pulses. Neither the tube nor the ISR lockout lets an
+    interval shorter than the effective dead time through, so the rising edge of the histogram is the combined
+    dead time of both. The observed rate is corrected with either counter model, and saturation is flagged
+    once the observed rate reaches the region where a paralyzable counter reads lower as the true rate rises.
+*/
+#ifndef DEAD_TIME_H
+#define DEAD_TIME_H
+
+#include <stdint.h>
+
+#define DEAD_TIME_BINS 128           // histogram bins
+#define DEAD_TIME_BIN_MICROS 10      // width of each bin, covers intervals up to 1.28 ms
+#define DEAD_TIME_DEFAULT_MICROS 200 // used until enough intervals have been collected for a fit
+#define DEAD_TIME_MIN_SAMPLES 500    // intervals inside the histogram needed for a fit
+
+enum DeadTimeModel
+{
+  DEAD_TIME_OFF = 0,
+  DEAD_TIME_NON_PARALYZABLE = 1, // counter is blind for a fixed time after each recorded pulse
+  DEAD_TIME_PARALYZABLE = 2      // every pulse, recorded or not, restarts the dead time
+};
+
+class DeadTime
+{
+public:
+  void begin(uint32_t cyclesPerMicro);
+  void addPulse(uint32_t stamp); // cycle count timestamp of a recorded pulse, in order
+  void resync();                 // timestamps were lost, the next interval is not a real one
+  void rebase(uint32_t before, uint32_t after, uint32_t cyclesPerMicro); // the timestamp clock changed rate between the two counts
+  void restore(uint32_t nanos);  // dead time from an earlier fit, used until the next one
+  bool fit();                    // re-estimate the dead time, true if there was enough data
+  void updateSaturation(uint32_t cpm); // observed short-window CPM, once per bin
+
+  uint32_t correct(uint32_t cpm) const; // observed CPM to true CPM with the selected model
+
+  DeadTimeModel model = DEAD_TIME_NON_PARALYZABLE;
+
+  float deadTimeMicros() const { return tau; }
+  uint32_t deadTimeNanos() const { return tauNanos; } // what the integer correction uses
+  bool fitted() const { return hasFit; }
+  bool saturated() const { return isSaturated; }
+  uint32_t samples() const { return inRange; }
+  uint32_t bin(uint16_t index) const { return histogram[index]; }
+
+private:
+  uint16_t histogram[DEAD_TIME_BINS];
+  uint32_t inRange = 0;       // intervals counted in the histogram
+  uint32_t cyclesPerMicro = 160;
+  uint32_t previousStamp = 0;
+  bool havePrevious = false;
+  float tau = DEAD_TIME_DEFAULT_MICROS;
+  uint32_t tauNanos = DEAD_TIME_DEFAULT_MICROS * 1000;
+  bool hasFit = false;
+  bool isSaturated = false;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "DoseMath.h"
+
+#define NANOS_PER_MINUTE 60000000000ULL
+#define PARALYZABLE_PEAK_MILLI 368 // 1 / e, the largest observable m tau
+#define Q28_ONE (1ULL << 28)
+
+uint32_t correctNonParalyzable(uint32_t cpm, uint32_t deadTimeNanos)
+{
+  uint64_t busy = (uint64_t)cpm * deadTimeNanos; // fraction of a minute the counter is dead, times 6e10
+  uint64_t limit = NANOS_PER_MINUTE / 100 * 99;  // same 99 % cap as before
+  if (busy > limit)
+    busy = limit;
+  return (uint32_t)(((uint64_t)cpm * NANOS_PER_MINUTE + (NANOS_PER_MINUTE - busy) / 2) / (NANOS_PER_MINUTE - busy));
+}
+
+static uint64_t expNegQ28(uint64_t x) // e^-x for x in [0, 1], Taylor series accurate to a few Q28 steps
+{
+  uint64_t term = Q28_ONE;
+  uint64_t sum = Q28_ONE;
+  for (uint8_t n = 1; n <= 12; n++)
+  {
+    term = term * x / (Q28_ONE * n);
+    if (n & 1)
+      sum -= term;
+    else
+      sum += term;
+  }
+  return sum;
+}
+
+uint32_t correctParalyzable(uint32_t cpm, uint32_t deadTimeNanos)
+{
+  if (deadTimeNanos == 0)
+    return cpm;
+  uint64_t busy = (uint64_t)cpm * deadTimeNanos;
+  if (busy >= NANOS_PER_MINUTE / 1000 * PARALYZABLE_PEAK_MILLI)
+    return (uint32_t)(NANOS_PER_MINUTE / deadTimeNanos); // at or above the maximum observable rate, the best answer is n = 1 / tau
+
+  // solve x exp(-x) = y on the lower branch, with x = n tau and y = m tau in Q28. The function is concave,
+  // so Newton's method started at x = y climbs monotonically to the root without overshooting
+  uint64_t y = (busy << 28) / NANOS_PER_MINUTE;
+  uint64_t x = y;
+  for (uint8_t k = 0; k < 16; k++)
+  {
+    uint64_t e = expNegQ28(x);
+    uint64_t value = (x * e) >> 28;
+    uint64_t slope = (e * (Q28_ONE - x)) >> 28;
+    if (value >= y || slope == 0)
+      break;
+    uint64_t step = ((y - value) << 28) / slope;
+    if (step == 0)
+      break;
+    x += step;
+    if (x >= Q28_ONE)
+    {
+      x = Q28_ONE;
+      break;
+    }
+  }
+  return (uint32_t)(((x * (NANOS_PER_MINUTE >> 8)) / deadTimeNanos + (1 << 19)) >> 20);
+}
+
+uint32_t doseRateMilli(uint32_t cpm, uint32_t conversionFactor, bool units)
+{
+  if (conversionFactor == 0)
+    return 0;
+  uint64_t scale = units ? 100 : 1000; // 1 mR/hr is 10 uSv/hr
+  return (uint32_t)(((uint64_t)cpm * scale + conversionFactor / 2) / conversionFactor);
+}
+
+uint32_t totalDoseMilli(uint32_t cumulativeCount, uint32_t conversionFactor, bool units)
+{
+  if (conversionFactor == 0)
+    return 0;
+  uint64_t scale = units ? 100 : 1000;
+  uint64_t divisor = 60ULL * conversionFactor; // cumulative counts are counts per minute times minutes
+  return (uint32_t)(((uint64_t)cumulativeCount * scale + divisor / 2) / divisor);
+}
+
+void formatMilli(uint32_t milli, uint8_t decimals, uint8_t width, char *out, size_t size)
+{
+  static const uint32_t steps[] = {1000, 100, 10, 1};
+  if (decimals > 3)
+    decimals = 3;
+  uint32_t step = steps[decimals];
+  uint32_t scaled = (milli + step / 2) / step; // rounded to the last printed digit
+
+  char digits[16];
+  uint8_t n = 0;
+  for (uint8_t d = 0; d < decimals; d++)
+  {
+    digits[n++] = '0' + scaled % 10;
+    scaled /= 10;
+  }
+  if (decimals)
+    digits[n++] = '.';
+  do
+  {
+    digits[n++] = '0' + scaled % 10;
+    scaled /= 10;
+  } while (scaled);
+
+  size_t pos = 0;
+  for (uint8_t pad = n; pad < width && pos + 1 < size; pad++)
+    out[pos++] = ' ';
+  while (n && pos + 1 < size)
+    out[pos++] = digits[--n];
+  if (size)
+    out[pos] = '\0';
+}
+
+void formatDoseRate(uint32_t milli, char *out, size_t size)
+{
+  if (milli < 10000)
+    formatMilli(milli, 2, 4, out, size); // display two digits after the decimal point if value is less than 10
+  else if (milli < 100000)
+    formatMilli(milli, 1, 4, out, size); // one digit after decimal point when dose is greater than 10
+  else
+    formatMilli(milli, 0, 4, out, size); // whole numbers only when dose is higher than 100
+}
@@ -0,0 +1,23 @@
+/*  Fixed-point dose pipeline
+    The ESP8266 has no FPU, so everything that runs every second is done in integers. Dose rates and doses are
+    carried in thousandths of the display unit (nSv/hr, uR/hr, nSv, uR) and counter-model arithmetic in Q28.
+*/
+#ifndef DOSE_MATH_H
+#define DOSE_MATH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// dead time corrections of an observed CPM, dead time in ns
+uint32_t correctNonParalyzable(uint32_t cpm, uint32_t deadTimeNanos);
+uint32_t correctParalyzable(uint32_t cpm, uint32_t deadTimeNanos);
+
+// conversions to thousandths of the display unit. units 0 = Sievert, 1 = Rem (1 mRem == 10 uSv)
+uint32_t doseRateMilli(uint32_t cpm, uint32_t conversionFactor, bool units);
+uint32_t totalDoseMilli(uint32_t cumulativeCount, uint32_t conversionFactor, bool units);
+
+// integer formatter. Writes value / 1000 with the given number of decimals, rounded, right aligned in width
+void formatMilli(uint32_t milli, uint8_t decimals, uint8_t width, char *out, size_t size);
+void formatDoseRate(uint32_t milli, char *out, size_t size); // 2, 1 or 0 decimals depending on magnitude
+
+#endif
@@ -0,0 +1,57 @@
+/*  Hardware abstraction for the measurement core
+    The core only talks to the device through these four interfaces. The firmware implements them with the
+    cycle counter, the ISR pulse queue, the settings record on LittleFS and the TFT; a host build implements them
+    with plain C++ so the counting, integration and dose logic can run on a PC.
+*/
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "PulseQueue.h"
+
+class Clock
+{
+public:
+  virtual uint32_t millis() = 0;
+  virtual uint32_t cyclesPerMicro() = 0; // rate of the pulse timestamps
+};
+
+class PulseSource
+{
+public:
+  virtual PulseSnapshot snapshot() = 0;                          // counters, consistent with each other
+  virtual uint16_t drain(uint32_t *out, uint16_t maxCount) = 0;  // timestamps, oldest first
+  virtual void boundary(uint32_t &sequence, uint32_t &total) = 0; // number of 1 s boundaries so far and the pulse total at the last one
+};
+
+enum StorageRecord
+{
+  STORAGE_CALIBRATION = 0 // dead time model and fitted dead time
+};
+
+class Storage
+{
+public:
+  virtual bool load(StorageRecord record, void *data, size_t size) = 0; // false if nothing valid is stored
+  virtual void save(StorageRecord record, const void *data, size_t size) = 0;
+};
+
+struct Reading
+{
+  uint32_t averageCount;    // dead time corrected CPM
+  uint32_t cumulativeCount; // counts since power on
+  uint32_t doseRate;        // thousandths of uSv/hr or mR/hr
+  uint32_t totalDose;       // thousandths of uSv or mR
+  uint8_t doseLevel;        // 0 = normal, 1 = elevated, 2 = high, 3 = tube saturated
+  bool timeToCount;         // reading came from the time to count estimator
+};
+
+class DisplaySink
+{
+public:
+  virtual void showReading(const Reading &reading) = 0; // once per closed bin
+  virtual void report(const char *line) = 0;           // diagnostics, one line at a time
+};
+
+#endif
@@ -0,0 +1,229 @@
+#include "MeasurementCore.h"
+#include "DoseMath.h"
+#include <math.h>
+#include <stdio.h>
+
+#define CALIBRATION_SAVE_MICROS 2000      // refits closer than this to the stored value are not saved
+#define CALIBRATION_SAVE_MILLIS 3600000UL // and refits are saved at most once an hour to spare the flash
+
+struct CalibrationRecord
+{
+  uint8_t model;
+  uint32_t deadTimeNanos;
+};
+
+void MeasurementCore::begin(Clock &c, PulseSource &p, Storage &s, DisplaySink &d)
+{
+  clock = &c;
+  pulses = &p;
+  storage = &s;
+  display = &d;
+
+  uint32_t cycles = clock->cyclesPerMicro();
+  deadTime.begin(cycles);
+  homeTtc.begin(cycles);
+  timedTtc.begin(cycles);
+  homeTtc.start(HOME_TTC_COUNTS, true);
+
+  CalibrationRecord calibration;
+  if (storage->load(STORAGE_CALIBRATION, &calibration, sizeof(calibration)) && calibration.model <= DEAD_TIME_PARALYZABLE)
+  {
+    deadTime.model = (DeadTimeModel)calibration.model;
+    deadTime.restore(calibration.deadTimeNanos);
+    savedDeadTime = calibration.deadTimeNanos;
+  }
+}
+
+bool MeasurementCore::update()
+{
+  drainPulses();
+  reportOverflows();
+  if (!closeBins()) // runs on every page so the history never has gaps
+    return false;
+  refresh();
+  display->showReading(reading);
+  return true;
+}
+
+// For a CPU clock switch, with interrupts off. before is the last timestamp at the old rate and after the first at
+// the new one. Queued pulses are consumed at the old rate first, the analysis then carries on across the switch
+void MeasurementCore::rebaseClock(uint32_t before, uint32_t after, uint32_t cycles)
+{
+  drainPulses();
+  deadTime.rebase(before, after, cycles);
+  homeTtc.rebase(before, after, cycles);
+  timedTtc.rebase(before, after, cycles);
+}
+
+void MeasurementCore::drainPulses() // moves new pulses from the ISR queue into the counters and per-pulse analysis
+{
+  PulseSnapshot snapshot = pulses->snapshot();
+  uint32_t newCounts = snapshot.total - previousTotal;
+  previousTotal = snapshot.total;
+  currentCount += newCounts;
+  cumulativeCount += newCounts;
+
+  uint32_t now = clock->millis();
+  uint16_t drained;
+  do
+  {
+    drained = pulses->drain(pulseBatch, PULSE_BATCH_SIZE);
+    for (uint16_t p = 0; p < drained; p++)
+    {
+      deadTime.addPulse(pulseBatch[p]);
+      homeTtc.addPulse(pulseBatch[p]);
+      timedTtc.addPulse(pulseBatch[p]);
+      if (homeTtc.results() != recordedTtcResults)
+      {
+        recordedTtcResults = homeTtc.results();
+        homeBlocks.add(homeTtc, now);
+      }
+    }
+  } while (drained == PULSE_BATCH_SIZE);
+
+  if (snapshot.overflows != pulseOverflows)
+  {
+    deadTime.resync(); // the interval across the dropped timestamps is not a real one
+    homeTtc.resync();
+    timedTtc.resync();
+    unreportedOverflows += snapshot.overflows - pulseOverflows; // reported by update(), this can run with interrupts off
+    pulseOverflows = snapshot.overflows;
+  }
+}
+
+void MeasurementCore::reportOverflows()
+{
+  if (unreportedOverflows == 0)
+    return;
+  char line[48];
+  snprintf(line, sizeof(line), "Pulse queue overflow: %lu", (unsigned long)unreportedOverflows);
+  display->report(line);
+  unreportedOverflows = 0;
+}
+
+bool MeasurementCore::closeBins() // adds the bins closed since the last call to the history. Returns true if there were any
+{
+  uint32_t seq;
+  uint32_t total;
+  pulses->boundary(seq, total);
+
+  uint32_t missed = seq - consumedBinSeq;
+  if (missed == 0)
+    return false;
+
+  uint32_t counts = total - consumedBinTotal;
+  for (uint32_t b = 1; b < missed; b++)
+  {
+    binHistory.add(counts / missed); // loop() was blocked for several boundaries, spread the counts over them
+    adaptiveWindow.update(binHistory);
+  }
+  binHistory.add(counts / missed + counts % missed);
+  adaptiveWindow.update(binHistory);
+  deadTime.updateSaturation(binHistory.cpm(5));
+  consumedBinSeq = seq;
+  consumedBinTotal = total;
+
+  if (seq % 10 == 0 && deadTime.fit())
+  {
+    uint32_t fitted = deadTime.deadTimeNanos();
+    if (fitted / 1000 != reportedDeadTime / 1000)
+    {
+      reportedDeadTime = fitted;
+      char line[64];
+      snprintf(line, sizeof(line), "Dead time fit: %lu us from %lu intervals", (unsigned long)(fitted / 1000), (unsigned long)deadTime.samples());
+      display->report(line);
+    }
+    uint32_t drift = fitted > savedDeadTime ? fitted - savedDeadTime : savedDeadTime - fitted;
+    if (drift >= CALIBRATION_SAVE_MICROS * 1000 && clock->millis() - calibrationSaveMillis >= CALIBRATION_SAVE_MILLIS)
+      saveCalibration();
+  }
+  return true;
+}
+
+void MeasurementCore::refresh()
+{
+  unsigned int window = integrationSeconds();
+  uint32_t observedCpm = binHistory.cpm(window);
+  reading.averageCount = deadTime.correct(observedCpm); // relevant at high count rates
+
+  // blocks sized so the ones kept span the window, the combined reading then has the window's counting error
+  uint64_t target = (uint64_t)observedCpm * window / 60 / TTC_HISTORY_BLOCKS;
+  if (target < HOME_TTC_COUNTS)
+    target = HOME_TTC_COUNTS;
+  else if (target > 0xFFFF)
+    target = 0xFFFF; // very long windows at very high rates are covered in part, the error is tiny by then
+  homeTtc.setTarget(target);
+
+  // at high rates the window estimate is dominated by the dead time correction. Time to count measures the live
+  // time directly. The switch depends on the rate alone, with hysteresis so it does not flip at the threshold
+  unsigned long switchCpm = usingTimeToCount ? ttcSwitchCpm * 4 / 5 : ttcSwitchCpm;
+  usingTimeToCount = ttcSwitchCpm && reading.averageCount > switchCpm;
+  uint32_t ttcCpm, ttcIntervals;
+  reading.timeToCount = usingTimeToCount && homeBlocks.combine(clock->millis(), window * 1000UL, deadTime.deadTimeNanos(), ttcCpm, ttcIntervals);
+  if (reading.timeToCount) // until a block has completed inside the window the window estimate stands
+  {
+    if (clock->millis() - ttcReportMillis >= 10000)
+    {
+      ttcReportMillis = clock->millis();
+      reportTimeToCount(ttcCpm, timeToCountError(ttcIntervals), window * 1000UL, "Home");
+    }
+    reading.averageCount = ttcCpm;
+  }
+
+  reading.cumulativeCount = cumulativeCount;
+  reading.doseRate = doseRateMilli(reading.averageCount, conversionFactor, doseUnits); // integer maths, the ESP8266 has no FPU
+  reading.totalDose = totalDoseMilli(cumulativeCount, conversionFactor, doseUnits);
+
+  if (deadTime.saturated())
+    reading.doseLevel = 3; // reading can no longer be trusted, the tube is near or past its maximum count rate
+  else if (reading.averageCount < conversionFactor / 2) // 0.5 uSv/hr
+    reading.doseLevel = 0;
+  else if (reading.averageCount < alarmThreshold * conversionFactor)
+    reading.doseLevel = 1;
+  else
+    reading.doseLevel = 2;
+}
+
+unsigned int MeasurementCore::integrationSeconds() const
+{
+  if (integrationMode == 1)
+    return 5;
+  else if (integrationMode == 2)
+    return 180;
+  else if (integrationMode == 3)
+  {
+    if (customWindow < CUSTOM_WINDOW_MIN_SECONDS)
+      return CUSTOM_WINDOW_MIN_SECONDS;
+    return customWindow < BIN_HISTORY_SECONDS ? customWindow : BIN_HISTORY_SECONDS;
+  }
+  else if (integrationMode == 4)
+    return adaptiveWindow.seconds();
+  return 60;
+}
+
+void MeasurementCore::saveCalibration()
+{
+  CalibrationRecord calibration;
+  calibration.model = deadTime.model;
+  calibration.deadTimeNanos = deadTime.deadTimeNanos();
+  storage->save(STORAGE_CALIBRATION, &calibration, sizeof(calibration));
+  savedDeadTime = calibration.deadTimeNanos;
+  calibrationSaveMillis = clock->millis();
+}
+
+void MeasurementCore::reportTimeToCount(TimeToCount &ttc, const char *label)
+{
+  reportTimeToCount(ttc.cpm(deadTime.deadTimeNanos()), ttc.relativeError(), ttc.durationMicros() / 1000, label);
+}
+
+void MeasurementCore::reportTimeToCount(uint32_t cpm, float error, uint32_t millis, const char *label)
+{
+  unsigned int window = integrationSeconds();
+  uint32_t windowCounts = binHistory.sum(window);
+  unsigned int windowError = windowCounts ? (unsigned int)(1000 / sqrtf(windowCounts)) : 1000; // tenths of a percent
+  char line[128];
+  snprintf(line, sizeof(line), "%s time to count: %lu cpm +-%u.%u%% in %lu ms. Window: %lu cpm +-%u.%u%% over %u s",
+           label, (unsigned long)cpm, (unsigned int)(error * 1000) / 10, (unsigned int)(error * 1000) % 10, (unsigned long)millis,
+           (unsigned long)deadTime.correct(binHistory.cpm(window)), windowError / 10, windowError % 10, window);
+  display->report(line);
+}
@@ -0,0 +1,76 @@
+/*  Measurement core
+    Everything between the pulse source and the display: draining pulse timestamps, closing 1 s bins,
+    integration windows, dead time, time to count and dose. Runs unchanged on the device and on a host.
+*/
+#ifndef MEASUREMENT_CORE_H
+#define MEASUREMENT_CORE_H
+
+#include <stdint.h>
+#include "Hal.h"
+#include "BinHistory.h"
+#include "AdaptiveWindow.h"
+#include "DeadTime.h"
+#include "TimeToCount.h"
+
+#define PULSE_BATCH_SIZE 32
+#define HOME_TTC_COUNTS 100 // fewest pulses in a home page time to count block, more when the window holds more
+#define CUSTOM_WINDOW_MIN_SECONDS 5
+
+class MeasurementCore
+{
+public:
+  void begin(Clock &clock, PulseSource &pulses, Storage &storage, DisplaySink &display);
+  bool update(); // call every loop. True if at least one bin was closed and the reading refreshed
+
+  unsigned int integrationSeconds() const;
+  void refresh();          // recompute the reading from the history, e.g. after a settings change
+  void saveCalibration();  // store the dead time model and fit
+  void reportTimeToCount(TimeToCount &ttc, const char *label); // compare with the window estimator
+  void reportTimeToCount(uint32_t cpm, float error, uint32_t millis, const char *label);
+  void rebaseClock(uint32_t before, uint32_t after, uint32_t cyclesPerMicro); // the pulse timestamps changed rate between the two counts
+
+  // settings
+  int integrationMode = 0;          // 0 = medium, 1 = fast, 2 == slow, 3 = custom, 4 = automatic
+  unsigned int customWindow = 600;  // seconds, integration time of the custom mode. Clamped to BIN_HISTORY_SECONDS
+  unsigned int conversionFactor = 175;
+  bool doseUnits = 0;               // 0 = Sievert, 1 = Rem
+  unsigned int alarmThreshold = 5;
+  unsigned long ttcSwitchCpm = 30000; // home reading switches to time to count above this rate, 0 = never
+
+  // state
+  unsigned long currentCount = 0;// counts since a page last reset it
+  unsigned long cumulativeCount = 0;
+  Reading reading;
+
+  BinHistory binHistory;         // one entry per second, any integration window is read from it
+  AdaptiveWindow adaptiveWindow; // window length used by the automatic integration mode
+  DeadTime deadTime;             // inter-arrival histogram, fitted dead time and correction model
+  TimeToCount homeTtc;           // runs continuously, takes over the reading at high rates
+  TimeToCountHistory homeBlocks; // its completed blocks, combined over the integration window
+  TimeToCount timedTtc;          // measurement started from the timed count page
+
+private:
+  void drainPulses();
+  void reportOverflows();
+  bool closeBins();
+
+  Clock *clock;
+  PulseSource *pulses;
+  Storage *storage;
+  DisplaySink *display;
+
+  uint32_t pulseBatch[PULSE_BATCH_SIZE]; // timestamps drained in one go
+  uint32_t previousTotal = 0;            // pulse total at the last drain
+  uint32_t pulseOverflows = 0;           // timestamps dropped because loop() fell behind
+  uint32_t unreportedOverflows = 0;      // of those, not yet reported
+  uint32_t consumedBinSeq = 0;           // boundaries already added to binHistory
+  uint32_t consumedBinTotal = 0;         // pulse total at the last consumed boundary
+  bool usingTimeToCount = false;
+  uint32_t recordedTtcResults = 0;       // homeTtc blocks already in homeBlocks
+  uint32_t ttcReportMillis = 0;          // last comparison against the window estimator
+  uint32_t reportedDeadTime = 0;         // last fitted value reported, ns
+  uint32_t savedDeadTime = 0;            // fitted value in storage, ns
+  uint32_t calibrationSaveMillis = 0;
+};
+
+#endif
@@ -0,0 +1,107 @@
+/*  Lock-free pulse queue between isr() and loop()
+    The ISR is the only producer and loop() the only consumer. Every accepted pulse pushes its cycle-counter
+    timestamp; loop() drains them in batches and takes consistent snapshots of the counters without
+    disabling interrupts.
+*/
+#ifndef PULSE_QUEUE_H
+#define PULSE_QUEUE_H
+
+#include <stdint.h>
+
+#define PULSE_QUEUE_SIZE 512 // must be a power of two
+
+struct PulseSnapshot
+{
+  uint32_t total;     // pulses accepted by the ISR since boot, including those whose timestamp was dropped
+  uint32_t overflows; // pulses whose timestamp was dropped because the queue was full
+  uint32_t lastStamp; // cycle count of the most recent pulse
+};
+
+class PulseQueue
+{
+public:
+  // body of the pulse ISR. Edges closer than lockout to the previous edge are ringing, not pulses.
+  // True when the edge was counted
+  inline __attribute__((always_inline)) bool pulse(uint32_t stamp)
+  {
+    bool accepted = (stamp - previousEdge) > lockout;
+    if (accepted)
+    {
+      push(stamp);
+    }
+    previousEdge = stamp;
+    return accepted;
+  }
+
+  // producer side. Only ever called from the ISR, forced inline so it stays in IRAM with it
+  inline __attribute__((always_inline)) void push(uint32_t stamp)
+  {
+    sequence++; // odd while the counters are being updated
+    uint16_t next = (head + 1) & (PULSE_QUEUE_SIZE - 1);
+    if (next != tail)
+    {
+      stamps[head] = stamp;
+      head = next;
+    }
+    else
+    {
+      overflowCount++;
+    }
+    totalCount++;
+    lastPulseStamp = stamp;
+    sequence++;
+  }
+
+  // pulse total for other interrupt handlers, which cannot be preempted by the ISR that writes it
+  inline __attribute__((always_inline)) uint32_t total() const
+  {
+    return totalCount;
+  }
+
+  // consumer side. Copies up to maxCount timestamps, oldest first, and returns how many were copied
+  uint16_t drain(uint32_t *out, uint16_t maxCount)
+  {
+    uint16_t n = 0;
+    uint16_t last = head; // read once, the ISR can only add to the queue after this
+    while (tail != last && n < maxCount)
+    {
+      out[n++] = stamps[tail];
+      tail = (tail + 1) & (PULSE_QUEUE_SIZE - 1);
+    }
+    return n;
+  }
+
+  uint16_t pending() const
+  {
+    return (head - tail) & (PULSE_QUEUE_SIZE - 1);
+  }
+
+  // consistent copy of the counters. Retries if a pulse arrived while reading
+  PulseSnapshot snapshot() const
+  {
+    PulseSnapshot s;
+    uint32_t before;
+    do
+    {
+      before = sequence;
+      s.total = totalCount;
+      s.overflows = overflowCount;
+      s.lastStamp = lastPulseStamp;
+    } while ((before & 1) || before != sequence);
+    return s;
+  }
+
+  uint32_t lockout = 0; // in timestamp units, set before the ISR is attached
+
+private:
+  uint32_t previousEdge = 0; // only touched by the ISR
+  volatile uint32_t stamps[PULSE_QUEUE_SIZE];
+  volatile uint16_t head = 0; // written by the ISR only
+  volatile uint16_t tail = 0; // written by loop() only
+  volatile uint32_t sequence = 0;
+  volatile uint32_t totalCount = 0;
+  volatile uint32_t overflowCount = 0;
+  volatile uint32_t lastPulseStamp = 0;
+};
+
+#endif
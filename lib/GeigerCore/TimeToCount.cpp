@@ -0,0 +1,124 @@
+#include "TimeToCount.h"
+#include <math.h>
+
+void TimeToCount::begin(uint32_t cycles)
+{
+  cyclesPerMicro = cycles;
+}
+
+void TimeToCount::start(uint16_t target, bool repeat)
+{
+  targetCounts = target < 2 ? 2 : target;
+  repeating = repeat;
+  pulses = 0;
+  elapsedCycles = 0;
+  active = true;
+}
+
+void TimeToCount::stop()
+{
+  active = false;
+}
+
+void TimeToCount::setTarget(uint16_t target)
+{
+  targetCounts = target < 2 ? 2 : target;
+}
+
+void TimeToCount::resync()
+{
+  pulses = 0;
+  elapsedCycles = 0;
+}
+
+void TimeToCount::rebase(uint32_t before, uint32_t after, uint32_t cycles)
+{
+  if (pulses > 0) // the block carries on, its time so far converted to the new rate
+  {
+    elapsedCycles = elapsedCycles * cycles / cyclesPerMicro;
+    previousStamp = after - (uint32_t)((uint64_t)(before - previousStamp) * cycles / cyclesPerMicro);
+  }
+  cyclesPerMicro = cycles;
+}
+
+void TimeToCount::addPulse(uint32_t stamp)
+{
+  if (!active)
+    return;
+
+  if (pulses > 0)
+    elapsedCycles += stamp - previousStamp;
+  previousStamp = stamp;
+  pulses++;
+
+  if (pulses >= targetCounts) // the target can drop below the pulses collected so far
+  {
+    resultIntervals = pulses - 1;
+    resultMicros = elapsedCycles / cyclesPerMicro;
+    resultCount++;
+
+    if (repeating)
+    {
+      pulses = 1; // the last pulse of this block is the first of the next
+      elapsedCycles = 0;
+    }
+    else
+    {
+      active = false;
+    }
+  }
+}
+
+uint32_t timeToCountCpm(uint32_t intervals, uint64_t micros, uint32_t deadTimeNanos)
+{
+  uint64_t dead = (uint64_t)intervals * deadTimeNanos / 1000;
+  if (intervals < 2 || micros <= dead)
+    return 0;
+  uint64_t live = micros - dead; // time the counter was able to record pulses
+  return (uint32_t)(((intervals - 1) * 60000000ULL + live / 2) / live); // (k - 1) / T is the unbiased rate for k gamma distributed intervals
+}
+
+float timeToCountError(uint32_t intervals)
+{
+  if (intervals < 3)
+    return 1.0f;
+  return 1.0f / sqrtf(intervals - 2); // variance of (k - 1) / T is rate^2 / (k - 2)
+}
+
+uint32_t TimeToCount::runningCpm(uint32_t deadTimeNanos) const
+{
+  if (pulses < 3)
+    return 0;
+  return timeToCountCpm(pulses - 1, elapsedCycles / cyclesPerMicro, deadTimeNanos);
+}
+
+uint32_t TimeToCount::cpm(uint32_t deadTimeNanos) const
+{
+  return timeToCountCpm(resultIntervals, resultMicros, deadTimeNanos);
+}
+
+void TimeToCountHistory::add(const TimeToCount &ttc, uint32_t endMillis)
+{
+  newest = (newest + 1) % TTC_HISTORY_BLOCKS;
+  blocks[newest].endMillis = endMillis;
+  blocks[newest].micros = ttc.durationMicros();
+  blocks[newest].intervals = ttc.intervals();
+  if (stored < TTC_HISTORY_BLOCKS)
+    stored++;
+}
+
+bool TimeToCountHistory::combine(uint32_t now, uint32_t windowMillis, uint32_t deadTimeNanos, uint32_t &cpm, uint32_t &intervals) const
+{
+  // the blocks of a repeating measurement share their end pulses, so together they are one long block
+  uint64_t micros = 0;
+  intervals = 0;
+  uint8_t index = newest;
+  for (uint8_t n = 0; n < stored && now - blocks[index].endMillis <= windowMillis; n++)
+  {
+    micros += blocks[index].micros;
+    intervals += blocks[index].intervals;
+    index = (index + TTC_HISTORY_BLOCKS - 1) % TTC_HISTORY_BLOCKS;
+  }
+  cpm = timeToCountCpm(intervals, micros, deadTimeNanos);
+  return intervals >= 2;
+}
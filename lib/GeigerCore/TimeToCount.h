@@ -0,0 +1,78 @@
+/*  Time-to-count rate measurement
+    Instead of counting pulses in a fixed time, measures the time taken to collect a fixed number of pulses
+    from their ISR timestamps. The relative error is fixed at about 1 / sqrt(target) whatever the rate, and at
+    high rates the result arrives much sooner than a fixed window. The live time is the measured time minus
+    one dead time per recorded pulse, which is exact for a non-paralyzable counter.
+*/
+#ifndef TIME_TO_COUNT_H
+#define TIME_TO_COUNT_H
+
+#include <stdint.h>
+
+#define TTC_HISTORY_BLOCKS 32 // completed blocks a TimeToCountHistory keeps
+
+uint32_t timeToCountCpm(uint32_t intervals, uint64_t micros, uint32_t deadTimeNanos); // 0 with fewer than 2 intervals
+float timeToCountError(uint32_t intervals); // one standard deviation of that, as a fraction
+
+class TimeToCount
+{
+public:
+  void begin(uint32_t cyclesPerMicro);
+  void start(uint16_t target, bool repeat); // repeat starts the next block as soon as one completes
+  void stop();
+  void setTarget(uint16_t target);          // resizes the current block and the ones after it
+  void addPulse(uint32_t stamp);            // cycle count timestamp of a recorded pulse, in order
+  void resync();                            // timestamps were lost, the current block is restarted
+  void rebase(uint32_t before, uint32_t after, uint32_t cyclesPerMicro); // the timestamp clock changed rate between the two counts
+
+  bool running() const { return active; }
+  uint16_t target() const { return targetCounts; }
+  uint16_t collected() const { return pulses; }
+  uint32_t runningCpm(uint32_t deadTimeNanos) const; // estimate from the block still being collected
+
+  // result of the most recently completed block
+  uint32_t results() const { return resultCount; } // increments every time a block completes
+  uint32_t cpm(uint32_t deadTimeNanos) const;
+  uint32_t durationMicros() const { return (uint32_t)resultMicros; }
+  uint16_t intervals() const { return resultIntervals; }
+  float relativeError() const { return timeToCountError(resultIntervals); }
+
+private:
+  uint32_t cyclesPerMicro = 160;
+  uint16_t targetCounts = 0;
+  uint16_t pulses = 0;         // pulses in the current block, the first one starts the clock
+  uint32_t previousStamp = 0;
+  uint64_t elapsedCycles = 0;  // summed pulse by pulse so the 32 bit cycle counter can wrap
+  bool active = false;
+  bool repeating = false;
+
+  uint32_t resultCount = 0;
+  uint16_t resultIntervals = 0;
+  uint64_t resultMicros = 0;
+};
+
+// completed blocks of a repeating measurement. A reading combines every block that ended inside its integration
+// window, so its error follows the window length instead of the block size
+class TimeToCountHistory
+{
+public:
+  void add(const TimeToCount &ttc, uint32_t endMillis); // call once for every completed block
+  void reset() { stored = 0; }
+
+  // rate from the blocks that ended within windowMillis of now. False if there were none
+  bool combine(uint32_t now, uint32_t windowMillis, uint32_t deadTimeNanos, uint32_t &cpm, uint32_t &intervals) const;
+
+private:
+  struct Block
+  {
+    uint32_t endMillis;
+    uint32_t micros;
+    uint16_t intervals;
+  };
+
+  Block blocks[TTC_HISTORY_BLOCKS];
+  uint8_t newest = 0;
+  uint8_t stored = 0;
+};
+
+#endif
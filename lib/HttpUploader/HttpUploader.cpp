@@ -0,0 +1,158 @@
+#include "HttpUploader.h"
+#include <lwip/dns.h>
+
+HttpUploader::HttpUploader()
+{
+  tcp.onConnect(connected, this);
+  tcp.onData(received, this);
+  tcp.onDisconnect(disconnected, this);
+  tcp.onError(failed, this);
+}
+
+bool HttpUploader::start(const char *host, uint16_t port, const char *request, size_t length)
+{
+  if (busy() || length > sizeof(this->request) || strlen(host) >= sizeof(this->host))
+    return false;
+  strcpy(this->host, host);
+  this->port = port;
+  if (request != this->request)
+    memcpy(this->request, request, length);
+  this->length = length;
+  sent = 0;
+  dnsDone = false;
+  address = 0;
+  isConnected = false;
+  isClosed = false;
+  status = 0;
+  statusLength = 0;
+  outcome = 0;
+  enter(HTTP_RESOLVE, millis());
+
+  ip_addr_t cached;
+  err_t lookup = dns_gethostbyname(this->host, &cached, resolved, this);
+  if (lookup == ERR_OK) // a numeric address or in the DNS cache, no callback follows
+  {
+    address = ip_addr_get_ip4_u32(&cached);
+    dnsDone = true;
+  }
+  else if (lookup != ERR_INPROGRESS)
+    dnsDone = true; // address stays 0
+  return true;
+}
+
+int HttpUploader::result()
+{
+  if (state != HTTP_DONE)
+    return 0;
+  state = HTTP_IDLE;
+  return outcome;
+}
+
+void HttpUploader::enter(HttpState next, uint32_t now)
+{
+  state = next;
+  stateStart = now;
+}
+
+void HttpUploader::finish(int result, uint32_t now)
+{
+  outcome = result;
+  tcp.close(true);
+  enter(HTTP_DONE, now);
+}
+
+void HttpUploader::poll(uint32_t now)
+{
+  uint32_t elapsed = now - stateStart;
+  switch (state)
+  {
+  case HTTP_RESOLVE:
+    if (dnsDone)
+    {
+      if (!address || !tcp.connect(IPAddress(address), port))
+        finish(address ? HTTP_ERROR_CONNECT : HTTP_ERROR_DNS, now);
+      else
+        enter(HTTP_CONNECT, now);
+    }
+    else if (elapsed > HTTP_RESOLVE_MILLIS)
+      finish(HTTP_ERROR_DNS, now);
+    break;
+
+  case HTTP_CONNECT:
+    if (isConnected)
+      enter(HTTP_SEND, now);
+    else if (isClosed || elapsed > HTTP_CONNECT_MILLIS)
+      finish(HTTP_ERROR_CONNECT, now);
+    break;
+
+  case HTTP_SEND:
+  {
+    size_t room = tcp.space(); // only as much as lwIP takes without waiting
+    size_t chunk = min(room, (size_t)(length - sent));
+    if (chunk)
+      sent += tcp.write(request + sent, chunk);
+    if (sent == length)
+      enter(HTTP_AWAIT, now);
+    else if (isClosed || elapsed > HTTP_SEND_MILLIS)
+      finish(HTTP_ERROR_SEND, now);
+    break;
+  }
+
+  case HTTP_AWAIT:
+    if (status)
+      enter(HTTP_CLOSE, now);
+    else if (isClosed)
+      finish(HTTP_ERROR_RESPONSE, now);
+    else if (elapsed > HTTP_RESPONSE_MILLIS)
+      finish(HTTP_ERROR_TIMEOUT, now);
+    break;
+
+  case HTTP_CLOSE: // the rest of the response is not needed
+    finish(status > 0 ? status : HTTP_ERROR_RESPONSE, now);
+    break;
+
+  default:
+    break;
+  }
+}
+
+void HttpUploader::resolved(const char *name, const ip_addr_t *result, void *arg)
+{
+  HttpUploader *self = (HttpUploader *)arg;
+  if (self->state != HTTP_RESOLVE || strcmp(name, self->host) != 0)
+    return; // answer to a lookup that already timed out
+  self->address = result ? ip_addr_get_ip4_u32(result) : 0;
+  self->dnsDone = true;
+}
+
+void HttpUploader::connected(void *arg, AsyncClient *client)
+{
+  ((HttpUploader *)arg)->isConnected = true;
+}
+
+void HttpUploader::received(void *arg, AsyncClient *client, void *data, size_t length)
+{
+  HttpUploader *self = (HttpUploader *)arg;
+  const char *bytes = (const char *)data;
+  for (size_t i = 0; i < length && self->status == 0; i++) // collect "HTTP/1.1 200", the rest is ignored
+  {
+    if (bytes[i] == '\n' || self->statusLength == sizeof(self->statusLine) - 1)
+    {
+      self->statusLine[self->statusLength] = 0;
+      int code = 0;
+      self->status = sscanf(self->statusLine, "HTTP/%*d.%*d %d", &code) == 1 ? code : -1;
+    }
+    else
+      self->statusLine[self->statusLength++] = bytes[i];
+  }
+}
+
+void HttpUploader::disconnected(void *arg, AsyncClient *client)
+{
+  ((HttpUploader *)arg)->isClosed = true;
+}
+
+void HttpUploader::failed(void *arg, AsyncClient *client, int8_t error)
+{
+  ((HttpUploader *)arg)->isClosed = true;
+}
@@ -0,0 +1,82 @@
+/*  Non-blocking HTTP request for the station uploads
+    start() takes a complete request; poll() from loop() moves it along one step at a time: resolve the host,
+    connect, send, wait for the status line, close. The network work happens in lwIP callbacks, which only set flags,
+    so no call here waits on the network and the display, touch and counting carry on while a request is out.
+    Every step has its own timeout. When the request is over, result() gives the HTTP status or an HttpError.
+*/
+#ifndef HTTP_UPLOADER_H
+#define HTTP_UPLOADER_H
+
+#include <Arduino.h>
+#include <ESPAsyncTCP.h>
+
+#define HTTP_REQUEST_BYTES 1400         // whole request, head and body, about a TCP segment
+#define HTTP_HOST_BYTES 33
+#define HTTP_RESOLVE_MILLIS 5000
+#define HTTP_CONNECT_MILLIS 5000
+#define HTTP_SEND_MILLIS 5000
+#define HTTP_RESPONSE_MILLIS 10000
+
+enum HttpState
+{
+  HTTP_IDLE,
+  HTTP_RESOLVE,
+  HTTP_CONNECT,
+  HTTP_SEND,
+  HTTP_AWAIT,
+  HTTP_CLOSE,
+  HTTP_DONE       // result() is waiting to be collected
+};
+
+enum HttpError
+{
+  HTTP_ERROR_DNS = -1,
+  HTTP_ERROR_CONNECT = -2,
+  HTTP_ERROR_SEND = -3,
+  HTTP_ERROR_TIMEOUT = -4,   // no status line in time
+  HTTP_ERROR_RESPONSE = -5   // closed, or something that is not HTTP
+};
+
+class HttpUploader
+{
+public:
+  HttpUploader();
+  bool start(const char *host, uint16_t port, const char *request, size_t length); // false if busy or too long
+  char *buffer() { return busy() ? NULL : request; } // to build the next request in place, pass it to start()
+  void poll(uint32_t now);              // one step, call from loop()
+  bool busy() const { return state != HTTP_IDLE && state != HTTP_DONE; }
+  bool done() const { return state == HTTP_DONE; }
+  int result();                         // status or HttpError once done(), back to idle
+  HttpState current() const { return state; }
+
+private:
+  void enter(HttpState next, uint32_t now);
+  void finish(int outcome, uint32_t now);
+  static void resolved(const char *name, const ip_addr_t *address, void *arg);
+  static void connected(void *arg, AsyncClient *client);
+  static void received(void *arg, AsyncClient *client, void *data, size_t length);
+  static void disconnected(void *arg, AsyncClient *client);
+  static void failed(void *arg, AsyncClient *client, int8_t error);
+
+  AsyncClient tcp;
+  HttpState state = HTTP_IDLE;
+  uint32_t stateStart = 0;
+  int outcome = 0;
+
+  char host[HTTP_HOST_BYTES];
+  uint16_t port = 80;
+  char request[HTTP_REQUEST_BYTES];
+  uint16_t length = 0;
+  uint16_t sent = 0;
+
+  // written by the callbacks, read by poll()
+  volatile bool dnsDone = false;
+  volatile uint32_t address = 0;        // 0 if the lookup failed
+  volatile bool isConnected = false;
+  volatile bool isClosed = false;
+  volatile int status = 0;              // from the status line, -1 if it was not HTTP
+  char statusLine[16];
+  volatile uint8_t statusLength = 0;
+};
+
+#endif
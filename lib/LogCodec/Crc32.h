@@ -0,0 +1,24 @@
+/*  CRC-32 (IEEE 802.3, reflected, as used by zlib)
+    Bitwise, no table: the data checked is small and a 1 KB table would live in RAM.
+*/
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// pass the previous result as crc to continue over several buffers
+inline uint32_t crc32(const void *data, size_t length, uint32_t crc = 0)
+{
+  const uint8_t *bytes = (const uint8_t *)data;
+  crc = ~crc;
+  while (length--)
+  {
+    crc ^= *bytes++;
+    for (uint8_t bit = 0; bit < 8; bit++)
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+#endif
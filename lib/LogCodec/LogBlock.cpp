@@ -0,0 +1,47 @@
+#include "LogBlock.h"
+#include "Crc32.h"
+#include <string.h>
+
+uint16_t logBlockPayload(const LogBlockHeader &header)
+{
+  if (header.magic != LOG_BLOCK_MAGIC || header.count == 0 || header.count > LOG_BLOCK_RECORDS)
+    return 0;
+  if (header.version == LOG_BLOCK_RAW)
+    return header.count * sizeof(LogSample);
+  if (header.version == LOG_BLOCK_PACKED && header.bytes > 0 && header.bytes <= LOG_BLOCK_MAX_PAYLOAD)
+    return header.bytes;
+  return 0;
+}
+
+bool logBlockCrcValid(LogBlockHeader header, const uint8_t *payload)
+{
+  uint32_t crc = header.crc;
+  header.crc = 0;
+  return crc32(payload, logBlockPayload(header), crc32(&header, sizeof(header))) == crc;
+}
+
+uint8_t decodeLogBlock(const LogBlockHeader &header, const uint8_t *payload, LogSample *samples)
+{
+  if (header.version == LOG_BLOCK_RAW)
+  {
+    memcpy(samples, payload, header.count * sizeof(LogSample));
+    return header.count;
+  }
+  LogDecoder decoder(payload, header.bytes, header.count);
+  uint8_t n = 0;
+  while (n < header.count && decoder.next(samples[n]))
+    n++;
+  return n;
+}
+
+void encodeLogBlock(LogBlockHeader &header, const LogSample *samples, uint8_t *payload)
+{
+  LogEncoder encoder(payload, LOG_BLOCK_MAX_PAYLOAD, LOG_BLOCK_RECORDS); // one keyframe, at the start
+  for (uint8_t i = 0; i < header.count; i++)
+    encoder.add(samples[i]); // always fits, the payload has room for the worst case
+  header.magic = LOG_BLOCK_MAGIC;
+  header.version = LOG_BLOCK_PACKED;
+  header.bytes = encoder.size();
+  header.crc = 0;
+  header.crc = crc32(payload, header.bytes, crc32(&header, sizeof(header)));
+}
@@ -0,0 +1,33 @@
+/*  Block format of the flash log, shared by the firmware and the host reader
+    A block is a 16 byte header followed by its payload. Version 1 payloads are count raw samples of two 32 bit
+    words, version 2 payloads are a LogEncoder stream starting with a keyframe, so every block decodes on its own.
+    The CRC-32 covers the header, with crc = 0, and the payload.
+*/
+#ifndef LOG_BLOCK_H
+#define LOG_BLOCK_H
+
+#include "LogCodec.h"
+
+#define LOG_BLOCK_MAGIC 0x4C47 // "GL"
+#define LOG_BLOCK_RAW 1
+#define LOG_BLOCK_PACKED 2
+#define LOG_BLOCK_RECORDS 15   // most samples in one block
+#define LOG_BLOCK_MAX_PAYLOAD (LOG_BLOCK_RECORDS * LOG_CODEC_MAX_BYTES)
+
+struct LogBlockHeader
+{
+  uint16_t magic;
+  uint8_t version;
+  uint8_t count;
+  uint16_t boot;
+  uint16_t bytes;    // payload length, 0 in version 1 where it follows from count
+  uint32_t firstSeq;
+  uint32_t crc;
+};
+
+uint16_t logBlockPayload(const LogBlockHeader &header);                 // payload bytes, 0 if the header is not a block
+bool logBlockCrcValid(LogBlockHeader header, const uint8_t *payload);
+uint8_t decodeLogBlock(const LogBlockHeader &header, const uint8_t *payload, LogSample *samples); // samples decoded
+void encodeLogBlock(LogBlockHeader &header, const LogSample *samples, uint8_t *payload); // header.count samples, sets bytes and crc
+
+#endif
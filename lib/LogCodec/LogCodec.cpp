@@ -0,0 +1,85 @@
+#include "LogCodec.h"
+
+static uint8_t putVarint(uint8_t *out, uint32_t value) // LEB128, 7 bits a byte, low bits first
+{
+  uint8_t n = 0;
+  while (value >= 0x80)
+  {
+    out[n++] = (uint8_t)value | 0x80;
+    value >>= 7;
+  }
+  out[n++] = (uint8_t)value;
+  return n;
+}
+
+LogEncoder::LogEncoder(uint8_t *out, size_t capacity, uint16_t keyframeInterval)
+    : out(out), capacity(capacity), keyframeInterval(keyframeInterval)
+{
+}
+
+bool LogEncoder::add(const LogSample &sample)
+{
+  uint8_t bytes[LOG_CODEC_MAX_BYTES];
+  uint8_t n;
+  uint32_t step = sample.seconds - previous.seconds;
+  if (samples % keyframeInterval == 0)
+  {
+    n = putVarint(bytes, sample.seconds);
+    n += putVarint(bytes + n, sample.cpm);
+    step = 0; // the first step after a keyframe is stored against 0
+  }
+  else
+  {
+    n = putVarint(bytes, zigZag((int32_t)(step - previousStep)));
+    n += putVarint(bytes + n, zigZag((int32_t)(sample.cpm - previous.cpm)));
+  }
+  if (length + n > capacity)
+    return false;
+  for (uint8_t i = 0; i < n; i++)
+    out[length++] = bytes[i];
+  previous = sample;
+  previousStep = step;
+  samples++;
+  return true;
+}
+
+LogDecoder::LogDecoder(const uint8_t *in, size_t length, uint16_t keyframeInterval)
+    : in(in), length(length), keyframeInterval(keyframeInterval)
+{
+}
+
+bool LogDecoder::readVarint(uint32_t &value)
+{
+  value = 0;
+  for (uint8_t shift = 0; shift < 35 && position < length; shift += 7)
+  {
+    uint8_t byte = in[position++];
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+bool LogDecoder::next(LogSample &sample)
+{
+  uint32_t first, second;
+  if (!readVarint(first) || !readVarint(second))
+    return false;
+  if (samples % keyframeInterval == 0)
+  {
+    sample.seconds = first;
+    sample.cpm = second;
+    previousStep = 0;
+  }
+  else
+  {
+    uint32_t step = previousStep + unZigZag(first);
+    sample.seconds = previous.seconds + step;
+    sample.cpm = previous.cpm + unZigZag(second);
+    previousStep = step;
+  }
+  previous = sample;
+  samples++;
+  return true;
+}
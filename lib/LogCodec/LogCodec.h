@@ -0,0 +1,61 @@
+/*  Compact encoding of log samples
+    Each sample is stored as zig-zag varints: the change of the time step against the previous step (0 while the
+    samples are evenly spaced) and the change of the CPM against the previous sample. Every keyframeInterval
+    samples one is stored whole, so a stream can be decoded from any keyframe. At background rates a sample takes
+    about 2 bytes instead of 8. No Arduino dependencies, the host reader uses the same code.
+*/
+#ifndef LOG_CODEC_H
+#define LOG_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOG_CODEC_MAX_BYTES 10          // one sample at worst, two 5 byte varints
+#define LOG_CODEC_KEYFRAME_INTERVAL 64
+
+struct LogSample
+{
+  uint32_t seconds;
+  uint32_t cpm;
+};
+
+inline uint32_t zigZag(int32_t value) { return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31); }
+inline int32_t unZigZag(uint32_t value) { return (int32_t)(value >> 1) ^ -(int32_t)(value & 1); }
+
+class LogEncoder
+{
+public:
+  LogEncoder(uint8_t *out, size_t capacity, uint16_t keyframeInterval = LOG_CODEC_KEYFRAME_INTERVAL);
+  bool add(const LogSample &sample); // false when it doesn't fit, nothing is written then
+  size_t size() const { return length; }
+  uint16_t count() const { return samples; }
+
+private:
+  uint8_t *out;
+  size_t capacity;
+  size_t length = 0;
+  uint16_t keyframeInterval;
+  uint16_t samples = 0;
+  LogSample previous;
+  uint32_t previousStep = 0;
+};
+
+class LogDecoder // streaming, one sample per call
+{
+public:
+  LogDecoder(const uint8_t *in, size_t length, uint16_t keyframeInterval = LOG_CODEC_KEYFRAME_INTERVAL);
+  bool next(LogSample &sample); // false at the end of the data or on a truncated sample
+
+private:
+  bool readVarint(uint32_t &value);
+
+  const uint8_t *in;
+  size_t length;
+  size_t position = 0;
+  uint16_t keyframeInterval;
+  uint16_t samples = 0;
+  LogSample previous;
+  uint32_t previousStep = 0;
+};
+
+#endif
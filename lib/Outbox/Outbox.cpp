@@ -0,0 +1,95 @@
+#include "Outbox.h"
+#include <Crc32.h>
+#include <stddef.h>
+
+#define OUTBOX_PATH "/outbox"
+#define OUTBOX_SENT_PATH "/outbox.sent"
+
+uint32_t Outbox::checksum(const OutboxEntry &entry)
+{
+  return crc32(&entry, offsetof(OutboxEntry, crc));
+}
+
+bool Outbox::begin()
+{
+  File file = LittleFS.open(OUTBOX_PATH, "r");
+  if (!file)
+  {
+    file = LittleFS.open(OUTBOX_PATH, "w"); // slots are written in order, the file grows to full size on the first lap
+    if (!file)
+      return false;
+  }
+  OutboxEntry entry;
+  uint32_t newest = 0;
+  while (file.read((uint8_t *)&entry, sizeof(entry)) == sizeof(entry))
+    if (entry.crc == checksum(entry) && entry.seq > newest)
+      newest = entry.seq;
+  file.close();
+  nextSeq = newest + 1;
+  bootSeq = nextSeq;
+  firstSeq = nextSeq > OUTBOX_CAPACITY ? nextSeq - OUTBOX_CAPACITY : 1;
+
+  file = LittleFS.open(OUTBOX_SENT_PATH, "r");
+  if (file)
+  {
+    uint32_t saved[2];
+    if (file.read((uint8_t *)saved, sizeof(saved)) == sizeof(saved) && saved[1] == ~saved[0] && saved[0] > firstSeq &&
+        saved[0] <= nextSeq)
+      firstSeq = saved[0];
+    file.close();
+  }
+  mounted = true;
+  return true;
+}
+
+bool Outbox::push(uint32_t time, uint32_t uptime, uint32_t value)
+{
+  if (!mounted)
+    return false;
+  OutboxEntry entry = {nextSeq, time, uptime, value, 0};
+  entry.crc = checksum(entry);
+  File file = LittleFS.open(OUTBOX_PATH, "r+");
+  if (!file)
+    return false;
+  bool written = file.seek(((nextSeq - 1) % OUTBOX_CAPACITY) * sizeof(entry)) &&
+                 file.write((const uint8_t *)&entry, sizeof(entry)) == sizeof(entry);
+  file.close();
+  if (!written)
+    return false;
+  nextSeq++;
+  if (pending() > OUTBOX_CAPACITY)
+    firstSeq = nextSeq - OUTBOX_CAPACITY; // the oldest was just overwritten
+  return true;
+}
+
+uint16_t Outbox::read(OutboxEntry *entries, uint16_t count)
+{
+  if (count > pending())
+    count = pending();
+  if (!mounted || count == 0)
+    return 0;
+  File file = LittleFS.open(OUTBOX_PATH, "r");
+  if (!file)
+    return 0;
+  for (uint16_t i = 0; i < count; i++)
+  {
+    uint32_t seq = firstSeq + i;
+    OutboxEntry &entry = entries[i];
+    if (!file.seek(((seq - 1) % OUTBOX_CAPACITY) * sizeof(entry)) ||
+        file.read((uint8_t *)&entry, sizeof(entry)) != sizeof(entry) || entry.seq != seq || entry.crc != checksum(entry))
+      entry = {0, 0, 0, 0, 0};
+  }
+  file.close();
+  return count;
+}
+
+void Outbox::pop(uint16_t count)
+{
+  firstSeq += min((uint32_t)count, pending());
+  uint32_t saved[2] = {firstSeq, ~firstSeq};
+  File file = LittleFS.open(OUTBOX_SENT_PATH, "w");
+  if (!file)
+    return;
+  file.write((uint8_t *)saved, sizeof(saved));
+  file.close();
+}
@@ -0,0 +1,43 @@
+/*  Store-and-forward queue for the monitoring station readings
+    Every reading goes into a ring of fixed size records in one LittleFS file and leaves it only once the server
+    has accepted it, so readings taken while the WiFi or the server is down are sent later instead of lost. The
+    ring holds OUTBOX_CAPACITY readings, beyond that the oldest is overwritten. Records are numbered and carry a
+    CRC-32: begin() finds the newest by scanning, the delivered position is kept in a second file as FlashLog does.
+*/
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#define OUTBOX_CAPACITY 2016   // a week of 5 minute readings, 40 KB of flash
+
+struct OutboxEntry
+{
+  uint32_t seq;
+  uint32_t time;     // unix seconds, 0 if the clock was not set when it was taken
+  uint32_t uptime;   // seconds since boot, dates an entry of this boot once the clock is set
+  uint32_t value;
+  uint32_t crc;
+};
+
+class Outbox
+{
+public:
+  bool begin();                                 // after the filesystem is mounted
+  bool push(uint32_t time, uint32_t uptime, uint32_t value);
+  uint16_t read(OutboxEntry *entries, uint16_t count); // oldest first, a bad record comes back with seq 0 and time 0
+  void pop(uint16_t count);                     // the oldest count entries were delivered
+  uint32_t pending() const { return nextSeq - firstSeq; }
+  bool thisBoot(const OutboxEntry &entry) const { return entry.seq >= bootSeq; }
+
+private:
+  static uint32_t checksum(const OutboxEntry &entry);
+
+  bool mounted = false;
+  uint32_t firstSeq = 1;                        // oldest undelivered. Numbering starts at 1 so an empty slot never matches
+  uint32_t nextSeq = 1;
+  uint32_t bootSeq = 1;                         // first entry of this boot
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include "PowerManager.h"
+
+void PowerManager::begin(CpuClockSwitch s)
+{
+  clockSwitch = s;
+  lastActivity = millis();
+  lastIdleEnd = micros();
+}
+
+void PowerManager::activity()
+{
+  lastActivity = millis();
+  if (currentMhz != POWER_FULL_MHZ)
+    setMhz(POWER_FULL_MHZ);
+}
+
+void PowerManager::setMhz(uint8_t mhz)
+{
+  uint32_t now = micros();
+  addBusy(now - lastIdleEnd); // close the busy stretch at the old clock
+  lastIdleEnd = now;
+  clockSwitch(mhz);
+  currentMhz = mhz;
+}
+
+void PowerManager::idle(uint32_t untilNextWork)
+{
+  if (currentMhz == POWER_FULL_MHZ && millis() - lastActivity >= POWER_SLOW_AFTER_MILLIS)
+    setMhz(POWER_IDLE_MHZ);
+
+  uint32_t start = micros();
+  addBusy(start - lastIdleEnd);
+  if (untilNextWork > maxIdle)
+    untilNextWork = maxIdle;
+  if (untilNextWork > 0)
+    delay(untilNextWork); // pulses and the bin and click timers keep running on interrupts
+  else
+    yield();
+  lastIdleEnd = micros();
+  idleMicros += lastIdleEnd - start;
+  displayIdleMicros[!displayOn] += lastIdleEnd - start;
+}
+
+void PowerManager::addBusy(uint32_t micros)
+{
+  busyMicros[currentMhz != POWER_FULL_MHZ] += micros;
+  displayBusyMicros[!displayOn] += micros;
+}
+
+static unsigned busyPermille(uint64_t busy, uint64_t idle)
+{
+  return busy + idle ? (unsigned)(busy * 1000 / (busy + idle)) : 0;
+}
+
+uint16_t PowerManager::currentMilliamps() const
+{
+  uint64_t total = busyMicros[0] + busyMicros[1] + idleMicros;
+  uint32_t ma = POWER_BOARD_MA;
+  if (displayOn)
+    ma += POWER_DISPLAY_MA;
+  if (backlightOn)
+    ma += POWER_BACKLIGHT_MA;
+  if (wifiOn)
+    ma += POWER_WIFI_MA;
+  if (total == 0)
+    return ma + POWER_CPU_BUSY_160_MA;
+  ma += (busyMicros[0] * POWER_CPU_BUSY_160_MA + busyMicros[1] * POWER_CPU_BUSY_80_MA + idleMicros * POWER_CPU_IDLE_MA) / total;
+  return ma;
+}
+
+void PowerManager::report(Print &out)
+{
+  uint64_t total = busyMicros[0] + busyMicros[1] + idleMicros;
+  char line[80];
+  snprintf(line, sizeof(line), "power %u MHz busy %u%% (%u%% at 160, %u%% at 80) est %u mA", currentMhz,
+           total ? (unsigned)((busyMicros[0] + busyMicros[1]) * 100 / total) : 100,
+           total ? (unsigned)(busyMicros[0] * 100 / total) : 100,
+           total ? (unsigned)(busyMicros[1] * 100 / total) : 0, currentMilliamps());
+  out.println(line);
+  // what the loop does with the display awake against asleep, the share of time it was not idling in each
+  unsigned awake = busyPermille(displayBusyMicros[0], displayIdleMicros[0]);
+  unsigned asleep = busyPermille(displayBusyMicros[1], displayIdleMicros[1]);
+  snprintf(line, sizeof(line), "power busy %u.%u%% display awake (%u s), %u.%u%% asleep (%u s)", awake / 10, awake % 10,
+           (unsigned)((displayBusyMicros[0] + displayIdleMicros[0]) / 1000000), asleep / 10, asleep % 10,
+           (unsigned)((displayBusyMicros[1] + displayIdleMicros[1]) / 1000000));
+  out.println(line);
+  busyMicros[0] = busyMicros[1] = idleMicros = 0;
+  displayBusyMicros[0] = displayBusyMicros[1] = displayIdleMicros[0] = displayIdleMicros[1] = 0;
+}
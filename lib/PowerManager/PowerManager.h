@@ -0,0 +1,60 @@
+/*  Power manager for portable operation
+    Between pieces of work loop() hands the time until the next one to idle(), which waits in delay() so the SDK
+    can idle the CPU instead of spinning. After a while without user input the CPU drops to the idle clock and
+    goes back to full speed on the next input. The clock switch itself is done by the firmware, everything
+    that counts CPU cycles has to follow it.
+    The current estimate weights rough figures for the stock board by the time spent in each state.
+*/
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <Arduino.h>
+
+#define POWER_MAX_IDLE_MILLIS 20        // longest single wait, keeps touch polling and bin handling responsive
+#define POWER_SLOW_AFTER_MILLIS 15000   // no input for this long drops the CPU to the idle clock
+#define POWER_FULL_MHZ 160
+#define POWER_IDLE_MHZ 80
+
+// rough figures for the stock board in mA, measure yours and adjust
+#define POWER_CPU_BUSY_160_MA 28        // ESP8266 running flat out with the radio off
+#define POWER_CPU_BUSY_80_MA 18
+#define POWER_CPU_IDLE_MA 12            // waiting in delay()
+#define POWER_DISPLAY_MA 6              // ILI9341 controller and panel, awake
+#define POWER_BACKLIGHT_MA 40           // wired to VCC on the stock board
+#define POWER_BOARD_MA 12               // tube supply, regulators and the rest
+#define POWER_WIFI_MA 70                // station mode average with modem sleep
+
+typedef void (*CpuClockSwitch)(uint8_t mhz);
+
+class PowerManager
+{
+public:
+  void begin(CpuClockSwitch clockSwitch);
+  void activity();                   // user input, back to full speed
+  void idle(uint32_t untilNextWork); // end of loop(), waits up to the given ms while nothing is due
+  uint8_t mhz() const { return currentMhz; }
+
+  uint16_t currentMilliamps() const; // estimate over the time since the last report
+  void report(Print &out);           // clock, busy share with the display awake and asleep, current estimate. Starts a new window
+
+  uint16_t maxIdle = POWER_MAX_IDLE_MILLIS; // raised while nothing needs a quick response, e.g. with the display asleep
+  bool displayOn = true;
+  bool backlightOn = true;
+  bool wifiOn = false;
+
+private:
+  void setMhz(uint8_t mhz);
+  void addBusy(uint32_t micros);
+
+  CpuClockSwitch clockSwitch = NULL;
+  uint8_t currentMhz = POWER_FULL_MHZ;
+  uint32_t lastActivity = 0;
+
+  uint32_t lastIdleEnd = 0;   // micros() when the last wait ended, the time since then was busy
+  uint64_t busyMicros[2] = {0, 0}; // per clock, index 1 is the idle clock
+  uint64_t idleMicros = 0;
+  uint64_t displayBusyMicros[2] = {0, 0}; // by display state, index 1 is asleep
+  uint64_t displayIdleMicros[2] = {0, 0};
+};
+
+#endif
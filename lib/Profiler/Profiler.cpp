@@ -0,0 +1,33 @@
+#include "Profiler.h"
+
+static const char *const sectionNames[PROFILE_SECTIONS] = {"loop", "isr", "bin", "render", "page", "touch", "log", "upload", "json"};
+
+void Profiler::reset()
+{
+  memset(stats, 0, sizeof(stats));
+  for (uint8_t i = 0; i < PROFILE_SECTIONS; i++)
+    stats[i].min = UINT32_MAX;
+}
+
+void Profiler::report(Print &out) const
+{
+  char line[48];
+  for (uint8_t i = 0; i < PROFILE_SECTIONS; i++)
+  {
+    SectionStats s = stats[i]; // copy first, the ISR section may change while printing
+    if (s.count == 0)
+      continue;
+    snprintf(line, sizeof(line), "%-6s n %lu us %lu/%lu/%lu", sectionNames[i], (unsigned long)s.count,
+             (unsigned long)s.min, (unsigned long)(s.total / s.count), (unsigned long)s.max);
+    out.print(line);
+    out.print(" |"); // histogram as log2(µs):count for the buckets in use
+    for (uint8_t b = 0; b < PROFILE_BUCKETS; b++)
+    {
+      if (s.histogram[b] == 0)
+        continue;
+      snprintf(line, sizeof(line), " %u:%u", b, s.histogram[b]);
+      out.print(line);
+    }
+    out.println();
+  }
+}
@@ -0,0 +1,97 @@
+/*  Cycle-count profiler for named sections of the firmware
+    Sections are timed with the cycle counter and each sample is turned into µs when it is recorded, at the clock
+    it was taken at: the power manager switches between 160 and 80 MHz, so stats kept in cycles would mix both.
+    setClock() follows the switch; a section must not span one, which holds as idle is outside every scope.
+    Each section keeps count, min, max, total and a log2 histogram of its duration. Recording is a multiply and a
+    handful of instructions, forced inline, so it can be used in the ISRs. Everything is compiled out unless
+    PROFILING is defined, PROFILE_SCOPE then expands to nothing.
+*/
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+
+#define PROFILE_BUCKETS 32 // bucket b counts durations of 2^b up to 2^(b+1) - 1 µs
+
+enum ProfileSection
+{
+  PROFILE_LOOP,   // one pass of loop()
+  PROFILE_ISR,    // pulse interrupt, queue push and click
+  PROFILE_BIN,    // draining the queue, closing bins and the reading, including the render
+  PROFILE_RENDER, // home page readings
+  PROFILE_PAGE,   // leaving one page and drawing the next
+  PROFILE_TOUCH,  // touch polling and dispatch, including whatever the page does with it
+  PROFILE_LOG,
+  PROFILE_UPLOAD,
+  PROFILE_JSON,   // building the bulk upload from the logged data
+  PROFILE_SECTIONS
+};
+
+struct SectionStats
+{
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t total;
+  uint16_t histogram[PROFILE_BUCKETS]; // saturates instead of wrapping
+};
+
+class Profiler
+{
+public:
+  Profiler()
+  {
+    reset();
+    setClock(F_CPU / 1000000);
+  }
+
+  // rounded up, so a whole number of µs in cycles never comes out one short
+  void setClock(uint32_t cyclesPerMicro) { microsPerCycle = ((1ULL << 32) + cyclesPerMicro - 1) / cyclesPerMicro; }
+
+  inline __attribute__((always_inline)) void record(uint8_t section, uint32_t cycles)
+  {
+    uint32_t micros = (uint64_t)cycles * microsPerCycle >> 32; // no division in an ISR
+    SectionStats &s = stats[section];
+    s.count++;
+    s.total += micros;
+    if (micros < s.min)
+      s.min = micros;
+    if (micros > s.max)
+      s.max = micros;
+    uint8_t bucket = 31 - __builtin_clz(micros | 1);
+    if (s.histogram[bucket] != 0xFFFF)
+      s.histogram[bucket]++;
+  }
+
+  void reset();
+  void report(Print &out) const;        // one line per section that ran
+  const SectionStats &section(uint8_t id) const { return stats[id]; }
+
+private:
+  SectionStats stats[PROFILE_SECTIONS]; // in µs
+  uint32_t microsPerCycle; // in 2^-32 µs
+};
+
+class ProfileScope // records the cycles from construction to the end of the enclosing block
+{
+public:
+  inline __attribute__((always_inline)) ProfileScope(Profiler &profiler, uint8_t section)
+      : profiler(profiler), section(section), start(ESP.getCycleCount()) {}
+  inline __attribute__((always_inline)) ~ProfileScope() { profiler.record(section, ESP.getCycleCount() - start); }
+
+private:
+  Profiler &profiler;
+  uint8_t section;
+  uint32_t start;
+};
+
+#ifdef PROFILING
+extern Profiler profiler;
+#define PROFILE_JOIN(a, b) a##b
+#define PROFILE_NAME(line) PROFILE_JOIN(profileScope, line)
+#define PROFILE_SCOPE(section) ProfileScope PROFILE_NAME(__LINE__)(profiler, section) // one per line, scopes can nest
+#else
+#define PROFILE_SCOPE(section)
+#endif
+
+#endif
@@ -0,0 +1,123 @@
+#include "Scheduler.h"
+
+#define SLOT_MASK (SCHEDULER_WHEEL_SLOTS - 1)
+
+Scheduler::Scheduler()
+{
+  for (uint8_t s = 0; s < SCHEDULER_WHEEL_SLOTS; s++)
+    wheel[s] = -1;
+}
+
+int8_t Scheduler::add(const char *name, TaskFunction function, uint32_t period, uint32_t deadline, uint32_t firstDelay)
+{
+  if (taskCount == SCHEDULER_MAX_TASKS || period == 0)
+    return -1;
+  int8_t id = taskCount++;
+  SchedulerTask &t = tasks[id];
+  memset(&t, 0, sizeof(t));
+  t.name = name;
+  t.function = function;
+  t.period = period;
+  t.deadline = deadline;
+  t.due = millis() + firstDelay;
+  insert(id);
+  return id;
+}
+
+void Scheduler::insert(int8_t id)
+{
+  uint8_t slot = (tasks[id].due >> SCHEDULER_TICK_SHIFT) & SLOT_MASK;
+  tasks[id].next = wheel[slot];
+  wheel[slot] = id;
+}
+
+void Scheduler::run()
+{
+  uint32_t now = millis();
+  uint32_t tick = now >> SCHEDULER_TICK_SHIFT;
+  uint32_t steps = tick - lastTick; // the slot of lastTick is visited again, a task may have become due later in that tick
+  if (steps >= SCHEDULER_WHEEL_SLOTS)
+    steps = SCHEDULER_WHEEL_SLOTS - 1; // fell behind by a whole turn, every slot once is enough
+  lastTick = tick;
+
+  int8_t ready = -1; // due tasks are unlinked first, so rescheduling can't put one back into a slot being walked
+  for (uint32_t s = 0; s <= steps; s++)
+  {
+    int8_t *link = &wheel[(tick - s) & SLOT_MASK];
+    while (*link >= 0)
+    {
+      int8_t id = *link;
+      if ((int32_t)(now - tasks[id].due) >= 0)
+      {
+        *link = tasks[id].next;
+        tasks[id].next = ready;
+        ready = id;
+      }
+      else
+        link = &tasks[id].next; // due on a later turn of the wheel
+    }
+  }
+
+  while (ready >= 0)
+  {
+    int8_t id = ready;
+    ready = tasks[id].next;
+    execute(id);
+    insert(id);
+  }
+}
+
+uint32_t Scheduler::untilNext() const
+{
+  uint32_t now = millis();
+  uint32_t wait = UINT32_MAX;
+  for (uint8_t id = 0; id < taskCount; id++)
+  {
+    int32_t left = (int32_t)(tasks[id].due - now);
+    if (left <= 0)
+      return 0;
+    if ((uint32_t)left < wait)
+      wait = left;
+  }
+  return wait;
+}
+
+void Scheduler::execute(int8_t id)
+{
+  SchedulerTask &t = tasks[id];
+  uint32_t start = millis(); // a task ahead of this one may have taken a while
+  uint32_t late = start - t.due;
+  if (late > t.deadline)
+    t.overruns++;
+  if (late > t.maxLate)
+    t.maxLate = late;
+
+  uint32_t startMicros = micros();
+  t.function();
+  uint32_t duration = micros() - startMicros;
+  if (duration > t.maxDuration)
+    t.maxDuration = duration;
+  t.runs++;
+
+  t.due += t.period; // stays on the original grid, no drift from late starts
+  uint32_t now = millis();
+  if ((int32_t)(now - t.due) >= 0)
+  {
+    uint32_t missed = (now - t.due) / t.period + 1; // don't run a burst to catch up
+    t.skipped += missed;
+    t.due += missed * t.period;
+  }
+}
+
+void Scheduler::report(Print &out) const
+{
+  char line[112];
+  for (uint8_t id = 0; id < taskCount; id++)
+  {
+    const SchedulerTask &t = tasks[id];
+    snprintf(line, sizeof(line), "%-8s runs %lu overruns %lu skipped %lu late %lu ms run %lu us",
+             t.name, (unsigned long)t.runs, (unsigned long)t.overruns, (unsigned long)t.skipped,
+             (unsigned long)t.maxLate, (unsigned long)t.maxDuration);
+    out.println(line);
+  }
+}
@@ -0,0 +1,56 @@
+/*  Cooperative scheduler for the periodic work of the firmware
+    Tasks are kept on a hashed timing wheel: a task sits in the slot of the tick it is due in, so run() only looks
+    at the slots of the ticks that passed since the last call instead of every task. Tasks run to completion from
+    loop(), so a long TFT redraw still delays them, but it can no longer stop them, and the stats show by how much
+    they were late and how long each run took.
+*/
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+#define SCHEDULER_MAX_TASKS 8
+#define SCHEDULER_WHEEL_SLOTS 32   // must be a power of two
+#define SCHEDULER_TICK_SHIFT 4     // a slot covers 16 ms, the wheel goes round every 512 ms
+
+typedef void (*TaskFunction)();
+
+struct SchedulerTask
+{
+  const char *name;
+  TaskFunction function;
+  uint32_t period;       // ms between runs
+  uint32_t deadline;     // ms a run may start late before it counts as an overrun
+  uint32_t due;          // millis() of the next run
+  int8_t next;           // next task in the same wheel slot, -1 at the end
+
+  uint32_t runs;
+  uint32_t overruns;     // runs that started more than deadline late
+  uint32_t skipped;      // whole periods missed, not made up
+  uint32_t maxLate;      // ms
+  uint32_t maxDuration;  // µs
+};
+
+class Scheduler
+{
+public:
+  Scheduler();
+
+  int8_t add(const char *name, TaskFunction function, uint32_t period, uint32_t deadline, uint32_t firstDelay); // task id, -1 when full
+  void run();                                  // call every loop, runs whatever is due
+  void report(Print &out) const;               // one line of stats per task
+  uint32_t untilNext() const;                  // ms until the next task is due, 0 if one is due now
+  const SchedulerTask &task(int8_t id) const { return tasks[id]; }
+  uint8_t count() const { return taskCount; }
+
+private:
+  void insert(int8_t id);
+  void execute(int8_t id);
+
+  SchedulerTask tasks[SCHEDULER_MAX_TASKS];
+  int8_t wheel[SCHEDULER_WHEEL_SLOTS];          // first task of each slot
+  uint8_t taskCount = 0;
+  uint32_t lastTick = 0;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#include "Settings.h"
+#include <Crc32.h>
+#include <stddef.h>
+#include <string.h>
+
+#define SETTINGS_PATH "/settings"
+#define SETTINGS_TEMP_PATH "/settings.tmp"
+
+uint32_t Settings::checksum(SettingsHeader &header) const
+{
+  return crc32(&data, header.bytes, crc32(&header, offsetof(SettingsHeader, crc)));
+}
+
+bool Settings::load()
+{
+  data = SettingsData();
+  storedCrc = 0;
+  File file = LittleFS.open(SETTINGS_PATH, "r");
+  if (!file)
+    return false;
+  SettingsHeader header;
+  bool valid = file.read((uint8_t *)&header, sizeof(header)) == sizeof(header) && header.magic == SETTINGS_MAGIC &&
+               header.bytes <= sizeof(SettingsData) && file.read((uint8_t *)&data, header.bytes) == header.bytes &&
+               checksum(header) == header.crc;
+  file.close();
+  if (!valid)
+  {
+    data = SettingsData();
+    return false;
+  }
+  if (header.version == SETTINGS_VERSION && header.bytes == sizeof(SettingsData))
+    storedCrc = header.crc; // an older record is rewritten in the current layout on the next save
+  return true;
+}
+
+bool Settings::save()
+{
+  SettingsHeader header = {SETTINGS_MAGIC, SETTINGS_VERSION, 0, sizeof(SettingsData), 0, 0};
+  header.crc = checksum(header);
+  if (header.crc == storedCrc)
+    return true; // unchanged, saves flash wear
+  File file = LittleFS.open(SETTINGS_TEMP_PATH, "w");
+  if (!file)
+    return false;
+  bool written = file.write((const uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+                 file.write((const uint8_t *)&data, sizeof(data)) == sizeof(data);
+  file.close();
+  if (!written || !LittleFS.rename(SETTINGS_TEMP_PATH, SETTINGS_PATH)) // the rename is the commit, it replaces the old record in one step
+  {
+    LittleFS.remove(SETTINGS_TEMP_PATH);
+    return false;
+  }
+  storedCrc = header.crc;
+  return true;
+}
+
+bool Settings::loadRecord(uint8_t record, void *blob, size_t size) const
+{
+  if (record >= SETTINGS_RECORDS || size >= SETTINGS_RECORD_BYTES || data.records[record][0] != size)
+    return false;
+  memcpy(blob, &data.records[record][1], size);
+  return true;
+}
+
+void Settings::saveRecord(uint8_t record, const void *blob, size_t size)
+{
+  if (record >= SETTINGS_RECORDS || size >= SETTINGS_RECORD_BYTES)
+    return;
+  data.records[record][0] = size;
+  memcpy(&data.records[record][1], blob, size);
+  save();
+}
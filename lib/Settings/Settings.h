@@ -0,0 +1,69 @@
+/*  Device settings as one versioned record on LittleFS
+    Everything the device remembers between boots is in SettingsData, stored behind a header with a version and a
+    CRC-32. save() writes a temporary file and renames it over the old one, so a power cut leaves either the old or
+    the new record, never a mix. Only the record is read, there is no RAM mirror of a flash sector.
+    New fields go at the end of SettingsData: a shorter record written by older firmware is read as far as it goes
+    and the rest keeps its defaults.
+    The filesystem has to be mounted first, FlashLog::begin() does that.
+*/
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#define SETTINGS_MAGIC 0x4753          // "SG"
+#define SETTINGS_VERSION 4             // 2 uploadHost and uploadPort, 3 the WiFi cache, 4 customWindow and ttcSwitchCpm
+#define SETTINGS_RECORDS 4             // blobs of the measurement core, see StorageRecord
+#define SETTINGS_RECORD_BYTES 16       // first byte is the length, 0 when nothing is stored
+
+// Append only: fields are never moved, resized or removed, new ones go at the end with their defaults and
+// SETTINGS_VERSION goes up by one. load() relies on that to read an older, shorter record.
+struct SettingsData
+{
+  uint8_t doseUnits = 0;               // 0 = Sievert, 1 = Rem
+  uint8_t alarmThreshold = 5;
+  uint8_t deviceMode = 0;              // 1 = monitoring station
+  uint8_t isLogging = 0;
+  uint16_t conversionFactor = 175;     // CPM per uSv/hr, the legacy layout had a single byte for it
+  char ssid[33] = "";                  // lengths of the 802.11 limits plus the terminator
+  char password[65] = "";
+  char channelID[21] = "";
+  char apiKey[21] = "";
+  uint8_t records[SETTINGS_RECORDS][SETTINGS_RECORD_BYTES] = {};
+  char uploadHost[33] = "api.thingspeak.com"; // can point at a local stand-in server for testing
+  uint16_t uploadPort = 80;
+  uint8_t wifiBssid[6] = {};           // access point of the last good connection, lets the station skip the scan
+  uint8_t wifiChannel = 0;             // 0 when nothing is cached
+  uint16_t customWindow = 600;         // seconds, integration time of the custom INT setting
+  uint32_t ttcSwitchCpm = 30000;       // home reading switches to time to count above this, 0 = never
+};
+
+struct SettingsHeader
+{
+  uint16_t magic;
+  uint8_t version;
+  uint8_t reserved;
+  uint16_t bytes;                      // size of the SettingsData that follows
+  uint16_t reserved2;
+  uint32_t crc;                        // over the header up to here and the data
+};
+
+class Settings
+{
+public:
+  bool load();                         // false if there is no valid record, data then holds the defaults
+  bool save();                         // writes only if something changed since the last load or save
+
+  bool loadRecord(uint8_t record, void *blob, size_t size) const; // storage for the measurement core
+  void saveRecord(uint8_t record, const void *blob, size_t size);
+
+  SettingsData data;
+
+private:
+  uint32_t checksum(SettingsHeader &header) const;
+
+  uint32_t storedCrc = 0;              // CRC of what is on flash, 0 when nothing is
+};
+
+#endif
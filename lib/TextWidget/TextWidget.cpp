@@ -0,0 +1,53 @@
+#include "TextWidget.h"
+#include <string.h>
+
+#define WINDOW_BYTES 11 // column, page and memory write commands that open every drawing window on the ILI9341
+
+void RenderStats::endFrame()
+{
+  lastFrame = frameBytes;
+  if (frameBytes > maxFrame)
+    maxFrame = frameBytes;
+  totalBytes += frameBytes;
+  frames++;
+  frameBytes = 0;
+}
+
+TextWidget::TextWidget(int16_t x, int16_t y, uint8_t size, uint16_t color, uint16_t background)
+    : x(x), y(y), size(size), color(color), background(background)
+{
+  shown[0] = 0;
+}
+
+void TextWidget::invalidate()
+{
+  valid = false;
+}
+
+uint32_t TextWidget::render(Adafruit_GFX &gfx, const char *text)
+{
+  uint32_t bytes = 0;
+  size_t oldLength = valid ? strlen(shown) : 0;
+  size_t newLength = strnlen(text, TEXT_WIDGET_LENGTH);
+  int16_t cellWidth = 6 * size;
+
+  gfx.setFont(); // drawChar uses whichever font is selected
+  for (size_t i = 0; i < newLength; i++)
+  {
+    if (i < oldLength && shown[i] == text[i])
+      continue;
+    gfx.drawChar(x + i * cellWidth, y, text[i], color, background, size);
+    bytes += 48 * (WINDOW_BYTES + 2 * size * size); // each of the 6x8 font pixels is filled as its own block
+  }
+  if (oldLength > newLength) // text got shorter, clear what is left of the old one
+  {
+    int16_t width = (oldLength - newLength) * cellWidth;
+    gfx.fillRect(x + newLength * cellWidth, y, width, 8 * size, background);
+    bytes += WINDOW_BYTES + 2 * width * 8 * size;
+  }
+
+  memcpy(shown, text, newLength);
+  shown[newLength] = 0;
+  valid = true;
+  return bytes;
+}
@@ -0,0 +1,41 @@
+/*  Retained-mode text widgets
+    A widget remembers the text it last drew and where. render() compares new text with it and redraws only the
+    character cells that changed, background included, so a reading that did not change costs no SPI traffic.
+    Uses the built-in 6x8 font, scaled by size.
+*/
+#ifndef TEXT_WIDGET_H
+#define TEXT_WIDGET_H
+
+#include <Adafruit_GFX.h>
+
+#define TEXT_WIDGET_LENGTH 16
+
+struct RenderStats
+{
+  void add(uint32_t bytes) { frameBytes += bytes; }
+  void endFrame();
+
+  uint32_t frameBytes = 0; // bytes pushed so far in the current frame
+  uint32_t lastFrame = 0;  // bytes pushed by the last completed frame
+  uint32_t maxFrame = 0;
+  uint32_t totalBytes = 0;
+  uint32_t frames = 0;
+};
+
+class TextWidget
+{
+public:
+  TextWidget(int16_t x, int16_t y, uint8_t size, uint16_t color, uint16_t background);
+
+  uint32_t render(Adafruit_GFX &gfx, const char *text); // returns the approximate number of bytes sent to the display
+  void invalidate(); // the area was drawn over, the next render draws every character
+
+private:
+  int16_t x, y;
+  uint8_t size;
+  uint16_t color, background;
+  char shown[TEXT_WIDGET_LENGTH + 1]; // what is on screen now
+  bool valid = false;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#include "TouchInput.h"
+
+TouchInput::TouchInput(XPT2046_Touchscreen &ts, int16_t minX, int16_t maxX, int16_t minY, int16_t maxY, int16_t width, int16_t height)
+    : ts(ts), minX(minX), maxX(maxX), minY(minY), maxY(maxY), width(width), height(height)
+{
+}
+
+void TouchInput::poll(uint32_t now)
+{
+#ifdef TOUCH_IRQ_PIN
+  if (!down && !ts.tirqTouched())
+    return; // nothing touched since the last press ended, no need to ask the controller
+#endif
+  if (now - lastPoll < (down ? TOUCH_POLL_MILLIS : pollMillis))
+    return;
+  lastPoll = now;
+
+  bool touched = ts.touched();
+  if (touched && !down)
+  {
+    TS_Point p = ts.getPoint();
+    pressX = map(p.x, minX, maxX, width, 0); // get touch point and map to screen pixels
+    pressY = map(p.y, minY, maxY, height, 0);
+    down = true;
+    cancelled = false;
+    longSent = false;
+    liftMillis = 0;
+    pressMillis = now;
+    nextRepeat = now + TOUCH_REPEAT_DELAY_MILLIS;
+    push(TOUCH_PRESS);
+  }
+  else if (touched)
+  {
+    liftMillis = 0;
+    if (!longSent && now - pressMillis >= TOUCH_LONG_PRESS_MILLIS)
+    {
+      longSent = true;
+      push(TOUCH_LONG_PRESS);
+    }
+    if ((int32_t)(now - nextRepeat) >= 0)
+    {
+      nextRepeat += TOUCH_REPEAT_MILLIS;
+      push(TOUCH_REPEAT);
+    }
+  }
+  else if (down)
+  {
+    if (liftMillis == 0)
+      liftMillis = now | 1; // never 0 while set
+    else if (now - liftMillis >= TOUCH_RELEASE_MILLIS)
+    {
+      push(TOUCH_RELEASE);
+      down = false;
+    }
+  }
+}
+
+void TouchInput::push(uint8_t type)
+{
+  if (cancelled)
+    return;
+  uint8_t nextHead = (head + 1) & (TOUCH_QUEUE_SIZE - 1);
+  if (nextHead == tail)
+    return; // loop() is not reading events, drop the newest
+  queue[head].type = type;
+  queue[head].x = pressX;
+  queue[head].y = pressY;
+  head = nextHead;
+}
+
+bool TouchInput::next(TouchEvent &event)
+{
+  if (tail == head)
+    return false;
+  event = queue[tail];
+  tail = (tail + 1) & (TOUCH_QUEUE_SIZE - 1);
+  return true;
+}
+
+void TouchInput::cancel()
+{
+  tail = head;
+  cancelled = down;
+}
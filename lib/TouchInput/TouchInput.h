@@ -0,0 +1,65 @@
+/*  Touch events for the XPT2046
+    poll() turns the controller state into press, release, long press and auto-repeat events in a small queue.
+    Polling is the default, because T_IRQ is not connected on the GC-20 board: without TOUCH_IRQ_PIN the
+    controller is read over SPI every TOUCH_POLL_MILLIS (SLEEP_POLL_MILLIS while the display sleeps) instead of on
+    every loop. A board with T_IRQ wired to a free GPIO can build with -D TOUCH_IRQ_PIN=<gpio>, the library's pin
+    interrupt then flags a touch and poll() does no SPI at all until one happens.
+*/
+#ifndef TOUCH_INPUT_H
+#define TOUCH_INPUT_H
+
+#include <XPT2046_Touchscreen.h>
+
+#define TOUCH_QUEUE_SIZE 8         // must be a power of two
+#define TOUCH_POLL_MILLIS 20       // default SPI poll interval without T_IRQ, always used while a touch is held
+#define TOUCH_RELEASE_MILLIS 40    // pressure has to stay low this long for a release, rides over dips in a press
+#define TOUCH_LONG_PRESS_MILLIS 800
+#define TOUCH_REPEAT_DELAY_MILLIS 400
+#define TOUCH_REPEAT_MILLIS 100
+
+enum TouchEventType
+{
+  TOUCH_PRESS,
+  TOUCH_RELEASE,
+  TOUCH_LONG_PRESS, // once per press, held for TOUCH_LONG_PRESS_MILLIS
+  TOUCH_REPEAT      // every TOUCH_REPEAT_MILLIS after TOUCH_REPEAT_DELAY_MILLIS while held
+};
+
+struct TouchEvent
+{
+  uint8_t type;
+  int16_t x, y; // screen pixels of the press
+};
+
+class TouchInput
+{
+public:
+  TouchInput(XPT2046_Touchscreen &ts, int16_t minX, int16_t maxX, int16_t minY, int16_t maxY, int16_t width, int16_t height);
+
+  void poll(uint32_t now);        // call every loop
+  bool next(TouchEvent &event);   // oldest queued event, false if there is none
+  void cancel();                  // drop queued events and ignore the rest of the current press, e.g. after a page change
+  bool held() const { return down; }
+  void setPollInterval(uint16_t millis) { pollMillis = millis; } // between SPI polls while nothing is held
+
+private:
+  void push(uint8_t type);
+
+  XPT2046_Touchscreen &ts;
+  int16_t minX, maxX, minY, maxY, width, height; // raw calibration and screen size
+  TouchEvent queue[TOUCH_QUEUE_SIZE];
+  uint8_t head = 0;
+  uint8_t tail = 0;
+
+  bool down = false;       // a press is in progress
+  bool cancelled = false;  // the press in progress no longer produces events
+  bool longSent = false;
+  int16_t pressX, pressY;
+  uint16_t pollMillis = TOUCH_POLL_MILLIS;
+  uint32_t lastPoll = 0;
+  uint32_t pressMillis;
+  uint32_t liftMillis;     // when the pressure first dropped, 0 while pressed
+  uint32_t nextRepeat;
+};
+
+#endif
@@ -0,0 +1,119 @@
+#include "WifiLink.h"
+
+void WifiLink::begin(const char *ssid, const char *password, const WifiCache &cached)
+{
+  this->ssid = ssid;
+  this->password = password;
+  this->cached = cached;
+  WiFi.persistent(false);      // the credentials are in the settings, no flash write on every begin()
+  WiFi.setAutoReconnect(false); // reconnects are done here, with backoff and the cache
+  WiFi.forceSleepWake();
+  WiFi.mode(WIFI_STA);
+  backoff = WIFI_BACKOFF_MIN_MILLIS;
+  attempt(millis());
+}
+
+void WifiLink::end()
+{
+  state = WIFI_LINK_OFF;
+  WiFi.disconnect();
+  WiFi.mode(WIFI_OFF);
+  WiFi.forceSleepBegin();
+}
+
+void WifiLink::attempt(uint32_t now, bool scan)
+{
+  fast = cached.channel != 0 && !scan;
+  attempts++;
+  if (fast)
+  {
+    fastAttempts++;
+    WiFi.begin(ssid, password, cached.channel, cached.bssid); // joins without a scan
+  }
+  else
+    WiFi.begin(ssid, password);
+  state = WIFI_LINK_CONNECTING;
+  stateStart = now;
+}
+
+void WifiLink::failed(uint32_t now)
+{
+  WiFi.disconnect();
+  if (fast)
+  {
+    attempt(now, true); // the router may have moved to another channel, scan right away
+    return;
+  }
+  state = WIFI_LINK_WAITING;
+  stateStart = now;
+}
+
+void WifiLink::poll(uint32_t now)
+{
+  uint32_t elapsed = now - stateStart;
+  switch (state)
+  {
+  case WIFI_LINK_CONNECTING:
+    if (WiFi.status() == WL_CONNECTED)
+    {
+      state = WIFI_LINK_UP;
+      stateStart = now;
+      backoff = WIFI_BACKOFF_MIN_MILLIS;
+      connects++;
+      if (fast)
+        fastConnects++;
+      lastConnectMillis = elapsed;
+      minConnectMillis = min(minConnectMillis, elapsed);
+      maxConnectMillis = max(maxConnectMillis, elapsed);
+      totalConnectMillis += elapsed;
+      int32_t channel = WiFi.channel();
+      const uint8_t *bssid = WiFi.BSSID();
+      if (bssid && (channel != cached.channel || memcmp(bssid, cached.bssid, sizeof(cached.bssid)) != 0))
+      {
+        memcpy(cached.bssid, bssid, sizeof(cached.bssid));
+        cached.channel = channel;
+        changed = true;
+      }
+    }
+    else if (elapsed > (fast ? WIFI_FAST_CONNECT_MILLIS : WIFI_CONNECT_MILLIS))
+      failed(now);
+    break;
+
+  case WIFI_LINK_UP:
+    if (WiFi.status() != WL_CONNECTED)
+    {
+      drops++;
+      attempt(now); // straight back with the cache, the backoff is for attempts that fail
+    }
+    break;
+
+  case WIFI_LINK_WAITING:
+    if (elapsed >= backoff)
+    {
+      backoff = min(backoff * 2, (uint32_t)WIFI_BACKOFF_MAX_MILLIS);
+      attempt(now);
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+bool WifiLink::cacheChanged()
+{
+  bool result = changed;
+  changed = false;
+  return result;
+}
+
+void WifiLink::report(Print &out)
+{
+  char line[176]; // every count at its ten digits still fits
+  snprintf(line, sizeof(line), "wifi %s: %lu/%lu connects (%lu/%lu fast), %lu drops, connect ms last %lu min %lu avg %lu max %lu",
+           up() ? "up" : "down", (unsigned long)connects, (unsigned long)attempts, (unsigned long)fastConnects,
+           (unsigned long)fastAttempts, (unsigned long)drops, (unsigned long)lastConnectMillis,
+           (unsigned long)(connects ? minConnectMillis : 0), (unsigned long)(connects ? totalConnectMillis / connects : 0),
+           (unsigned long)maxConnectMillis);
+  out.println(line);
+}
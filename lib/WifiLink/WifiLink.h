@@ -0,0 +1,72 @@
+/*  WiFi station link with reconnects and a fast-connect cache
+    poll() from loop() watches the link and brings it back when it drops, waiting 1 s, 2 s, 4 s ... up to
+    WIFI_BACKOFF_MAX_MILLIS between attempts so a missing router does not keep the radio busy. The BSSID and
+    channel of the last good association are kept in a WifiCache, which the firmware saves with the settings:
+    with them the station joins without scanning every channel first. If a cached attempt fails a scan follows
+    right away, and the cache is replaced when the scan finds the network somewhere else. While the network stays
+    away each round starts with the cache again, so it is fast once the router is back.
+    Nothing here waits, an attempt in progress is just checked on the next poll().
+*/
+#ifndef WIFI_LINK_H
+#define WIFI_LINK_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+#define WIFI_FAST_CONNECT_MILLIS 3000    // attempt with the cached BSSID and channel
+#define WIFI_CONNECT_MILLIS 15000        // attempt with a scan
+#define WIFI_BACKOFF_MIN_MILLIS 1000
+#define WIFI_BACKOFF_MAX_MILLIS 300000
+
+struct WifiCache
+{
+  uint8_t bssid[6];
+  uint8_t channel;                       // 0 when nothing is cached
+};
+
+enum WifiLinkState
+{
+  WIFI_LINK_OFF,
+  WIFI_LINK_CONNECTING,
+  WIFI_LINK_UP,
+  WIFI_LINK_WAITING                      // backing off before the next attempt
+};
+
+class WifiLink
+{
+public:
+  void begin(const char *ssid, const char *password, const WifiCache &cached); // starts the first attempt
+  void end();                            // disconnects and turns the radio off
+  void poll(uint32_t now);
+  bool up() const { return state == WIFI_LINK_UP; }
+  bool connecting() const { return state == WIFI_LINK_CONNECTING; }
+  bool cacheChanged();                   // true once after the cache was updated, save it then
+  const WifiCache &cache() const { return cached; }
+  void report(Print &out);
+
+  // statistics since begin()
+  uint32_t attempts = 0;
+  uint32_t fastAttempts = 0;             // with the cache
+  uint32_t connects = 0;
+  uint32_t fastConnects = 0;
+  uint32_t drops = 0;                    // link lost after it was up
+  uint32_t lastConnectMillis = 0;
+  uint32_t minConnectMillis = UINT32_MAX;
+  uint32_t maxConnectMillis = 0;
+  uint32_t totalConnectMillis = 0;
+
+private:
+  void attempt(uint32_t now, bool scan = false);
+  void failed(uint32_t now);
+
+  const char *ssid = NULL;
+  const char *password = NULL;
+  WifiCache cached = {};
+  WifiLinkState state = WIFI_LINK_OFF;
+  uint32_t stateStart = 0;
+  uint32_t backoff = WIFI_BACKOFF_MIN_MILLIS;
+  bool fast = false;                     // the attempt in progress uses the cache
+  bool changed = false;
+};
+
+#endif
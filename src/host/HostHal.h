@@ -0,0 +1,60 @@
+/*  Host implementations of the measurement core HAL
+    Time is simulated in whole microseconds, so pulse timestamps are microseconds and cyclesPerMicro() is 1.
+*/
+#ifndef HOST_HAL_H
+#define HOST_HAL_H
+
+#include <Hal.h>
+#include <PulseQueue.h>
+
+#define LOCKOUT_MICROS 200 // same lockout as isr()
+
+class SimClock : public Clock
+{
+public:
+  uint32_t millis() { return micros / 1000; }
+  uint32_t cyclesPerMicro() { return 1; }
+  uint64_t micros = 0;
+};
+
+class SimPulseSource : public PulseSource
+{
+public:
+  SimPulseSource() { queue.lockout = LOCKOUT_MICROS; }
+
+  PulseSnapshot snapshot() { return queue.snapshot(); }
+  uint16_t drain(uint32_t *out, uint16_t maxCount) { return queue.drain(out, maxCount); }
+  void boundary(uint32_t &sequence, uint32_t &total)
+  {
+    sequence = boundarySeq;
+    total = boundaryTotal;
+  }
+
+  void pulse(uint32_t stamp) { queue.pulse(stamp); } // what isr() calls on the device
+
+  void closeBin() // what binTimerIsr() does on the device
+  {
+    boundaryTotal = queue.total();
+    boundarySeq++;
+  }
+
+  PulseQueue queue;
+  uint32_t boundarySeq = 0;
+  uint32_t boundaryTotal = 0;
+};
+
+class MemoryStorage : public Storage
+{
+public:
+  bool load(StorageRecord, void *, size_t) { return false; } // every run starts uncalibrated
+  void save(StorageRecord, const void *, size_t) {}
+};
+
+class NullSink : public DisplaySink
+{
+public:
+  void showReading(const Reading &) {}
+  void report(const char *) {}
+};
+
+#endif
@@ -0,0 +1,164 @@
+#include "LogTools.h"
+#include "Simulator.h"
+#include <LogBlock.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+struct DecodedEntry
+{
+  uint32_t seq;
+  uint16_t boot;
+  LogSample sample;
+};
+
+static bool readFile(const char *path, std::vector<uint8_t> &bytes)
+{
+  FILE *file = fopen(path, "rb");
+  if (!file)
+    return false;
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    bytes.insert(bytes.end(), chunk, chunk + n);
+  fclose(file);
+  return true;
+}
+
+int decodeLog(int count, char **paths)
+{
+  std::vector<DecodedEntry> entries;
+  long badBlocks = 0;
+  for (int f = 0; f < count; f++)
+  {
+    std::vector<uint8_t> bytes;
+    if (!readFile(paths[f], bytes))
+    {
+      fprintf(stderr, "can't read %s\n", paths[f]);
+      return 1;
+    }
+    size_t offset = 0;
+    while (offset + sizeof(LogBlockHeader) <= bytes.size())
+    {
+      LogBlockHeader header;
+      memcpy(&header, &bytes[offset], sizeof(header));
+      uint16_t payloadBytes = logBlockPayload(header);
+      if (payloadBytes == 0 || offset + sizeof(header) + payloadBytes > bytes.size())
+        break; // end of the written data, same rule as the firmware
+      const uint8_t *payload = &bytes[offset + sizeof(header)];
+      offset += sizeof(header) + payloadBytes;
+      LogSample samples[LOG_BLOCK_RECORDS];
+      if (!logBlockCrcValid(header, payload) || decodeLogBlock(header, payload, samples) != header.count)
+      {
+        badBlocks++;
+        continue;
+      }
+      for (uint8_t i = 0; i < header.count; i++)
+        entries.push_back({header.firstSeq + i, header.boot, samples[i]});
+    }
+  }
+  std::sort(entries.begin(), entries.end(), [](const DecodedEntry &a, const DecodedEntry &b) { return a.seq < b.seq; });
+  printf("seq,boot,seconds,cpm\n");
+  for (const DecodedEntry &e : entries)
+    printf("%u,%u,%u,%u\n", e.seq, e.boot, e.sample.seconds, e.sample.cpm);
+  fprintf(stderr, "%zu entries, %ld bad blocks\n", entries.size(), badBlocks);
+  return 0;
+}
+
+static std::vector<LogSample> simulatedTrace(double cps, double stepCps, uint32_t minutes, uint64_t seed) // one minute counts of a simulated tube
+{
+  RateProfile profile;
+  profile.hold(cps, minutes * 30);
+  profile.hold(stepCps, minutes * 30);
+  PulseTrain train(profile, 190, false, seed);
+  std::vector<LogSample> trace(minutes);
+  for (uint32_t m = 0; m < minutes; m++)
+    trace[m] = {(m + 1) * 60, 0};
+  for (uint64_t t = train.next(); t != UINT64_MAX; t = train.next())
+    trace[t / 60000000].cpm++;
+  return trace;
+}
+
+static bool loadTrace(const char *path, std::vector<LogSample> &trace) // "seconds,cpm" lines, e.g. the output of --decode-log
+{
+  FILE *file = fopen(path, "r");
+  if (!file)
+    return false;
+  char line[128];
+  while (fgets(line, sizeof(line), file))
+  {
+    unsigned seq, boot, seconds, cpm;
+    if (sscanf(line, "%u,%u,%u,%u", &seq, &boot, &seconds, &cpm) == 4 || sscanf(line, "%u,%u", &seconds, &cpm) == 2)
+      trace.push_back({seconds, cpm});
+  }
+  fclose(file);
+  return !trace.empty();
+}
+
+static void benchTrace(const char *name, const std::vector<LogSample> &trace)
+{
+  const int rounds = 20;
+  std::vector<uint8_t> stream(trace.size() * LOG_CODEC_MAX_BYTES);
+  size_t streamBytes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++)
+  {
+    LogEncoder encoder(stream.data(), stream.size());
+    for (const LogSample &s : trace)
+      encoder.add(s);
+    streamBytes = encoder.size();
+  }
+  double encodeNanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds / trace.size();
+
+  size_t decoded = 0;
+  bool exact = true;
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++)
+  {
+    LogDecoder decoder(stream.data(), streamBytes);
+    LogSample s;
+    decoded = 0;
+    while (decoder.next(s))
+    {
+      exact &= s.seconds == trace[decoded].seconds && s.cpm == trace[decoded].cpm;
+      decoded++;
+    }
+  }
+  double decodeNanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds / trace.size();
+
+  size_t flashBytes = 0; // as the firmware stores it, in blocks with their headers
+  for (size_t first = 0; first < trace.size(); first += LOG_BLOCK_RECORDS)
+  {
+    LogBlockHeader header = {};
+    header.count = (uint8_t)std::min<size_t>(LOG_BLOCK_RECORDS, trace.size() - first);
+    uint8_t payload[LOG_BLOCK_MAX_PAYLOAD];
+    encodeLogBlock(header, &trace[first], payload);
+    flashBytes += sizeof(header) + header.bytes;
+  }
+  size_t rawFlash = (trace.size() + LOG_BLOCK_RECORDS - 1) / LOG_BLOCK_RECORDS * sizeof(LogBlockHeader) + trace.size() * sizeof(LogSample);
+
+  printf("%-12s %7zu samples  stream %.2f B/sample  flash %.2f B/sample (raw %.2f, %.1fx)  encode %.1f ns  decode %.1f ns  %s\n",
+         name, trace.size(), (double)streamBytes / trace.size(), (double)flashBytes / trace.size(), (double)rawFlash / trace.size(),
+         (double)rawFlash / flashBytes, encodeNanos, decodeNanos, exact && decoded == trace.size() ? "exact" : "MISMATCH");
+}
+
+int codecBench(const char *tracePath)
+{
+  if (tracePath)
+  {
+    std::vector<LogSample> trace;
+    if (!loadTrace(tracePath, trace))
+    {
+      fprintf(stderr, "no samples in %s\n", tracePath);
+      return 1;
+    }
+    benchTrace(tracePath, trace);
+    return 0;
+  }
+  benchTrace("background", simulatedTrace(0.3, 0.3, 7 * 24 * 60, 1)); // a week at about 18 cpm
+  benchTrace("elevated", simulatedTrace(0.3, 5, 24 * 60, 2));          // a day, a source brought close half way
+  benchTrace("high", simulatedTrace(300, 300, 120, 3));                // two hours at 18000 cpm
+  return 0;
+}
@@ -0,0 +1,11 @@
+/*  Host tools for the flash log
+    decodeLog() prints the entries of segment files copied off the device. codecBench() measures the size and
+    speed of the log codec on traces of one minute CPM values.
+*/
+#ifndef LOG_TOOLS_H
+#define LOG_TOOLS_H
+
+int decodeLog(int count, char **paths);
+int codecBench(const char *tracePath); // NULL for simulated traces
+
+#endif
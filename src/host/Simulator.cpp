@@ -0,0 +1,103 @@
+#include "Simulator.h"
+#include <math.h>
+#include <stdlib.h>
+
+bool RateProfile::parse(const char *text)
+{
+  segments.clear();
+  while (*text)
+  {
+    char *end;
+    double cps = strtod(text, &end);
+    if (end == text || cps < 0 || (*end != ':' && *end != '~'))
+      return false;
+    bool isRamp = *end == '~';
+    text = end + 1;
+    long seconds = strtol(text, &end, 10);
+    if (end == text || seconds <= 0)
+      return false;
+    if (isRamp)
+      ramp(cps, seconds);
+    else
+      hold(cps, seconds);
+    if (*end && *end != ',')
+      return false;
+    text = *end ? end + 1 : end;
+  }
+  return !segments.empty();
+}
+
+void RateProfile::hold(double cps, uint32_t seconds)
+{
+  segments.push_back({cps, cps, seconds});
+}
+
+void RateProfile::ramp(double cps, uint32_t seconds)
+{
+  double from = segments.empty() ? 0 : segments.back().to;
+  segments.push_back({from, cps, seconds});
+}
+
+double RateProfile::rate(double t) const
+{
+  for (const RateSegment &s : segments)
+  {
+    if (t < s.seconds)
+      return s.from + (s.to - s.from) * t / s.seconds;
+    t -= s.seconds;
+  }
+  return 0;
+}
+
+double RateProfile::maxRate() const
+{
+  double m = 0;
+  for (const RateSegment &s : segments)
+    m = fmax(m, fmax(s.from, s.to));
+  return m;
+}
+
+uint32_t RateProfile::seconds() const
+{
+  uint32_t total = 0;
+  for (const RateSegment &s : segments)
+    total += s.seconds;
+  return total;
+}
+
+PulseTrain::PulseTrain(const RateProfile &p, uint32_t deadTimeMicros, bool isParalyzable, uint64_t seed)
+    : profile(p), deadTime(deadTimeMicros * 1e-6), paralyzable(isParalyzable), state(seed * 2685821657736338717ULL + 1)
+{
+}
+
+double PulseTrain::uniform()
+{
+  state ^= state >> 12; // xorshift64*, the same train on every platform for a given seed
+  state ^= state << 25;
+  state ^= state >> 27;
+  return ((state * 2685821657736338717ULL >> 11) + 0.5) / 9007199254740992.0;
+}
+
+uint64_t PulseTrain::next()
+{
+  double peak = profile.maxRate();
+  double end = profile.seconds();
+  if (peak <= 0)
+    return UINT64_MAX;
+  while (true)
+  {
+    t -= log(uniform()) / peak;
+    if (t >= end)
+      return UINT64_MAX;
+    if (uniform() * peak >= profile.rate(t))
+      continue; // thinned out, the rate here is below the peak
+    if (t < deadUntil)
+    {
+      if (paralyzable)
+        deadUntil = t + deadTime; // an event during the dead time extends it
+      continue;
+    }
+    deadUntil = t + deadTime;
+    return (uint64_t)(t * 1e6);
+  }
+}
@@ -0,0 +1,51 @@
+/*  Poisson pulse train simulator
+    A rate profile is a list of segments, each holding or ramping the true event rate for a number of seconds.
+    Events are drawn from the inhomogeneous Poisson process by thinning and then pass through a dead time
+    model of the tube, so the output is what the tube would put on the interrupt pin.
+*/
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stdint.h>
+#include <vector>
+
+struct RateSegment
+{
+  double from;      // cps at the start of the segment
+  double to;        // cps at the end, equal to from for a step
+  uint32_t seconds;
+};
+
+class RateProfile
+{
+public:
+  bool parse(const char *text); // "0.5:600,20:600,50~300" - rate:seconds holds, rate~seconds ramps from the previous rate
+  void hold(double cps, uint32_t seconds);
+  void ramp(double cps, uint32_t seconds);
+
+  double rate(double t) const; // cps at t seconds
+  double maxRate() const;
+  uint32_t seconds() const;
+
+private:
+  std::vector<RateSegment> segments;
+};
+
+class PulseTrain
+{
+public:
+  PulseTrain(const RateProfile &profile, uint32_t deadTimeMicros, bool paralyzable, uint64_t seed);
+  uint64_t next(); // microseconds of the next registered pulse, UINT64_MAX once the profile has ended
+
+private:
+  double uniform(); // (0, 1)
+
+  const RateProfile &profile;
+  double deadTime;    // seconds
+  bool paralyzable;
+  uint64_t state;     // xorshift state
+  double t = 0;       // time of the last event, registered or not
+  double deadUntil = 0;
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include "StandIn.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <string>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#define STAND_IN_TIMEOUT_SECONDS 10 // the device streams the body right after the head
+#define STAND_IN_MAX_BODY 262144    // well above BULK_MAX_ENTRIES updates
+
+static bool readRequest(int connection, std::string &head, std::string &body)
+{
+  std::string data;
+  char chunk[1460];
+  size_t headEnd;
+  while ((headEnd = data.find("\r\n\r\n")) == std::string::npos)
+  {
+    ssize_t n = recv(connection, chunk, sizeof(chunk), 0);
+    if (n <= 0 || data.size() > 4096)
+      return false;
+    data.append(chunk, n);
+  }
+  head = data.substr(0, headEnd);
+  body = data.substr(headEnd + 4);
+
+  long length = -1;
+  for (size_t line = 0; line < head.size(); line = head.find("\r\n", line) + 2)
+  {
+    if (strncasecmp(head.c_str() + line, "Content-Length:", 15) == 0)
+      length = strtol(head.c_str() + line + 15, NULL, 10);
+    if (head.find("\r\n", line) == std::string::npos)
+      break;
+  }
+  if (length < 0 || length > STAND_IN_MAX_BODY)
+  {
+    printf("  no usable Content-Length\n");
+    return false;
+  }
+  while ((long)body.size() < length)
+  {
+    ssize_t n = recv(connection, chunk, sizeof(chunk), 0);
+    if (n <= 0)
+    {
+      printf("  body cut short: %zu of %ld bytes\n", body.size(), length);
+      return false;
+    }
+    body.append(chunk, n);
+  }
+  if ((long)body.size() > length)
+    printf("  %zu bytes beyond the Content-Length of %ld\n", body.size() - length, length);
+  return true;
+}
+
+static void summarize(const std::string &head, const std::string &body)
+{
+  printf("  %s\n", head.substr(0, head.find("\r\n")).c_str());
+  if (body.compare(0, 18, "{\"write_api_key\":\"") != 0 || body.size() < 2 || body.compare(body.size() - 2, 2, "]}") != 0)
+  {
+    printf("  body is not a bulk update: %.60s\n", body.c_str());
+    return;
+  }
+
+  const char key[] = "\"created_at\":\"";
+  uint32_t updates = 0;
+  uint32_t relative = 0;
+  uint32_t disordered = 0;
+  std::string first, last;
+  for (size_t at = body.find("{\"", 1); at != std::string::npos; at = body.find("{\"", at + 1))
+  {
+    updates++;
+    size_t end = body.find('}', at);
+    size_t stamp = body.find(key, at);
+    if (stamp == std::string::npos || stamp > end)
+    {
+      size_t delta = body.find("\"delta_t\":", at);
+      if (delta == std::string::npos || delta > end)
+        printf("  update %u has neither created_at nor delta_t\n", updates);
+      else
+        relative++;
+      continue;
+    }
+    std::string time = body.substr(stamp + sizeof(key) - 1, body.find('"', stamp + sizeof(key) - 1) - stamp - sizeof(key) + 1);
+    if (!last.empty() && time < last)
+      disordered++;
+    if (first.empty())
+      first = time;
+    last = time;
+  }
+  printf("  %u updates", updates);
+  if (!first.empty())
+    printf(", %s .. %s", first.c_str(), last.c_str());
+  if (disordered)
+    printf(", %u out of order", disordered);
+  if (relative)
+    printf(", %u with delta_t%s", relative, relative < updates ? ", mixed with created_at" : "");
+  printf("\n");
+}
+
+int runStandIn(uint16_t port, const char *replies)
+{
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  int on = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if (listener < 0 || bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 4) != 0)
+  {
+    perror("stand-in");
+    return 1;
+  }
+  printf("stand-in listening on port %u, replies %s\n", port, replies ? replies : "200");
+  fflush(stdout);
+
+  const char *reply = replies;
+  for (uint32_t request = 1;; request++)
+  {
+    int connection = accept(listener, NULL, NULL);
+    if (connection < 0)
+      continue;
+    timeval timeout = {STAND_IN_TIMEOUT_SECONDS, 0};
+    setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    char action[16] = "200";
+    if (reply)
+    {
+      size_t length = strcspn(reply, ",");
+      snprintf(action, sizeof(action), "%.*s", (int)length, reply);
+      reply = reply[length] ? reply + length + 1 : replies; // cycles
+    }
+
+    printf("request %u\n", request);
+    std::string head, body;
+    if (readRequest(connection, head, body))
+      summarize(head, body);
+    if (strcmp(action, "silent") == 0)
+    {
+      printf("  no reply\n");
+      char chunk[256];
+      while (recv(connection, chunk, sizeof(chunk), 0) > 0)
+        ; // until the device gives up and closes, or the receive timeout
+    }
+    else if (strcmp(action, "drop") == 0)
+      printf("  dropped\n");
+    else
+    {
+      int status = atoi(action);
+      char response[128];
+      int length = snprintf(response, sizeof(response),
+                            "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: 2\r\n"
+                            "Connection: close\r\n\r\n{}", status, status >= 200 && status < 300 ? "OK" : "Error");
+      send(connection, response, length, 0);
+      printf("  replied %d\n", status);
+    }
+    fflush(stdout);
+    close(connection);
+  }
+}
@@ -0,0 +1,15 @@
+/*  Stand-in for the ThingSpeak bulk update endpoint
+    Point the device's upload server at the PC (host:port in the config portal) and both the log upload and the
+    station outbox post here instead. Each request is checked and summed up on stdout: Content-Length against the
+    body, the number of updates, their created_at range and order, how many use delta_t. The replies follow a list
+    that is cycled, an HTTP status, "drop" to close without an answer or "silent" to keep the connection open
+    without one, so retries, timeouts and resuming an interrupted upload can be tried on the device.
+*/
+#ifndef STAND_IN_H
+#define STAND_IN_H
+
+#include <stdint.h>
+
+int runStandIn(uint16_t port, const char *replies); // replies like "200,500,drop", NULL for always 200
+
+#endif
@@ -0,0 +1,375 @@
+/*  Host build of the measurement core
+    Drives the same MeasurementCore and pulse entry point as the firmware, with a simulated clock in place of
+    the cycle counter and timer0. Built by the native environment: pio run -e native
+
+    Usage: program [--mode N] < pulses.txt    replay recorded pulse times, microseconds since start, one per line
+           program --sim [scenario]           simulated Poisson trains, error and response of every integration mode
+             --profile 0.5:600,20:600,50~300  custom rate profile instead of a scenario, rate:seconds or rate~seconds
+             --dead-time us                   dead time of the simulated tube, default 190
+             --paralyzable                    paralyzable tube instead of non-paralyzable
+             --seed n
+           program --bench                    times the per-pulse and per-bin paths of the core
+           program --decode-log seg0 seg1 ..  prints the entries of flash log segment files as csv
+           program --codec-bench [trace.csv]  size and speed of the log codec, simulated traces or a decoded log
+           program --stand-in port [replies]  local stand-in for the ThingSpeak bulk update, see StandIn.h
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <MeasurementCore.h>
+#include <DoseMath.h>
+#include "HostHal.h"
+#include "Simulator.h"
+#include "LogTools.h"
+#include "StandIn.h"
+
+#define SIM_MODES 5
+#define RISE_FRACTION 0.9 // response time is measured to this fraction of a step
+
+class PrintSink : public DisplaySink
+{
+public:
+  void showReading(const Reading &reading)
+  {
+    if (quiet)
+      return;
+    char rate[12];
+    formatMilli(reading.doseRate, 2, 0, rate, sizeof(rate));
+    printf("%lu s: %lu cpm, %s uSv/hr, level %u%s\n", (unsigned long)seconds, (unsigned long)reading.averageCount,
+           rate, reading.doseLevel, reading.timeToCount ? ", time to count" : "");
+  }
+  void report(const char *line)
+  {
+    if (!quiet)
+      printf("# %s\n", line);
+  }
+
+  uint32_t seconds = 0;
+  bool quiet = false;
+};
+
+SimClock simClock;
+SimPulseSource simPulses;
+MemoryStorage memoryStorage;
+PrintSink printSink;
+MeasurementCore core;
+
+void advanceTo(uint64_t micros) // closes every bin boundary up to micros, updating the core as loop() would
+{
+  while (simClock.micros / 1000000 < micros / 1000000)
+  {
+    simClock.micros = (simClock.micros / 1000000 + 1) * 1000000;
+    simPulses.closeBin();
+    printSink.seconds++;
+    core.update();
+  }
+  simClock.micros = micros;
+}
+
+int replay()
+{
+  char line[32];
+  uint64_t previous = 0;
+  while (fgets(line, sizeof(line), stdin))
+  {
+    if (line[0] == '#' || line[0] == '\n')
+      continue;
+    uint64_t stamp = strtoull(line, NULL, 10);
+    if (stamp < previous)
+    {
+      fprintf(stderr, "timestamps must not decrease: %llu after %llu\n", (unsigned long long)stamp, (unsigned long long)previous);
+      return 1;
+    }
+    previous = stamp;
+    advanceTo(stamp);
+    simPulses.pulse((uint32_t)stamp);
+    if (simPulses.queue.pending() > PULSE_QUEUE_SIZE / 2)
+      core.update(); // loop() drains far more often than once a second
+  }
+  advanceTo((previous / 1000000 + 1) * 1000000);
+  return 0;
+}
+
+struct SimResult
+{
+  double steadyError = 0;   // mean relative CPM error where the rate has been constant for a full window
+  double trackingError = 0; // mean relative CPM error over the whole run after the first window
+  double doseError = 0;     // same as trackingError, for the displayed dose rate
+  double rise = -1;         // mean seconds to RISE_FRACTION of a step, -1 if there was no step or it never got there
+  double alarm = -1;        // seconds from the true rate crossing the alarm threshold to the high level, -1 if none
+};
+
+SimResult simulate(const RateProfile &profile, int mode, uint32_t deadTimeMicros, bool paralyzable, uint64_t seed)
+{
+  SimClock clock;
+  SimPulseSource pulses;
+  MemoryStorage storage;
+  NullSink sink;
+  MeasurementCore *sim = new MeasurementCore(); // fresh state for every mode, the history alone is 14 kB
+  sim->begin(clock, pulses, storage, sink);
+  sim->integrationMode = mode;
+
+  PulseTrain train(profile, deadTimeMicros, paralyzable, seed); // same seed, same pulses for every mode
+  uint64_t next = train.next();
+
+  SimResult result;
+  uint32_t steadySeconds = 0, trackingSeconds = 0, steps = 0;
+  double riseTotal = 0;
+  double previousTruth = -1, stepFrom = 0, stepTo = 0, shown = 0;
+  uint32_t unchanged = 0, stepAt = 0;
+  bool stepOpen = false;
+  double alarmCpm = sim->alarmThreshold * (double)sim->conversionFactor;
+  uint32_t alarmAt = 0;
+
+  for (uint32_t second = 1; second <= profile.seconds(); second++)
+  {
+    while (next < (uint64_t)second * 1000000)
+    {
+      clock.micros = next;
+      pulses.pulse((uint32_t)next);
+      if (pulses.queue.pending() >= PULSE_BATCH_SIZE)
+        sim->update();
+      next = train.next();
+    }
+    clock.micros = (uint64_t)second * 1000000;
+    pulses.closeBin();
+    sim->update();
+
+    double truth = 60 * profile.rate(second - 0.5); // mean over the bin that just closed
+    double shownBefore = shown;
+    shown = sim->reading.averageCount;
+    if (previousTruth >= 0 && fabs(truth - previousTruth) > 0.01 * previousTruth)
+    {
+      unchanged = 0;
+      if (truth > 2 * previousTruth || truth < previousTruth / 2) // a step, not a ramp
+      {
+        // an unsettled previous step does not count. Neither does one the display is already past, e.g. the
+        // end of a spike that a long window never rose to
+        stepFrom = previousTruth;
+        stepTo = truth;
+        stepAt = second - 1;
+        double target = stepFrom + RISE_FRACTION * (stepTo - stepFrom);
+        stepOpen = stepTo > stepFrom ? shownBefore < target : shownBefore > target;
+      }
+    }
+    else
+      unchanged++;
+    previousTruth = truth;
+
+    if (stepOpen && (stepTo > stepFrom ? shown >= stepFrom + RISE_FRACTION * (stepTo - stepFrom)
+                                       : shown <= stepFrom + RISE_FRACTION * (stepTo - stepFrom)))
+    {
+      riseTotal += second - stepAt;
+      steps++;
+      stepOpen = false;
+    }
+
+    if (truth >= alarmCpm && alarmAt == 0)
+      alarmAt = second - 1;
+    if (alarmAt && result.alarm < 0 && sim->reading.doseLevel >= 2)
+      result.alarm = second - alarmAt;
+
+    if (truth <= 0)
+      continue;
+    double error = fabs(shown - truth) / truth;
+    if (unchanged >= sim->integrationSeconds())
+    {
+      result.steadyError += error;
+      steadySeconds++;
+    }
+    if (second > sim->integrationSeconds())
+    {
+      result.trackingError += error;
+      result.doseError += fabs(sim->reading.doseRate / 1000.0 - truth / sim->conversionFactor) / (truth / sim->conversionFactor);
+      trackingSeconds++;
+    }
+  }
+  delete sim;
+
+  result.steadyError = steadySeconds ? result.steadyError / steadySeconds : -1;
+  result.trackingError = trackingSeconds ? result.trackingError / trackingSeconds : -1;
+  result.doseError = trackingSeconds ? result.doseError / trackingSeconds : -1;
+  if (steps)
+    result.rise = riseTotal / steps;
+  return result;
+}
+
+void printMetric(double value, double scale, const char *unit)
+{
+  if (value < 0)
+    printf("%10s", "-");
+  else
+    printf("%8.1f%-2s", value * scale, unit);
+}
+
+int runSimulation(const char *name, const RateProfile &profile, uint32_t deadTimeMicros, bool paralyzable, uint64_t seed)
+{
+  static const char *modeNames[SIM_MODES] = {"60 s", "5 s", "180 s", "custom", "auto"};
+  printf("%s: %u s, dead time %u us %s, seed %llu\n", name, profile.seconds(), deadTimeMicros,
+         paralyzable ? "paralyzable" : "non-paralyzable", (unsigned long long)seed);
+  printf("%-8s%10s%10s%10s%10s%10s\n", "mode", "steady", "tracking", "dose", "rise", "alarm");
+  for (int mode = 0; mode < SIM_MODES; mode++)
+  {
+    SimResult r = simulate(profile, mode, deadTimeMicros, paralyzable, seed);
+    printf("%-8s", modeNames[mode]);
+    printMetric(r.steadyError, 100, " %");
+    printMetric(r.trackingError, 100, " %");
+    printMetric(r.doseError, 100, " %");
+    printMetric(r.rise, 1, " s");
+    printMetric(r.alarm, 1, " s");
+    printf("\n");
+  }
+  printf("\n");
+  return 0;
+}
+
+int simulateScenarios(const char *only, const char *profileText, uint32_t deadTimeMicros, bool paralyzable, uint64_t seed)
+{
+  if (profileText)
+  {
+    RateProfile profile;
+    if (!profile.parse(profileText))
+    {
+      fprintf(stderr, "bad profile: %s\n", profileText);
+      return 1;
+    }
+    return runSimulation(profileText, profile, deadTimeMicros, paralyzable, seed);
+  }
+
+  static const struct
+  {
+    const char *name;
+    const char *profile;
+  } scenarios[] = {
+      {"background", "0.3:1800"},                  // natural background, error only
+      {"step", "0.5:900,20:900,0.5:900"},          // source brought close and taken away
+      {"ramp", "0.5:300,50~600,50:300"},           // walking towards a source
+      {"spike", "0.5:300,100:10,0.5:290"},         // a source passing by
+      {"high", "0.5:120,1500:300"},                // dead time and time to count territory
+  };
+  bool found = false;
+  for (const auto &s : scenarios)
+  {
+    if (only && strcmp(only, s.name) != 0)
+      continue;
+    RateProfile profile;
+    profile.parse(s.profile);
+    runSimulation(s.name, profile, deadTimeMicros, paralyzable, seed);
+    found = true;
+  }
+  if (!found)
+    fprintf(stderr, "no scenario named %s\n", only);
+  return found ? 0 : 1;
+}
+
+double elapsedNanos(std::chrono::steady_clock::time_point start, long runs)
+{
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / runs;
+}
+
+int bench()
+{
+  const long seconds = 3600;
+  printSink.quiet = true;
+
+  // one hour of Poisson pulses at 500 cps, fed the way loop() sees them
+  RateProfile profile;
+  profile.hold(500, seconds);
+  PulseTrain train(profile, 0, false, 1);
+  long pulses = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t t = train.next(); t != UINT64_MAX; t = train.next())
+  {
+    advanceTo(t);
+    simPulses.pulse((uint32_t)t);
+    if (simPulses.queue.pending() >= PULSE_BATCH_SIZE)
+      core.update();
+    pulses++;
+  }
+  double perPulse = elapsedNanos(start, pulses);
+  printf("replay: %ld pulses, %.1f ns per pulse including bin closes\n", pulses, perPulse);
+
+  const long runs = 1000000;
+  volatile uint32_t sink = 0;
+  char text[12];
+
+  start = std::chrono::steady_clock::now();
+  for (long r = 0; r < runs; r++)
+    sink += core.binHistory.cpm(1 + r % BIN_HISTORY_SECONDS);
+  printf("window cpm: %.1f ns\n", elapsedNanos(start, runs));
+
+  start = std::chrono::steady_clock::now();
+  for (long r = 0; r < runs; r++)
+    sink += correctParalyzable(20 + r % 200000, 200000);
+  printf("paralyzable correction: %.1f ns\n", elapsedNanos(start, runs));
+
+  start = std::chrono::steady_clock::now();
+  for (long r = 0; r < runs; r++)
+  {
+    formatDoseRate(doseRateMilli(20 + r % 200000, 175, 0), text, sizeof(text));
+    sink += text[0];
+  }
+  printf("dose rate and format: %.1f ns\n", elapsedNanos(start, runs));
+
+  start = std::chrono::steady_clock::now();
+  for (long r = 0; r < runs / 100; r++)
+    core.refresh();
+  printf("reading refresh: %.1f ns\n", elapsedNanos(start, runs / 100));
+
+  printf("final reading: %lu cpm, dead time %lu ns\n", (unsigned long)core.reading.averageCount, (unsigned long)core.deadTime.deadTimeNanos());
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  bool simulation = false;
+  const char *scenario = NULL;
+  const char *profile = NULL;
+  uint32_t deadTimeMicros = 190;
+  bool paralyzable = false;
+  uint64_t seed = 1;
+  int mode = 0;
+
+  core.begin(simClock, simPulses, memoryStorage, printSink);
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--bench") == 0)
+      return bench();
+    else if (strcmp(argv[i], "--decode-log") == 0)
+      return decodeLog(argc - i - 1, argv + i + 1);
+    else if (strcmp(argv[i], "--codec-bench") == 0)
+      return codecBench(i + 1 < argc ? argv[i + 1] : NULL);
+    else if (strcmp(argv[i], "--stand-in") == 0 && i + 1 < argc)
+      return runStandIn(atoi(argv[i + 1]), i + 2 < argc ? argv[i + 2] : NULL);
+    else if (strcmp(argv[i], "--sim") == 0)
+    {
+      simulation = true;
+      if (i + 1 < argc && argv[i + 1][0] != '-')
+        scenario = argv[++i];
+    }
+    else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+    {
+      simulation = true;
+      profile = argv[++i];
+    }
+    else if (strcmp(argv[i], "--dead-time") == 0 && i + 1 < argc)
+      deadTimeMicros = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--paralyzable") == 0)
+      paralyzable = true;
+    else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+      seed = strtoull(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc)
+      mode = atoi(argv[++i]);
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (simulation)
+    return simulateScenarios(scenario, profile, deadTimeMicros, paralyzable, seed);
+  core.integrationMode = mode;
+  return replay();
+}
@@ -17,15 +17,40 @@
 #include <Fonts/FreeSans12pt7b.h>
 #include "Adafruit_ILI9341.h"
 #include <XPT2046_Touchscreen.h>
+#include <PulseQueue.h>
+#include <MeasurementCore.h>
+#include <DoseMath.h>
+#include <TextWidget.h>
+#include <TouchInput.h>
+#include <Scheduler.h>
+#include <Profiler.h>
+#include <PowerManager.h>
+#include <FlashLog.h>
+#include <Settings.h>
+#include <BulkUpload.h>
+#include <HttpUploader.h>
+#include <Outbox.h>
+#include <WifiLink.h>
+#include <time.h>
+
+extern "C" {
+#include "user_interface.h" // system_update_cpu_freq()
+}
 
 #define CS_PIN D2
-XPT2046_Touchscreen ts(CS_PIN);
+#ifdef TOUCH_IRQ_PIN
+XPT2046_Touchscreen ts(CS_PIN, TOUCH_IRQ_PIN); // SPI reads only after the controller signals a touch
+#else
+XPT2046_Touchscreen ts(CS_PIN);                // T_IRQ is not wired on the stock board, poll instead
+#endif
 
 #define TS_MINX 250
 #define TS_MINY 200 // calibration points for touchscreen
 #define TS_MAXX 3800
 #define TS_MAXY 3750
 
+TouchInput touchInput(ts, TS_MINX, TS_MAXX, TS_MINY, TS_MAXY, 240, 320);
+
 #define TFT_DC D4
 #define TFT_CS D8
 
@@ -40,68 +65,85 @@ XPT2046_Touchscreen ts(CS_PIN);
 #define DOSEBACKGROUND 0x0455
 
 // WiFi variables
-unsigned long currentUploadTime;
-unsigned long previousUploadTime;
-int passwordLength;
-int SSIDLength;
-int channelIDLength;
-int writeAPILength;
-char ssid[20];
-char password[20];
-char channelID[20]; // = "864288";
-char channelAPIkey[20]; // = "37SAHQPEQ7FOBC20";
-char server[] = "api.thingspeak.com";
-int attempts; // number of connection attempts when device starts up in monitoring mode
-WiFiClient client;
+WifiLink wifiLink;              // station link: reconnects with backoff, joins the cached access point without a scan
+WiFiClient client;              // bulk upload, which owns the screen until it resets
+HttpUploader uploader;          // station uploads, moved along by loop() so nothing waits on the network
+Outbox outbox;                  // station readings not yet accepted by the server, on flash
+uint16_t outboxInFlight;        // entries covered by the request that is out
+unsigned long outboxRetryMillis; // no new request before this after a failure
 
 Adafruit_ILI9341 tft = Adafruit_ILI9341(TFT_CS, TFT_DC);
 
 const int interruptPin = 5;
 
-long count[61];
-long fastCount[6]; // arrays to store running counts
-long slowCount[181];
-int i = 0;         // array elements
-int j = 0;
-int k = 0;
+MeasurementCore core; // counting, integration, dead time and dose. The settings below live in it too
+
+// Bin timer variables. timer0 closes a bin every second on all pages, loop() consumes the closed bins
+uint32_t binCycles = F_CPU;                  // one second of CPU cycles, follows the clock, see setCpuMhz()
+uint32_t nextBinCycles;                      // cycle count of the next bin boundary, only touched by the timer ISR
+volatile uint32_t binBoundaryTotal;          // pulse total at the most recent boundary
+volatile uint32_t binBoundarySeq;            // number of boundaries since boot
 
 int page = 0;
 
-long currentMillis;
 long previousMillis;
-unsigned long currentMicros;
-unsigned long previousMicros;
-
-unsigned long averageCount;
-unsigned long currentCount;  // incremented by interrupt
-unsigned long previousCount; // to activate buzzer and LED
-unsigned long cumulativeCount;
-float doseRate;
-float totalDose;
-char dose[5];
-int doseLevel;               // determines home screen warning signs
-int previousDoseLevel;
-
-bool ledSwitch = 1;
-bool buzzerSwitch = 1;
-bool wasTouched;
-int integrationMode = 0; // 0 = medium, 1 = fast, 2 == slow;
-
-bool doseUnits = 0; // 0 = Sievert, 1 = Rem
-unsigned int alarmThreshold = 5;
-unsigned int conversionFactor = 175;
-
-int x, y; // touch points
+
+char dose[8];
+char totalDoseText[12];
+int previousDoseLevel;       // home screen warning sign currently drawn
+
+// Home page readings. Each only redraws the characters that changed since the last bin
+TextWidget doseWidget(44, 52, 5, ILI9341_WHITE, DOSEBACKGROUND);
+TextWidget cpmWidget(73, 122, 3, ILI9341_WHITE, ILI9341_BLACK);
+TextWidget countsWidget(80, 192, 2, ILI9341_WHITE, 0x630C);
+TextWidget totalDoseWidget(80, 222, 2, ILI9341_WHITE, 0x630C);
+RenderStats homeRenderStats;     // display traffic of the home page readings
+#define RENDER_REPORT_FRAMES 300 // frames between serial reports of the display traffic
+
+// Periodic work, runs on every page
+Scheduler scheduler;
+#define BATTERY_MILLIS 30000          // slow enough to hide the fluctuations of the battery level
+#define LOG_MILLIS 60000               // one flash log entry a minute
+#define UPLOAD_MILLIS 300000
+#define UPLOAD_CONNECT_MILLIS 30000   // give up on the WiFi after this long
+#define UPLOAD_RESPONSE_MILLIS 10000  // wait for the server's answer to a batch
+#define OUTBOX_MILLIS 15000           // queued readings go out at most this often, ThingSpeak's update limit
+#define OUTBOX_RETRY_MILLIS 60000     // after a failed request
+#define OUTBOX_BATCH 24               // entries looked at per request, as many as fit go
+#define CLOCK_VALID 1600000000        // time() beyond this means SNTP has set the clock
+#define SCHEDULER_REPORT_MILLIS 600000
+
+PowerManager power;                   // idles the CPU between work and lowers its clock when nobody is using the device
+#define POWER_REPORT_MILLIS 60000
+
+// Display sleep. In monitoring station mode the screen sleeps after a while without input, a touch wakes it
+#define DISPLAY_SLEEP_MILLIS 60000
+#define SLEEP_POLL_MILLIS (PULSE_QUEUE_SIZE / 2 * LOCKOUT_MICROS / 1000) // touch poll and loop interval while asleep. At one pulse per lockout the queue fills at most half meanwhile (51 ms)
+bool displayAsleep;
+uint32_t lastTouchMillis;
+
+#ifdef PROFILING
+Profiler profiler;                    // section timings, dumped to serial every minute
+#define PROFILE_REPORT_MILLIS 60000
+uint32_t profiledLoops;               // loop count at the previous report
+uint32_t profiledMillis;
+#endif
+
+volatile bool ledSwitch = 1;    // read by the click interrupts
+volatile bool buzzerSwitch = 1;
+bool integrationTapped = false; // INT is held and no long press came yet, the mode changes on release
 
 // Battery indicator variables
 int batteryInput;
 int batteryPercent;
 int batteryMapped = 212;       // pixel location of battery icon
-int batteryUpdateCounter = 29;
 
-// EEPROM variables
+// Settings
+Settings settings;              // versioned, CRC checked record on LittleFS. Credentials are used from settings.data
+
+// Legacy EEPROM layout, only read once to import the settings of older firmware
 const int saveUnits = 0;
-const int saveAlertThreshold = 1; // Addresses for storing settings data in the EEPROM
+const int saveAlertThreshold = 1;
 const int saveCalibration = 2;
 const int saveDeviceMode = 3;
 const int saveLoggingMode = 4;
@@ -109,13 +151,10 @@ const int saveSSIDLen = 5;
 const int savePWLen = 6;
 const int saveIDLen = 7;
 const int saveAPILen = 8;
+const int saveRecords = 4004; // 16 byte records of the measurement core, after the logging area
 
 // Data Logging variables
-int addr = 200;                 // starting address for data logging
-char jsonBuffer[14000] = "["; 
-char data[14500] = "{\"write_api_key\":\"";
-unsigned long currentLogTime;
-unsigned long previousLogTime;
+FlashLog flashLog;              // ring of CRC checked blocks on LittleFS, weeks of one minute entries
 
 
 // Timed Count Variables:
@@ -124,9 +163,13 @@ unsigned long intervalMillis;
 unsigned long startMillis;
 unsigned long elapsedTime;
 int progress;
-float cpm;
+uint32_t cpm;                // thousandths of a count per minute
 bool completed = 0;
 int intervalSize; // stores how many digits are in the interval
+bool timedCountMode = 0; // 0 = count for a fixed time, 1 = time a fixed number of counts
+
+// Time to count variables
+int targetHundreds = 10;            // target of the timed measurement, in hundreds of counts
 
 // Logging variables
 bool isLogging;
@@ -135,8 +178,77 @@ bool deviceMode;
 
 // interrupt routine declaration
 void ICACHE_RAM_ATTR isr();
+void ICACHE_RAM_ATTR binTimerIsr();
+void ICACHE_RAM_ATTR click(uint32_t stamp);
+void ICACHE_RAM_ATTR clickTimerIsr();
+
+// Pulse queue variables
+PulseQueue pulseQueue;                       // timestamps and counters written by the ISR
+#define LOCKOUT_MICROS 200
+uint32_t lockoutCycles = LOCKOUT_MICROS * (F_CPU / 1000000); // limits count increment rate in the ISR to one per 200 us
+
+// Click and LED feedback. Started by isr() and ended by a timer1 one-shot, so the width doesn't depend on loop()
+#define CLICK_MICROS 200              // width of one click
+#define CLICK_HOLDOFF_MICROS 1000     // a pulse this close to the last click is merged into it, at most 1000 clicks per second
+#define TONE_ENTER_MICROS 5000        // average gap between pulses below which the clicks become a tone, 200 cps
+#define TONE_EXIT_MICROS 10000        // and above which the tone goes back to clicks, 100 cps
+#define TONE_SILENCE_MICROS 50000     // no pulse for this long ends the tone right away
+#define TONE_HZ 2000
+#define TIMER1_TICKS_PER_MICRO 5      // timer1 counts the 80 MHz APB clock divided by 16
+uint32_t cyclesPerMicro = F_CPU / 1000000;    // 80 while the power manager has the CPU at the idle clock
+enum ClickState
+{
+  CLICK_IDLE,
+  CLICK_ON,   // a click is out, the one-shot ends it
+  CLICK_TONE  // timer1 runs periodically and toggles the buzzer
+};
+volatile uint8_t clickState = CLICK_IDLE;
+volatile uint32_t lastPulseStamp;     // cycle count of the last accepted pulse
+uint32_t pulseGap = TONE_EXIT_MICROS * cyclesPerMicro; // average gap over about 16 pulses, in cycles. Only touched by isr()
+uint32_t clickStamp;                  // cycle count of the last click, only touched by isr()
+bool toneHigh;                        // buzzer level in tone mode, only touched by the timer1 ISR
+
+// The measurement core reaches the hardware only through these
+class EspClock : public Clock
+{
+public:
+  uint32_t millis() { return ::millis(); }
+  uint32_t cyclesPerMicro() { return ::cyclesPerMicro; }
+};
+
+class EspPulseSource : public PulseSource
+{
+public:
+  PulseSnapshot snapshot() { return pulseQueue.snapshot(); }
+  uint16_t drain(uint32_t *out, uint16_t maxCount) { return pulseQueue.drain(out, maxCount); }
+  void boundary(uint32_t &sequence, uint32_t &total)
+  {
+    do
+    {
+      sequence = binBoundarySeq;
+      total = binBoundaryTotal;
+    } while (sequence != binBoundarySeq); // the timer ISR fired in between
+  }
+};
+
+class SettingsStorage : public Storage
+{
+public:
+  bool load(StorageRecord record, void *data, size_t size) { return settings.loadRecord(record, data, size); }
+  void save(StorageRecord record, const void *data, size_t size) { settings.saveRecord(record, data, size); }
+};
+
+class HomeDisplay : public DisplaySink
+{
+public:
+  void showReading(const Reading &reading);
+  void report(const char *line) { Serial.println(line); }
+};
 
-unsigned int previousIntMicros;              // timers to limit count increment rate in the ISR
+EspClock espClock;
+EspPulseSource espPulseSource;
+SettingsStorage settingsStorage;
+HomeDisplay homeDisplay;
 
 const unsigned char gammaBitmap [] PROGMEM = {
 	0x30, 0x00, 0x78, 0x70, 0xe8, 0xe0, 0xc4, 0xe0, 0x84, 0xc0, 0x05, 0xc0, 0x05, 0x80, 0x07, 0x80, 
@@ -300,17 +412,156 @@ void drawWifiPage();              // page 5
 void drawTimedCountPage();        // page 6
 void drawTimedCountRunningPage(int duration, int size); // page 7 
 void drawDeviceModePage();        // page 8
+void drawTimeToCountPage(int target); // page 9
+void drawCustomWindowPage();      // page 10
 
 void drawFrame();
 void drawBackButton();
 void drawCancelButton();
 void drawCloseButton();
 void drawBlankDialogueBox();
+void drawDeadTimeButton();
+void drawTimedCountModeButton();
+void drawIntegrationButton();
+void formatWindow(unsigned int seconds, char *label, size_t size);
 
 long EEPROMReadlong(long address);
 void EEPROMWritelong(int address, long value); // logging functions
-void createJsonFile();
-void clearLogs();
+int postBulkBatch(uint32_t from, BulkBatch &batch);
+void importEepromSettings();
+void importEepromLog();
+void readEepromString(int address, int lengthAddress, char *to, size_t size);
+void copyString(char *to, const char *from, size_t size);
+#ifdef DOSE_BENCHMARK
+void runDoseBenchmark();
+#endif
+
+// Page registry. Each page lists its touch regions in flash and the callbacks loop() dispatches to.
+// Regions are tested in order and the first one containing the touch point wins
+struct HitRegion
+{
+  int16_t left, top, right, bottom; // exclusive bounds, in screen pixels
+};
+
+struct Page
+{
+  void (*enter)();              // draws the page
+  void (*exit)();               // saves what was changed on the page. Optional
+  void (*tick)(bool binClosed); // every loop while the page is shown. Optional
+  void (*touch)(int region, uint8_t event); // index of the region touched and the TouchEventType
+  const HitRegion *regions;
+  uint8_t regionCount;
+};
+
+enum PageId
+{
+  PAGE_HOME = 0,
+  PAGE_SETTINGS = 1,
+  PAGE_UNITS = 2,
+  PAGE_ALERT = 3,
+  PAGE_CALIBRATION = 4,
+  PAGE_WIFI = 5,
+  PAGE_TIMED_COUNT = 6,
+  PAGE_TIMED_COUNT_RUNNING = 7,
+  PAGE_DEVICE_MODE = 8,
+  PAGE_TIME_TO_COUNT = 9,
+  PAGE_CUSTOM_WINDOW = 10
+};
+
+// region indices. Every page except home has its back or close button first
+enum { REGION_BACK = 0, REGION_PLUS = 1, REGION_MINUS = 2 };
+enum { HOME_INTEGRATION, HOME_TIMED_COUNT, HOME_LED, HOME_BUZZER, HOME_SETTINGS };
+enum { SETTINGS_UNITS = 1, SETTINGS_ALERT, SETTINGS_CALIBRATION, SETTINGS_WIFI };
+enum { UNITS_SIEVERT = 1, UNITS_REM };
+enum { CALIBRATION_DEAD_TIME = 3 };
+enum { WIFI_SETUP = 1, WIFI_UPLOAD, WIFI_LOGGING, WIFI_DEVICE_MODE };
+enum { TIMED_COUNT_BEGIN = 3, TIMED_COUNT_MODE };
+enum { DEVICE_MODE_COUNTER = 1, DEVICE_MODE_STATION };
+
+#define BACK_BUTTON {4, 271, 62, 315}
+#define CLOSE_BUTTON {70, 271, 170, 315}
+
+const HitRegion homeRegions[] PROGMEM = {
+    {162, 259, 238, 318}, // integration time
+    {64, 259, 159, 318},  // timed count
+    {190, 151, 238, 202}, // toggle LED
+    {190, 205, 238, 256}, // toggle buzzer
+    {3, 259, 61, 316}};   // settings
+const HitRegion settingsRegions[] PROGMEM = {BACK_BUTTON, {3, 64, 234, 108}, {3, 114, 234, 158}, {3, 164, 234, 208}, {3, 214, 234, 268}};
+const HitRegion unitsRegions[] PROGMEM = {BACK_BUTTON, {4, 70, 234, 120}, {4, 127, 234, 177}};
+const HitRegion alertRegions[] PROGMEM = {BACK_BUTTON, {130, 70, 190, 120}, {130, 185, 190, 245}};
+const HitRegion calibrationRegions[] PROGMEM = {BACK_BUTTON, {160, 70, 220, 120}, {160, 185, 220, 245}, {70, 271, 236, 316}};
+const HitRegion wifiRegions[] PROGMEM = {BACK_BUTTON, {3, 64, 237, 108}, {3, 162, 237, 206}, {3, 114, 237, 158}, {3, 214, 237, 258}};
+const HitRegion timedCountRegions[] PROGMEM = {BACK_BUTTON, {160, 70, 220, 120}, {160, 185, 220, 245}, {145, 271, 235, 315}, {70, 271, 141, 315}};
+const HitRegion closeRegions[] PROGMEM = {CLOSE_BUTTON};
+const HitRegion deviceModeRegions[] PROGMEM = {BACK_BUTTON, {4, 70, 234, 120}, {4, 127, 234, 177}};
+const HitRegion customWindowRegions[] PROGMEM = {BACK_BUTTON, {160, 70, 220, 120}, {160, 185, 220, 245}};
+
+void tickHome(bool binClosed);
+void readBattery();
+void logCount();
+void uploadCount();
+void pollUpload();
+void forwardReadings();
+void startWifi();
+void pollWifi();
+void reportTasks();
+void reportPower();
+void setCpuMhz(uint8_t mhz);
+void sleepDisplay();
+void wakeDisplay();
+#ifdef PROFILING
+void reportProfile();
+#endif
+void touchHome(int region, uint8_t event);
+void touchSettings(int region, uint8_t event);
+void exitUnits();
+void touchUnits(int region, uint8_t event);
+void enterAlert();
+void exitAlert();
+void touchAlert(int region, uint8_t event);
+void drawAlertValue();
+void enterCalibration();
+void exitCalibration();
+void touchCalibration(int region, uint8_t event);
+void drawCalibrationValue();
+void exitWifi();
+void touchWifi(int region, uint8_t event);
+void runWifiSetup();
+void uploadLogs();
+void enterTimedCount();
+void touchTimedCount(int region, uint8_t event);
+void drawTimedCountValue();
+void enterTimedCountRunning();
+void tickTimedCountRunning(bool binClosed);
+void touchCountResult(int region, uint8_t event);
+void exitDeviceMode();
+void touchDeviceMode(int region, uint8_t event);
+void enterTimeToCount();
+void exitTimeToCount();
+void tickTimeToCount(bool binClosed);
+void enterCustomWindow();
+void exitCustomWindow();
+void touchCustomWindow(int region, uint8_t event);
+void drawCustomWindowValue();
+
+#define REGIONS(table) table, sizeof(table) / sizeof(HitRegion)
+
+const Page pages[] PROGMEM = { // indexed by PageId
+    {drawHomePage, NULL, tickHome, touchHome, REGIONS(homeRegions)},
+    {drawSettingsPage, NULL, NULL, touchSettings, REGIONS(settingsRegions)},
+    {drawUnitsPage, exitUnits, NULL, touchUnits, REGIONS(unitsRegions)},
+    {enterAlert, exitAlert, NULL, touchAlert, REGIONS(alertRegions)},
+    {enterCalibration, exitCalibration, NULL, touchCalibration, REGIONS(calibrationRegions)},
+    {drawWifiPage, exitWifi, NULL, touchWifi, REGIONS(wifiRegions)},
+    {enterTimedCount, NULL, NULL, touchTimedCount, REGIONS(timedCountRegions)},
+    {enterTimedCountRunning, NULL, tickTimedCountRunning, touchCountResult, REGIONS(closeRegions)},
+    {drawDeviceModePage, exitDeviceMode, NULL, touchDeviceMode, REGIONS(deviceModeRegions)},
+    {enterTimeToCount, exitTimeToCount, tickTimeToCount, touchCountResult, REGIONS(closeRegions)},
+    {enterCustomWindow, exitCustomWindow, NULL, touchCustomWindow, REGIONS(customWindowRegions)}};
+
+int findRegion(const Page &current, int touchX, int touchY);
+void showPage(int next);
 
 void setup()
 {
@@ -324,51 +575,64 @@ void setup()
 
   pinMode(D0, OUTPUT); // buzzer switch
   pinMode(D3, OUTPUT); // LED
+#ifdef TFT_BACKLIGHT_PIN
+  pinMode(TFT_BACKLIGHT_PIN, OUTPUT); // only on boards with the backlight moved off VCC
+  digitalWrite(TFT_BACKLIGHT_PIN, HIGH);
+#endif
   digitalWrite(D3, LOW);
   digitalWrite(D0, LOW);
 
-  EEPROM.begin(4096);   // initialize emulated EEPROM sector with 4 kb
-
-  doseUnits = EEPROM.read(saveUnits);
-  alarmThreshold = EEPROM.read(saveAlertThreshold);
-  conversionFactor = EEPROM.read(saveCalibration);
-  deviceMode = EEPROM.read(saveDeviceMode);
-  isLogging = EEPROM.read(saveLoggingMode);
-  addr = EEPROMReadlong(96);
-
-  SSIDLength = EEPROM.read(saveSSIDLen);
-  passwordLength = EEPROM.read(savePWLen);
-  channelIDLength = EEPROM.read(saveIDLen);
-  writeAPILength = EEPROM.read(saveAPILen);
-
-  for (int i = 10; i < 10 + SSIDLength; i++)
+  bool filesystem = flashLog.begin();
+  if (filesystem)
+    outbox.begin();
+  if (!settings.load()) // first boot of this firmware, or the record is damaged
   {
-    ssid[i - 10] = EEPROM.read(i);
+    EEPROM.begin(4096); // RAM copy of the legacy sector, only for the import
+    importEepromSettings();
+    if (filesystem)
+      importEepromLog();
+    EEPROM.end();       // frees the 4 KB again
+    settings.save();
   }
-  Serial.println(ssid);
-
-  for (int j = 30; j < 30 + passwordLength; j++)
-  {
-    password[j - 30] = EEPROM.read(j);
-  }
-  Serial.println(password);
-
-  for (int k = 50; k < 50 + channelIDLength; k++)
-  {
-    channelID[k - 50] = EEPROM.read(k);
-  }
-  Serial.println(channelID);
-
-  for (int l = 70; l < 70 + writeAPILength; l++)
-  {
-    channelAPIkey[l - 70] = EEPROM.read(l);
-  }
-  Serial.println(channelAPIkey);
-
+  core.doseUnits = settings.data.doseUnits;
+  core.alarmThreshold = settings.data.alarmThreshold;
+  core.conversionFactor = settings.data.conversionFactor;
+  core.customWindow = settings.data.customWindow;
+  core.ttcSwitchCpm = settings.data.ttcSwitchCpm;
+  deviceMode = settings.data.deviceMode;
+  isLogging = settings.data.isLogging;
+  core.begin(espClock, espPulseSource, settingsStorage, homeDisplay); // loads the dead time model and last fit
+  Serial.println(settings.data.ssid);
+  Serial.println(settings.data.channelID);
+
+#ifdef DOSE_BENCHMARK
+  runDoseBenchmark();
+#endif
+
+  timer1_isr_init();
+  timer1_attachInterrupt(clickTimerIsr);
+  pulseQueue.lockout = lockoutCycles;
   attachInterrupt(interruptPin, isr, FALLING);
 
+  timer0_isr_init();
+  timer0_attachInterrupt(binTimerIsr);
+  nextBinCycles = ESP.getCycleCount() + binCycles;
+  timer0_write(nextBinCycles);
+
+  scheduler.add("battery", readBattery, BATTERY_MILLIS, 1000, 1000); // first reading shortly after boot
+  scheduler.add("log", logCount, LOG_MILLIS, 10000, LOG_MILLIS);
+  scheduler.add("upload", uploadCount, UPLOAD_MILLIS, 10000, UPLOAD_MILLIS);
+  scheduler.add("outbox", forwardReadings, OUTBOX_MILLIS, 5000, OUTBOX_MILLIS);
+  scheduler.add("tasks", reportTasks, SCHEDULER_REPORT_MILLIS, 60000, SCHEDULER_REPORT_MILLIS);
+  scheduler.add("power", reportPower, POWER_REPORT_MILLIS, 10000, POWER_REPORT_MILLIS);
+#ifdef PROFILING
+  scheduler.add("profile", reportProfile, PROFILE_REPORT_MILLIS, 10000, PROFILE_REPORT_MILLIS);
+#endif
+
   drawHomePage();
 
+  power.begin(setCpuMhz);
+  power.wifiOn = deviceMode;
   if (!deviceMode)
   {
     WiFi.mode( WIFI_OFF );                // turn off wifi
@@ -377,8 +641,8 @@ void setup()
   }
   else
   {
-    WiFi.mode(WIFI_STA);
-    WiFi.begin(ssid, password);
+    startWifi();
+    configTime(0, 0, "pool.ntp.org");     // queued readings are sent with absolute times
     drawBlankDialogueBox();
     tft.setTextSize(1);
     tft.setFont(&FreeSans9pt7b);
@@ -387,15 +651,14 @@ void setup()
     tft.setCursor(38, 140);
     tft.println("Connecting to WiFi..");
 
-    while ((WiFi.status() != WL_CONNECTED) && (attempts < 300))
+    while (wifiLink.connecting())         // the first attempt, later ones happen in loop()
     {
-      delay(100);
-      attempts ++;
+      delay(50);
+      pollWifi();
     }
-    if (attempts >= 300)
+    if (!wifiLink.up())
     {
-      deviceMode = 0; 
-      tft.setCursor(45, 200);
+      tft.setCursor(45, 200);             // stays a station, readings are queued until the WiFi comes up
       tft.println("Failed to connect.");
       delay(1000);
     }
@@ -411,972 +674,1100 @@ void setup()
 
 void loop()
 {
-  if (page == 0) // homepage
   {
-    currentMillis = millis();
-    if (currentMillis - previousMillis >= 1000)
+    PROFILE_SCOPE(PROFILE_LOOP); // the profiled sections close before the idle wait, they time work only
+    bool binClosed;
     {
-      previousMillis = currentMillis;
-
-      batteryUpdateCounter ++;     
-
-      if (batteryUpdateCounter == 30){         // update battery level every 30 seconds. Prevents random fluctations of battery level.
-
-        batteryInput = analogRead(A0);
-        batteryInput = constrain(batteryInput, 590, 800);
-        batteryPercent = map(batteryInput, 590, 800, 0, 100);
-        batteryMapped = map(batteryPercent, 100, 0, 212, 233);
-
-        tft.fillRect(212, 6, 22, 10, ILI9341_BLACK);
-        if (batteryPercent < 10)
-        {
-          tft.fillRect(batteryMapped, 6, (234 - batteryMapped), 10, ILI9341_RED);
-        }
-        else
-        {
-          tft.fillRect(batteryMapped, 6, (234 - batteryMapped), 10, ILI9341_GREEN); // draws battery icon
-        }
-        
-        batteryUpdateCounter = 0;
-        Serial.println(batteryInput);
-        Serial.println(batteryPercent);
-      }
-
-      count[i] = currentCount;
-      i++;
-      fastCount[j] = currentCount; // keep concurrent arrays of counts. Use only one depending on user choice
-      j++;
-      slowCount[k] = currentCount;
-      k++;
+      PROFILE_SCOPE(PROFILE_BIN);
+      binClosed = core.update(); // runs on every page so the history never has gaps
+    }
 
-      if (i == 61)
+    Page current;
+    memcpy_P(&current, &pages[page], sizeof(Page));
+    if (current.tick && !displayAsleep)
+      current.tick(binClosed);
+    scheduler.run();
+    if (deviceMode)
+      pollWifi();
+    pollUpload();
+
+    PROFILE_SCOPE(PROFILE_TOUCH);
+    touchInput.poll(millis());
+    TouchEvent event;
+    while (touchInput.next(event)) // a page change cancels whatever is left of the touch that caused it
+    {
+      power.activity();
+      lastTouchMillis = millis();
+      if (displayAsleep)
       {
-        i = 0;
+        wakeDisplay(); // the waking touch does nothing else
+        continue;
       }
+      int region = findRegion(current, event.x, event.y);
+      if (region >= 0)
+        current.touch(region, event.type);
+    }
+    if (deviceMode && !displayAsleep && millis() - lastTouchMillis >= DISPLAY_SLEEP_MILLIS)
+      sleepDisplay();
+  }
+  power.idle(scheduler.untilNext()); // at most a touch poll interval, pulses and bins are handled by interrupts meanwhile
+}
 
-      if (j == 6)
-      {
-        j = 0;
-      }
+void sleepDisplay() // headless: counting, logging and uploads carry on, nothing is drawn
+{
+  if (page != PAGE_HOME)
+    showPage(PAGE_HOME); // leave any open page the way its back button would, the wake redraws home
+  tft.fillScreen(ILI9341_BLACK);
+  tft.enableSleep(true); // display off and sleep in, the controller stops scanning the panel
+#ifdef TFT_BACKLIGHT_PIN
+  digitalWrite(TFT_BACKLIGHT_PIN, LOW);
+  power.backlightOn = false;
+#endif
+  displayAsleep = true;
+  power.displayOn = false;
+  power.maxIdle = SLEEP_POLL_MILLIS;
+  touchInput.setPollInterval(SLEEP_POLL_MILLIS);
+}
 
-      if (k == 181)
-      {
-        k = 0;
-      }
+void wakeDisplay()
+{
+  touchInput.cancel(); // the rest of this press must not reach the home page
+  touchInput.setPollInterval(TOUCH_POLL_MILLIS);
+  power.maxIdle = POWER_MAX_IDLE_MILLIS;
+  power.displayOn = true;
+  displayAsleep = false;
+  tft.enableSleep(false);
+#ifdef TFT_BACKLIGHT_PIN
+  digitalWrite(TFT_BACKLIGHT_PIN, HIGH);
+  power.backlightOn = true;
+#endif
+  drawHomePage(); // full redraw, the widgets start over
+}
 
-      if (integrationMode == 2)
-      {
-        averageCount = (currentCount - slowCount[k]) / 3;
-      }
+int findRegion(const Page &current, int touchX, int touchY) // index of the first region of the page containing the point, -1 if none
+{
+  for (uint8_t r = 0; r < current.regionCount; r++)
+  {
+    HitRegion region;
+    memcpy_P(&region, &current.regions[r], sizeof(HitRegion));
+    if (touchX > region.left && touchX < region.right && touchY > region.top && touchY < region.bottom)
+      return r;
+  }
+  return -1;
+}
 
-      if (integrationMode == 1)
-      {
-        averageCount = (currentCount - fastCount[j]) * 12;
-      }
+void showPage(int next) // leaves the current page and draws the next one
+{
+  PROFILE_SCOPE(PROFILE_PAGE);
+  Page current;
+  memcpy_P(&current, &pages[page], sizeof(Page));
+  if (current.exit)
+    current.exit();
+  touchInput.cancel(); // the rest of this press must not reach the new page
+  page = next;
+  memcpy_P(&current, &pages[page], sizeof(Page));
+  current.enter();
+}
 
-      else if (integrationMode == 0)
-      {
-        averageCount = currentCount - count[i]; // count[i] stores the value from 60 seconds ago
-      }
+void tickHome(bool binClosed)
+{
+  if (binClosed)
+    Serial.println(core.currentCount);
+}
 
-      averageCount = ((averageCount) / (1 - 0.00000333 * float(averageCount))); // accounts for dead time of the geiger tube. relevant at high count rates
+void readBattery()
+{
+  batteryInput = analogRead(A0);
+  batteryInput = constrain(batteryInput, 590, 800);
+  batteryPercent = map(batteryInput, 590, 800, 0, 100);
+  batteryMapped = map(batteryPercent, 100, 0, 212, 233);
+  Serial.println(batteryInput);
+  Serial.println(batteryPercent);
+
+  if (page != PAGE_HOME || displayAsleep)
+    return; // the other pages don't show it, drawHomePage() picks up batteryMapped
+  tft.fillRect(212, 6, 22, 10, ILI9341_BLACK);
+  if (batteryPercent < 10)
+  {
+    tft.fillRect(batteryMapped, 6, (234 - batteryMapped), 10, ILI9341_RED);
+  }
+  else
+  {
+    tft.fillRect(batteryMapped, 6, (234 - batteryMapped), 10, ILI9341_GREEN); // draws battery icon
+  }
+}
 
-      if (doseUnits == 0)
-      {
-        doseRate = averageCount / float(conversionFactor);
-        totalDose = cumulativeCount / (60 * float(conversionFactor));
-        
-      }
-      else if (doseUnits == 1)
-      {
-        doseRate = averageCount / float(conversionFactor * 10.0);
-        totalDose = cumulativeCount / (60 * float(conversionFactor * 10.0)); // 1 mRem == 10 uSv
-        
-      }
+void logCount() // log the CPM of the last minute while logging is on. Buffered, the flash is written every 15 entries
+{
+  if (!isLogging)
+    return;
+  PROFILE_SCOPE(PROFILE_LOG);
+  flashLog.append(millis() / 1000, core.binHistory.cpm(LOG_MILLIS / 1000));
+}
 
-      if (averageCount < conversionFactor/2) // 0.5 uSv/hr
-        doseLevel = 0; // determines alert level displayed on homescreen
-      else if (averageCount < alarmThreshold * conversionFactor)
-        doseLevel = 1;
-      else
-        doseLevel = 2;
+void uploadCount() // deviceMode is 1 when in monitoring station mode. Queues the CPM for ThingSpeak every 5 minutes
+{
+  if (!deviceMode)
+    return;
+  PROFILE_SCOPE(PROFILE_UPLOAD);
+  time_t now = time(NULL);
+  if (now > CLOCK_VALID)
+    flashLog.setBootStart(now - millis() / 1000); // once per boot, dates what this boot logs
+  outbox.push(now > CLOCK_VALID ? now : 0, millis() / 1000, core.reading.averageCount); // kept until the server has it
+  Serial.println(outbox.pending());
+  forwardReadings();
+}
 
-      if (doseRate < 10.0)
-      {
-        dtostrf(doseRate, 4, 2, dose); // display two digits after the decimal point if value is less than 10
-      }
-      else if ((doseRate >= 10) && (doseRate < 100))
-      {
-        dtostrf(doseRate, 4, 1, dose); // display one digit after decimal point when dose is greater than 10
-      }
-      else if ((doseRate >= 100))
-      {
-        dtostrf(doseRate, 4, 0, dose); // whole numbers only when dose is higher than 100
-      }
-      else {
-        dtostrf(doseRate, 4, 0, dose);  // covers the rare edge case where the dose rate is sometimes errorenously calculated to be negative
-      }
-      
-      tft.setFont();
-      tft.setCursor(44, 52);
-      tft.setTextSize(5);
-      tft.setTextColor(ILI9341_WHITE, DOSEBACKGROUND);
-      tft.println(dose); // display effective dose rate
-      tft.setTextSize(1);
+void forwardReadings() // sends the oldest queued readings as one bulk update, if nothing is out and the WiFi is up
+{
+  if (!deviceMode || outbox.pending() == 0 || uploader.busy() || uploader.done() || !wifiLink.up())
+    return;
+  if ((long)(millis() - outboxRetryMillis) < 0)
+    return;
+  time_t now = time(NULL);
+  if (now < CLOCK_VALID)
+    return; // wait for SNTP, the server needs to know when each reading was taken
+  uint32_t uptime = millis() / 1000;
+
+  OutboxEntry entries[OUTBOX_BATCH];
+  uint16_t count;
+  while (true)
+  {
+    count = outbox.read(entries, OUTBOX_BATCH);
+    for (uint16_t i = 0; i < count; i++)
+      if (entries[i].time == 0 && entries[i].seq && outbox.thisBoot(entries[i]))
+        entries[i].time = now - (uptime - entries[i].uptime); // taken before the clock was set
+    uint16_t undated = 0;
+    while (undated < count && entries[undated].time == 0)
+      undated++; // an earlier boot without a clock, or a damaged record. There is no time to send it with
+    if (undated == 0 || count == 0)
+      break;
+    outbox.pop(undated);
+  }
+  if (count == 0)
+    return;
+
+  PROFILE_SCOPE(PROFILE_JSON);
+  char *request = uploader.buffer();
+  const size_t headRoom = 256;            // the body is built behind room for the head, which needs its length
+  size_t bodyLength = writeOutboxJson(request + headRoom, HTTP_REQUEST_BYTES - headRoom, settings.data.apiKey, "field2",
+                                      entries, count, outboxInFlight);
+  if (bodyLength == 0)
+    return;
+  char head[headRoom];
+  int headLength = snprintf(head, sizeof(head),
+                            "POST /channels/%s/bulk_update.json HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n"
+                            "Content-Type: application/json\r\nContent-Length: %u\r\n\r\n",
+                            settings.data.channelID, settings.data.uploadHost, (unsigned)bodyLength);
+  if (headLength <= 0 || headLength >= (int)headRoom)
+    return;
+  memmove(request + headLength, request + headRoom, bodyLength);
+  memcpy(request, head, headLength);
+  uploader.start(settings.data.uploadHost, settings.data.uploadPort, request, headLength + bodyLength);
+}
 
-      tft.setFont();
-      tft.setCursor(73, 122);
-      tft.setTextColor(ILI9341_WHITE, ILI9341_BLACK);
-      tft.setTextSize(3);
-      tft.println(averageCount); // Display CPM
+void pollUpload() // one step of the station upload in flight, if any
+{
+  uploader.poll(millis());
+  if (uploader.done())
+  {
+    int status = uploader.result();
+    Serial.print("upload ");
+    Serial.println(status); // HTTP status, or a negative HttpError
+    if (status >= 200 && status <= 299)
+      outbox.pop(outboxInFlight); // only now are they off the device
+    else
+      outboxRetryMillis = millis() + OUTBOX_RETRY_MILLIS;
+    outboxInFlight = 0;
+  }
+}
 
-      if (averageCount < 10)
-      {
-        tft.fillRect(90, 120, 144, 25, ILI9341_BLACK); // erase numbers that may have been left from previous high readings
-      }
-      else if (averageCount < 100)
-      {
-        tft.fillRect(107, 120, 127, 25, ILI9341_BLACK);
-      }
-      else if (averageCount < 1000)
-      {
-        tft.fillRect(124, 120, 110, 25, ILI9341_BLACK);
-      }
-      else if (averageCount < 10000)
-      {
-        tft.fillRect(141, 120, 93, 25, ILI9341_BLACK);
-      }
-      else if (averageCount < 100000)
-      {
-        tft.fillRect(160, 120, 74, 25, ILI9341_BLACK);
-      }
-      tft.setCursor(80, 192);
-      tft.setTextSize(2);
-      tft.setTextColor(ILI9341_WHITE, 0x630C);
-      tft.println(cumulativeCount); // display total counts since reset
+void reportTasks()
+{
+  scheduler.report(Serial);
+  if (deviceMode)
+    wifiLink.report(Serial);
+}
 
-      tft.setCursor(80, 222);
-      tft.println(totalDose); // display cumulative dose
+void startWifi()
+{
+  WifiCache cache;
+  memcpy(cache.bssid, settings.data.wifiBssid, sizeof(cache.bssid));
+  cache.channel = settings.data.wifiChannel;
+  wifiLink.begin(settings.data.ssid, settings.data.password, cache);
+}
 
-      if (doseLevel != previousDoseLevel) // only update alert level if it changed. This prevents flicker
-      {
-        if (doseLevel == 0)
-        {
-          tft.drawRect(0, 0, tft.width(), tft.height(), ILI9341_WHITE);
-          tft.fillRoundRect(3, 94, 234, 21, 3, 0x2DC6);
-          tft.setCursor(15, 104);
-          tft.setFont(&FreeSans9pt7b);
-          tft.setTextColor(ILI9341_WHITE);
-          tft.setTextSize(1);
-          tft.println("NORMAL BACKGROUND");
-
-          previousDoseLevel = doseLevel;
-        }
-        else if (doseLevel == 1)
-        {
-          tft.drawRect(0, 0, tft.width(), tft.height(), ILI9341_WHITE);
-          tft.fillRoundRect(3, 94, 234, 21, 3, 0xCE40);
-          tft.setCursor(29, 104);
-          tft.setFont(&FreeSans9pt7b);
-          tft.setTextColor(ILI9341_WHITE);
-          tft.setTextSize(1);
-          tft.println("ELEVATED ACTIVITY");
-
-          previousDoseLevel = doseLevel;
-        }
-        else if (doseLevel == 2)
-        {
-          tft.drawRect(0, 0, tft.width(), tft.height(), ILI9341_RED);
-          tft.fillRoundRect(3, 94, 234, 21, 3, 0xB8A2);
-          tft.setCursor(17, 104);
-          tft.setFont(&FreeSans9pt7b);
-          tft.setTextColor(ILI9341_WHITE);
-          tft.setTextSize(1);
-          tft.println("HIGH RADIATION LEVEL");
-
-          previousDoseLevel = doseLevel;
-        }
-      }
-      Serial.println(currentCount);
-    } 
-    // end of millis()-controlled block that runs once every second. The rest of the code on page 0 runs every loop
-    if (currentCount > previousCount)
-    {
-      if (ledSwitch)
-        digitalWrite(D3, HIGH); // trigger buzzer and led if they are activated
-      if (buzzerSwitch)
-        digitalWrite(D0, HIGH);
-      previousCount = currentCount;
-      previousMicros = micros();
-    }
-    currentMicros = micros();
-    if (currentMicros - previousMicros >= 200)
-    {
-      digitalWrite(D3, LOW);
-      digitalWrite(D0, LOW);
-      previousMicros = currentMicros;
-    }
+void pollWifi() // link upkeep, and the access point of a new connection goes into the settings
+{
+  wifiLink.poll(millis());
+  if (wifiLink.cacheChanged())
+  {
+    memcpy(settings.data.wifiBssid, wifiLink.cache().bssid, sizeof(settings.data.wifiBssid));
+    settings.data.wifiChannel = wifiLink.cache().channel;
+    settings.save();
+  }
+}
 
-    if (!ts.touched())
-      wasTouched = 0;
-    if (ts.touched() && !wasTouched) // A way of "debouncing" the touchscreen. Prevents multiple inputs from single touch
-    {
-      wasTouched = 1;
-      TS_Point p = ts.getPoint();
-      x = map(p.x, TS_MINX, TS_MAXX, 240, 0); // get touch point and map to screen pixels
-      y = map(p.y, TS_MINY, TS_MAXY, 320, 0);
+void reportPower()
+{
+  power.report(Serial);
+}
 
-      if ((x > 162 && x < 238) && (y > 259 && y < 318))
-      {
-        integrationMode ++;
-        if (integrationMode == 3)
-        {
-          integrationMode = 0;
-        }
-        currentCount = 0;
-        previousCount = 0;
-        for (int a = 0; a < 61; a++) // reset counts when integretation speed is changed
-        {
-          count[a] = 0;
-        }
-        for (int b = 0; b < 6; b++)
-        {
-          fastCount[b] = 0;
-        }
-        for (int c = 0; c < 181; c++)
-        {
-          slowCount[c] = 0;
-        }
-        if (integrationMode == 0) // change button based on touch and previous state
-        {
-          tft.fillRoundRect(162, 259, 74, 57, 3, 0x2A86);
-          tft.setFont(&FreeSans12pt7b);
-          tft.setTextSize(1);
-          tft.setCursor(180, 283);
-          tft.println("INT");
-          tft.setCursor(177, 309);
-          tft.println("60 s");
-        }
-        else if (integrationMode == 1)
-        {
-          tft.fillRoundRect(162, 259, 74, 57, 3, 0x2A86);
-          tft.setFont(&FreeSans12pt7b);
-          tft.setTextSize(1);
-          tft.setCursor(180, 283);
-          tft.println("INT");
-          tft.setCursor(184, 309);
-          tft.println("5 s");
-        }
-        else if (integrationMode == 2)
-        {
-          tft.fillRoundRect(162, 259, 74, 57, 3, 0x2A86);
-          tft.setFont(&FreeSans12pt7b);
-          tft.setTextSize(1);
-          tft.setCursor(180, 283);
-          tft.println("INT");
-          tft.setCursor(169, 309);
-          tft.println("180 s");
-        }
-      }
-      else if ((x > 64 && x < 159) && (y > 259 && y < 318)) // timed count 
-      {
-        page = 6;
-        drawTimedCountPage();
-      }
-      else if ((x > 190 && x < 238) && (y > 151 && y < 202)) // toggle LED
-      {
-        ledSwitch = !ledSwitch;
-        if (ledSwitch)
-        {
-          tft.fillRoundRect(190, 151, 46, 51, 3, 0x6269);
-          tft.drawBitmap(190, 153, ledOnBitmap, 45, 45, ILI9341_WHITE);
-        }
-        else
-        {
-          tft.fillRoundRect(190, 151, 46, 51, 3, 0x6269);
-          tft.drawBitmap(190, 153, ledOffBitmap, 45, 45, ILI9341_WHITE);
-        }
-      }
-      else if ((x > 190 && x < 238) && (y > 205 && y < 256)) // toggle buzzer
-      {
-        buzzerSwitch = !buzzerSwitch;
-        if (buzzerSwitch)
-        {
-          tft.fillRoundRect(190, 205, 46, 51, 3, 0x6269);
-          tft.drawBitmap(190, 208, buzzerOnBitmap, 45, 45, ILI9341_WHITE);
-        }
-        else
-        {
-          tft.fillRoundRect(190, 205, 46, 51, 3, 0x6269);
-          tft.drawBitmap(190, 208, buzzerOffBitmap, 45, 45, ILI9341_WHITE);
-        }
-      }
-      else if ((x > 3 && x < 61) && (y > 259 && y < 316)) // settings button pressed
-      {
-        page = 1;
-        drawSettingsPage();
-      }
-    }
-    
-    if (isLogging)
+uint32_t rebaseStamp(uint32_t stamp, uint32_t before, uint32_t after, uint32_t oldMhz, uint32_t mhz) // where stamp would be on the new clock
+{
+  return after - (uint32_t)((uint64_t)(before - stamp) * mhz / oldMhz);
+}
+
+void setCpuMhz(uint8_t mhz) // switches the CPU clock and everything that counts its cycles, without losing a pulse or a bin
+{
+  uint32_t oldMhz = cyclesPerMicro;
+  noInterrupts();
+  uint32_t before = ESP.getCycleCount();
+  system_update_cpu_freq(mhz);
+  uint32_t after = ESP.getCycleCount();
+
+  cyclesPerMicro = mhz;
+#ifdef PROFILING
+  profiler.setClock(mhz);  // samples from here on are converted at the new clock
+#endif
+  binCycles = mhz * 1000000UL;
+  lockoutCycles = LOCKOUT_MICROS * mhz;
+  pulseQueue.lockout = lockoutCycles;
+
+  int32_t toBoundary = nextBinCycles - before;
+  if (toBoundary < (int32_t)oldMhz)
+    toBoundary = oldMhz; // due now. Rewriting the compare register clears a pending match, so fire it in a microsecond
+  nextBinCycles = after + (uint32_t)((uint64_t)toBoundary * mhz / oldMhz);
+  timer0_write(nextBinCycles);
+
+  pulseGap = (uint64_t)pulseGap * mhz / oldMhz;
+  lastPulseStamp = rebaseStamp(lastPulseStamp, before, after, oldMhz, mhz);
+  clickStamp = rebaseStamp(clickStamp, before, after, oldMhz, mhz);
+  core.rebaseClock(before, after, mhz); // consumes the pulses queued at the old rate first
+  interrupts();
+}
+
+#ifdef PROFILING
+void reportProfile() // loop rate, pulse counters and the section timings
+{
+  uint32_t loops = profiler.section(PROFILE_LOOP).count;
+  uint32_t now = millis();
+  PulseSnapshot pulses = pulseQueue.snapshot();
+  Serial.print("loops/s ");
+  Serial.print((loops - profiledLoops) * 1000 / (now - profiledMillis));
+  Serial.print(" pulses ");
+  Serial.print(pulses.total);
+  Serial.print(" overflows ");
+  Serial.print(pulses.overflows);
+  Serial.print(" queued ");
+  Serial.println(pulseQueue.pending());
+  profiler.report(Serial);
+  profiledLoops = loops;
+  profiledMillis = now;
+}
+#endif
+
+void touchHome(int region, uint8_t event)
+{
+  if (region == HOME_INTEGRATION) // TouchInput sends the press at touch-down, so a hold first has to be told from a tap
+  {
+    if (event == TOUCH_PRESS)
+      integrationTapped = true;
+    else if (event == TOUCH_LONG_PRESS && integrationTapped)
     {
-      if(addr < 2100)
+      integrationTapped = false;
+      if (core.integrationMode == 3) // hold INT on the custom window to set its length
       {
-        currentLogTime = millis();
-        if ((currentLogTime - previousLogTime) >= 600000)   // log every 10 minutes
-        {
-          EEPROMWritelong(addr, averageCount);
-          addr += 4;
-          EEPROMWritelong(96, addr); // write current address number to an adress just before the logged data
-          previousLogTime = currentLogTime;
-          EEPROM.commit();
-        }
+        showPage(PAGE_CUSTOM_WINDOW);
+        return;
       }
+      core.integrationMode = 0; // hold INT elsewhere to go back to the default window
+      core.refresh();
+      drawIntegrationButton();
     }
-    if (deviceMode)    // deviceMode is 1 when in monitoring station mode. Uploads CPM to thingspeak every 5 minutes
+    else if (event == TOUCH_RELEASE && integrationTapped)
     {
-      currentUploadTime = millis();
-      if ((currentUploadTime - previousUploadTime) > 300000)
+      integrationTapped = false;
+      core.integrationMode ++;
+      if (core.integrationMode == 5)
       {
-        previousUploadTime = currentUploadTime;
-        if (client.connect(server, 80))
-        {
-          String postStr = channelAPIkey;
-          postStr += "&field2=";
-          postStr += String(averageCount);
-          postStr += "\r\n\r\n";
-          char temp[50] = "X-THINGSPEAKAPIKEY:";
-          strcat(temp, channelAPIkey);
-          strcat(temp, "\n");
-          client.print("POST /update HTTP/1.1\n");
-          client.print("Host: api.thingspeak.com\n");
-          client.print("Connection: close\n");
-          client.print(temp);
-          client.print("Content-Type: application/x-www-form-urlencoded\n");
-          client.print("Content-Length: ");
-          client.print(postStr.length());
-          client.print("\n\n");
-          client.print(postStr);
-          Serial.println(postStr);
-        }
-        client.stop();
+        core.integrationMode = 0;
       }
+      core.refresh(); // the history is kept, so the new window is valid immediately
+      drawIntegrationButton();
     }
+    return;
+  }
+  if (event != TOUCH_PRESS)
+    return;
+
+  integrationTapped = false;
+  if (region == HOME_TIMED_COUNT)
+  {
+    showPage(PAGE_TIMED_COUNT);
+  }
+  else if (region == HOME_TIMED_COUNT)
+  {
+    showPage(PAGE_TIMED_COUNT);
   }
-  else if (page == 1) // settings page. all display elements are drawn when drawSettingsPage() is called
+  else if (region == HOME_LED)
   {
-    if (!ts.touched())
-      wasTouched = 0;
-    if (ts.touched() && !wasTouched)
+    ledSwitch = !ledSwitch;
+    if (ledSwitch)
     {
-      wasTouched = 1;
-      TS_Point p = ts.getPoint();
-      x = map(p.x, TS_MINX, TS_MAXX, 240, 0);
-      y = map(p.y, TS_MINY, TS_MAXY, 320, 0);
-
-      if ((x > 4 && x < 62) && (y > 271 && y < 315)) // back button. draw homepage, reset counts and go back
-      {
-        currentCount = 0;
-        previousCount = 0;
-        for (int a = 0; a < 61; a++)
-        {
-          count[a] = 0; // counts need to be reset to prevent errorenous readings
-        }
-        for (int b = 0; b < 6; b++)
-        {
-          fastCount[b] = 0;
-        }
-        for (int c = 0; c < 181; c++)
-        {
-          slowCount[c] = 0;
-        }
-        page = 0;
-        drawHomePage();
-      }
-      else if ((x > 3 && x < 234) && (y > 64 && y < 108))
-      {
-        page = 2;
-        drawUnitsPage();
-      }
-      else if ((x > 3 && x < 234) && (y > 114 && y < 158))
-      {
-        page = 3;
-        drawAlertPage();
-      }
-      else if ((x > 3 && x < 234) && (y > 164 && y < 208))
-      {
-        page = 4;
-        drawCalibrationPage();
-      }
-      else if ((x > 3 && x < 234) && (y > 214 && y < 268))
-      {
-        page = 5;
-        drawWifiPage();
-      }
+      tft.fillRoundRect(190, 151, 46, 51, 3, 0x6269);
+      tft.drawBitmap(190, 153, ledOnBitmap, 45, 45, ILI9341_WHITE);
+    }
+    else
+    {
+      tft.fillRoundRect(190, 151, 46, 51, 3, 0x6269);
+      tft.drawBitmap(190, 153, ledOffBitmap, 45, 45, ILI9341_WHITE);
     }
   }
-  else if (page == 2) // units page
+  else if (region == HOME_BUZZER)
   {
-    if (!ts.touched())
-      wasTouched = 0;
-    if (ts.touched() && !wasTouched)
+    buzzerSwitch = !buzzerSwitch;
+    if (buzzerSwitch)
     {
-      wasTouched = 1;
-      TS_Point p = ts.getPoint();
-      x = map(p.x, TS_MINX, TS_MAXX, 240, 0);
-      y = map(p.y, TS_MINY, TS_MAXY, 320, 0);
-
-      if ((x > 4 && x < 62) && (y > 271 && y < 315)) // back button
-      {
-        page = 1;
-        if (EEPROM.read(saveUnits) != doseUnits) // check current EEPROM value and only write if new value is different
-        {
-          EEPROM.write(saveUnits, doseUnits); // save current units to EEPROM during exit. This will be retrieved at startup
-          EEPROM.commit();
-        }
-        drawSettingsPage();
-      }
-      else if ((x > 4 && x < 234) && (y > 70 && y < 120))
-      {
-        doseUnits = 0;
-        tft.fillRoundRect(4, 71, 232, 48, 4, 0x2A86);
-        tft.setCursor(30, 103);
-        tft.println("Sieverts (uSv/hr)");
-
-        tft.fillRoundRect(4, 128, 232, 48, 4, ILI9341_BLACK);
-        tft.setCursor(47, 160);
-        tft.println("Rems (mR/hr)");
-      }
-      else if ((x > 4 && x < 234) && (y > 127 && y < 177))
-      {
-        doseUnits = 1;
-        tft.fillRoundRect(4, 71, 232, 48, 4, ILI9341_BLACK);
-        tft.setCursor(30, 103);
-        tft.println("Sieverts (uSv/hr)");
-
-        tft.fillRoundRect(4, 128, 232, 48, 4, 0x2A86);
-        tft.setCursor(47, 160);
-        tft.println("Rems (mR/hr)");
-      }
+      tft.fillRoundRect(190, 205, 46, 51, 3, 0x6269);
+      tft.drawBitmap(190, 208, buzzerOnBitmap, 45, 45, ILI9341_WHITE);
+    }
+    else
+    {
+      tft.fillRoundRect(190, 205, 46, 51, 3, 0x6269);
+      tft.drawBitmap(190, 208, buzzerOffBitmap, 45, 45, ILI9341_WHITE);
     }
   }
-  else if (page == 3)        // alert thresold page
+  else if (region == HOME_SETTINGS)
   {
-    tft.setFont();
-    tft.setTextSize(3);
-    tft.setTextColor(ILI9341_WHITE, ILI9341_BLACK);
-    tft.setCursor(151, 146);
-    tft.println(alarmThreshold);
-    if (alarmThreshold < 10)
-      tft.fillRect(169, 146, 22, 22, ILI9341_BLACK);
+    showPage(PAGE_SETTINGS);
+  }
+}
 
-    if (!ts.touched())
-      wasTouched = 0;
-    if (ts.touched() && !wasTouched)
-    {
-      wasTouched = 1;
-      TS_Point p = ts.getPoint();
-      x = map(p.x, TS_MINX, TS_MAXX, 240, 0);
-      y = map(p.y, TS_MINY, TS_MAXY, 320, 0);
+void touchSettings(int region, uint8_t event)
+{
+  if (event != TOUCH_PRESS)
+    return;
+
+  if (region == REGION_BACK)
+    showPage(PAGE_HOME);
+  else if (region == SETTINGS_UNITS)
+    showPage(PAGE_UNITS);
+  else if (region == SETTINGS_ALERT)
+    showPage(PAGE_ALERT);
+  else if (region == SETTINGS_CALIBRATION)
+    showPage(PAGE_CALIBRATION);
+  else if (region == SETTINGS_WIFI)
+    showPage(PAGE_WIFI);
+}
 
-      if ((x > 4 && x < 62) && (y > 271 && y < 315))
-      {
-        page = 1;
-        if (EEPROM.read(saveAlertThreshold) != alarmThreshold)
-        {
-          EEPROM.write(saveAlertThreshold, alarmThreshold);
-          EEPROM.commit(); // save to EEPROM to be retrieved at startup
-        }
-        drawSettingsPage();
-      }
-      else if ((x > 130 && x < 190) && (y > 70 && y < 120))
-      {
-        alarmThreshold++;
-        if (alarmThreshold > 100)
-          alarmThreshold = 100;
-      }
-      else if ((x > 130 && x < 190) && (y > 185 && y < 245))
-      {
-        alarmThreshold--;
-        if (alarmThreshold <= 2)
-          alarmThreshold = 2;
-      }
-    }
+void exitUnits()
+{
+  settings.data.doseUnits = core.doseUnits;
+  settings.save(); // only written if something changed
+}
+
+void touchUnits(int region, uint8_t event)
+{
+  if (event != TOUCH_PRESS)
+    return;
+
+  if (region == REGION_BACK)
+  {
+    showPage(PAGE_SETTINGS);
   }
-  else if (page == 4)     // calibration page
+  else if (region == UNITS_SIEVERT)
   {
-    tft.setFont();
-    tft.setTextSize(3);
-    tft.setTextColor(ILI9341_WHITE, ILI9341_BLACK);
-    tft.setCursor(161, 146);
-    tft.println(conversionFactor);
-    if (conversionFactor < 100)
-      tft.fillRect(197, 146, 22, 22, ILI9341_BLACK);
+    core.doseUnits = 0;
+    tft.fillRoundRect(4, 71, 232, 48, 4, 0x2A86);
+    tft.setCursor(30, 103);
+    tft.println("Sieverts (uSv/hr)");
 
-    if (!ts.touched())
-      wasTouched = 0;
-    if (ts.touched() && !wasTouched)
-    {
-      wasTouched = 1;
-      TS_Point p = ts.getPoint();
-      x = map(p.x, TS_MINX, TS_MAXX, 240, 0);
-      y = map(p.y, TS_MINY, TS_MAXY, 320, 0);
+    tft.fillRoundRect(4, 128, 232, 48, 4, ILI9341_BLACK);
+    tft.setCursor(47, 160);
+    tft.println("Rems (mR/hr)");
+  }
+  else if (region == UNITS_REM)
+  {
+    core.doseUnits = 1;
+    tft.fillRoundRect(4, 71, 232, 48, 4, ILI9341_BLACK);
+    tft.setCursor(30, 103);
+    tft.println("Sieverts (uSv/hr)");
 
-      if ((x > 4 && x < 62) && (y > 271 && y < 315))
-      {
-        page = 1;
-        if (EEPROM.read(saveCalibration) != conversionFactor)
-        {
-          EEPROM.write(saveCalibration, conversionFactor);
-          EEPROM.commit();
-        }
-        drawSettingsPage();
-      }
-      else if ((x > 160 && x < 220) && (y > 70 && y < 120))
-      {
-        conversionFactor++;
-      }
-      else if ((x > 160 && x < 220) && (y > 185 && y < 245))
-      {
-        conversionFactor--;
-        if (conversionFactor <= 1)
-          conversionFactor = 1;
-      }
-    }
+    tft.fillRoundRect(4, 128, 232, 48, 4, 0x2A86);
+    tft.setCursor(47, 160);
+    tft.println("Rems (mR/hr)");
+  }
+}
+
+void enterAlert()
+{
+  drawAlertPage();
+  drawAlertValue();
+}
+
+void exitAlert()
+{
+  settings.data.alarmThreshold = core.alarmThreshold;
+  settings.save();
+}
+
+void touchAlert(int region, uint8_t event)
+{
+  bool step = region == REGION_PLUS || region == REGION_MINUS;
+  if (event != TOUCH_PRESS && !(step && event == TOUCH_REPEAT)) // holding + or - keeps stepping
+    return;
+
+  if (region == REGION_BACK)
+  {
+    showPage(PAGE_SETTINGS);
+    return;
+  }
+  else if (region == REGION_PLUS)
+  {
+    core.alarmThreshold++;
+    if (core.alarmThreshold > 100)
+      core.alarmThreshold = 100;
+  }
+  else if (region == REGION_MINUS)
+  {
+    core.alarmThreshold--;
+    if (core.alarmThreshold <= 2)
+      core.alarmThreshold = 2;
+  }
+  drawAlertValue();
+}
+
+void drawAlertValue()
+{
+  tft.setFont();
+  tft.setTextSize(3);
+  tft.setTextColor(ILI9341_WHITE, ILI9341_BLACK);
+  tft.setCursor(151, 146);
+  tft.println(core.alarmThreshold);
+  if (core.alarmThreshold < 10)
+    tft.fillRect(169, 146, 22, 22, ILI9341_BLACK);
+}
+
+void enterCalibration()
+{
+  drawCalibrationPage();
+  drawCalibrationValue();
+}
+
+void exitCalibration()
+{
+  settings.data.conversionFactor = core.conversionFactor;
+  settings.save();
+  core.saveCalibration(); // dead time model, only written if it changed
+}
+
+void touchCalibration(int region, uint8_t event)
+{
+  bool step = region == REGION_PLUS || region == REGION_MINUS;
+  if (event != TOUCH_PRESS && !(step && event == TOUCH_REPEAT)) // holding + or - keeps stepping
+    return;
+
+  if (region == REGION_BACK)
+  {
+    showPage(PAGE_SETTINGS);
+    return;
   }
-  else if (page == 5)  // Wifi page
+  else if (region == CALIBRATION_DEAD_TIME)
   {
-    if (!ts.touched())
-      wasTouched = 0;
-    if (ts.touched() && !wasTouched)
+    core.deadTime.model = (DeadTimeModel)((core.deadTime.model + 1) % 3);
+    drawDeadTimeButton();
+    return;
+  }
+  else if (region == REGION_PLUS)
+  {
+    core.conversionFactor++;
+  }
+  else if (region == REGION_MINUS)
+  {
+    core.conversionFactor--;
+    if (core.conversionFactor <= 1)
+      core.conversionFactor = 1;
+  }
+  drawCalibrationValue();
+}
+
+void drawCalibrationValue()
+{
+  tft.setFont();
+  tft.setTextSize(3);
+  tft.setTextColor(ILI9341_WHITE, ILI9341_BLACK);
+  tft.setCursor(161, 146);
+  tft.println(core.conversionFactor);
+  if (core.conversionFactor < 100)
+    tft.fillRect(197, 146, 22, 22, ILI9341_BLACK);
+}
+
+void enterCustomWindow()
+{
+  drawCustomWindowPage();
+  drawCustomWindowValue();
+}
+
+void exitCustomWindow()
+{
+  settings.data.customWindow = core.customWindow;
+  settings.save();
+  core.refresh(); // the home page comes back with the new window
+}
+
+unsigned int customWindowStep(unsigned int seconds) // finer steps for short windows
+{
+  if (seconds < 60)
+    return 5;
+  else if (seconds < 600)
+    return 30;
+  return 60;
+}
+
+void touchCustomWindow(int region, uint8_t event)
+{
+  bool step = region == REGION_PLUS || region == REGION_MINUS;
+  if (event != TOUCH_PRESS && !(step && event == TOUCH_REPEAT)) // holding + or - keeps stepping
+    return;
+
+  if (region == REGION_BACK)
+  {
+    showPage(PAGE_HOME);
+    return;
+  }
+  else if (region == REGION_PLUS)
+  {
+    core.customWindow += customWindowStep(core.customWindow);
+    if (core.customWindow > BIN_HISTORY_SECONDS)
+      core.customWindow = BIN_HISTORY_SECONDS; // longest window the history holds
+  }
+  else if (region == REGION_MINUS)
+  {
+    if (core.customWindow > CUSTOM_WINDOW_MIN_SECONDS + customWindowStep(core.customWindow - 1))
+      core.customWindow -= customWindowStep(core.customWindow - 1);
+    else
+      core.customWindow = CUSTOM_WINDOW_MIN_SECONDS;
+  }
+  drawCustomWindowValue();
+}
+
+void drawCustomWindowValue()
+{
+  char label[8], padded[8];
+  formatWindow(core.customWindow, label, sizeof(label));
+  snprintf(padded, sizeof(padded), "%-5s", label); // trailing spaces clear a longer previous value
+  tft.setFont();
+  tft.setTextSize(2);
+  tft.setTextColor(ILI9341_WHITE, ILI9341_BLACK);
+  tft.setCursor(161, 150);
+  tft.println(padded);
+}
+
+void exitWifi()
+{
+  settings.data.isLogging = isLogging;
+  settings.save();
+}
+
+void touchWifi(int region, uint8_t event)
+{
+  if (event != TOUCH_PRESS)
+    return;
+
+  if (region == REGION_BACK)
+  {
+    showPage(PAGE_SETTINGS);
+  }
+  else if (region == WIFI_SETUP)
+  {
+    runWifiSetup();
+  }
+  else if (region == WIFI_UPLOAD)
+  {
+    uploadLogs();
+  }
+  else if (region == WIFI_LOGGING)
+  {
+    isLogging = !isLogging;
+    if (isLogging)
+    {
+      tft.fillRoundRect(3, 114, 234, 44, 4, 0x3B8F);
+      tft.drawRoundRect(3, 114, 234, 44, 4, WHITE);
+      tft.setCursor(38, 145);
+      tft.println("LOGGING ON");
+    }
+    else
     {
-      wasTouched = 1;
-      TS_Point p = ts.getPoint();
-      x = map(p.x, TS_MINX, TS_MAXX, 240, 0);
-      y = map(p.y, TS_MINY, TS_MAXY, 320, 0);
+      tft.fillRoundRect(3, 114, 234, 44, 4, 0xB9C7);
+      tft.drawRoundRect(3, 114, 234, 44, 4, WHITE);
+      tft.setCursor(33, 145);
+      tft.println("LOGGING OFF");
+    }
+  }
+  else if (region == WIFI_DEVICE_MODE)
+  {
+    showPage(PAGE_DEVICE_MODE);
+  }
+}
 
-      if ((x > 4 && x < 62) && (y > 271 && y < 315))
-      {
-        page = 1;
-        if (EEPROM.read(saveLoggingMode) != isLogging) // check current EEPROM value and only write if new value is different
-        {
-          EEPROM.write(saveLoggingMode, isLogging); 
-          EEPROM.commit();
-        }
-        drawSettingsPage();
-      }
-      else if ((x > 3 && x < 237) && (y > 64 && y < 108))  // wifi setup button
-      {
-        tft.setFont(&FreeSans9pt7b);
-        tft.setTextSize(1);
-
-        tft.fillRoundRect(10, 30, 220, 260, 6, ILI9341_BLACK);
-        tft.drawRoundRect(10, 30, 220, 260, 6, ILI9341_WHITE);
-
-        tft.setCursor(50, 50);
-        tft.println("AP SETUP MODE");
-        tft.drawFastHLine(50, 53, 145, ILI9341_WHITE);
-        tft.setCursor(20, 80);
-        tft.println("With any WiFi capable");
-        tft.setCursor(20, 100);
-        tft.println("device, connect to");
-        tft.setCursor(20, 120);
-        tft.println("network \"GC20\" and ");
-        tft.setCursor(20, 140);
-        tft.println("browse to 192.168.4.1");
-        tft.setCursor(20, 160);
-        tft.println("Enter credentials");
-        tft.setCursor(20, 180);
-        tft.println("of your WiFi network");
-        tft.setCursor(20, 200);
-        tft.println("and the Channel ID and");
-        tft.setCursor(20, 220);
-        tft.println("write API key of your");
-        tft.setCursor(20, 240);
-        tft.println("ThingSpeak channel");
-
-        delay(100);
-        WiFiManager wifiManager;
-
-        char channelIDSt[20];
-        char writeAPISt[20];
-
-        WiFiManagerParameter channel_id("0", "Channel ID", channelIDSt, 20); // create custom parameters for setup
-        
-        WiFiManagerParameter write_api("1", "Write API", writeAPISt, 20);
-        wifiManager.addParameter(&channel_id);
-        wifiManager.addParameter(&write_api);
-
-        wifiManager.startConfigPortal("GC20");            // put the esp in AP mode for wifi setup, create a network with name "GC20"
-
-        strcpy(channelIDSt, channel_id.getValue());
-        strcpy(writeAPISt, write_api.getValue());
-
-        size_t idLen = String(channelIDSt).length();
-
-        size_t apiLen = String(writeAPISt).length();
-
-        char channelInit = EEPROM.read(4001);  // first character of channelID is stored in EEPROM address 4001
-        char apiKeyInit = EEPROM.read(4002);   // Only overwrite channelIDSt and writeAPISt if new value of the first character is different from what was saved.
-
-        if (channelInit != channelIDSt[0])   
-        {
-          for (unsigned int a = 50; a < 50 + idLen; a++)
-          {
-            EEPROM.write((a), channelIDSt[a - 50]);
-          }
-          EEPROM.write(saveIDLen, idLen);
-        }
-
-        if(apiKeyInit != writeAPISt[0])
-        {
-          for (unsigned int b = 70; b < 70 + apiLen; b++)
-          {
-            EEPROM.write((b), writeAPISt[b - 70]);
-          }
-          EEPROM.write(saveAPILen, apiLen);
-        }
-
-        String ssidString = WiFi.SSID();      // retrieve ssid and password form the WifiManager library
-        String passwordString = WiFi.psk();
-
-        size_t ssidLen = ssidString.length();
-        size_t passLen = passwordString.length();
-
-        Serial.println(ssidLen);
-        Serial.println(passLen);
-
-        char ssidChar[20];
-        char passwordChar[20];
-
-        ssidString.toCharArray(ssidChar, ssidLen + 1); 
-        passwordString.toCharArray(passwordChar, passLen + 1);
-
-        for (unsigned int a = 10; a < 10 + ssidLen; a++)
-        {
-          EEPROM.write((a), ssidChar[a - 10]);             // save ssid and ssid length to EEPROM
-        }
-        EEPROM.write(saveSSIDLen, ssidLen);
-        
-        for (unsigned int b = 30; b < 30 + passLen; b++)
-        {    
-          EEPROM.write((b), passwordChar[b - 30]);          // save password and password length to EEPROM
-        }
-        EEPROM.write(savePWLen, passLen);
-
-        EEPROM.write(4001, channelIDSt[0]);                 // save first characters of channel ID and api key to EEPROM
-        EEPROM.write(4002, writeAPISt[0]);
-
-        EEPROM.commit();
-
-        tft.setCursor(16, 265);
-        tft.println("Settings saved. Restarting");
-
-        delay(1000);
-        
-        ESP.reset();
-      }
-      else if ((x > 3 && x < 237) && (y > 162 && y < 206)) // upload data
-      {
-        
-        drawBlankDialogueBox();
-        tft.setCursor(38, 100);
-        tft.println("Connecting to Wifi..");
-        delay(100);
-        Serial.println(ssid);
-        Serial.println(password);
-
-        WiFi.begin(ssid, password);
-
-        while (WiFi.status() != WL_CONNECTED) {    // Wait for the Wi-Fi to connect
-          delay(100);
-        }
-
-        tft.setCursor(36, 160);
-        tft.println("Creating JSON file..");
-        createJsonFile();                         // reads logged data from EEPROM and creates a json file
-        Serial.println(jsonBuffer);
-        delay(1000);
-        tft.setCursor(70, 220);
-        tft.println("Uploading..");
-        delay(1000);
-
-        char secondHalf[50] = "\",\"updates\":";      
-        strcat(data, channelAPIkey);
-        strcat(data, secondHalf);               
-
-        strcat(data,jsonBuffer);                // concatenate strings together and store in array named data
-        strcat(data,"}");
-
-        Serial.println(data);
-
-        client.stop();
-        String data_length = String(strlen(data)+1);   
-        
-        if (client.connect(server, 80)) {          // post data to thingspeak
-          char temp1[100] = "POST /channels/";
-          char temp2[30] = "/bulk_update.json HTTP/1.1";
-          
-          strcat(temp1, channelID);
-          strcat(temp1, temp2);
-
-          client.println(temp1); 
-          client.println("Host: api.thingspeak.com");
-          client.println("User-Agent: mw.doc.bulk-update (Arduino ESP8266)");
-          client.println("Connection: close");
-          client.println("Content-Type: application/json");
-          client.println("Content-Length: "+data_length);
-          client.println();
-          client.println(data);
-          client.stop();
-          
-          WiFi.disconnect();
-          WiFi.mode( WIFI_OFF );                // turn off wifi
-          WiFi.forceSleepBegin();
-          delay(1);
-
-          clearLogs();                 // erase logs and re-initialize the json buffer
-          tft.setCursor(43, 260);
-          tft.println("Resetting Device..");
-          delay(1000);
-          ESP.reset();                 
-        }
-        else 
-        {
-          tft.setCursor(50, 260);
-          tft.println("Failed to upload");
-          delay(1000);
-          ESP.reset();
-        }
-        
-      }
-      else if ((x > 3 && x < 237) && (y > 114 && y < 158)) // logging 
-      {
-        isLogging = !isLogging;
-        if (isLogging)
-        {
-          tft.fillRoundRect(3, 114, 234, 44, 4, 0x3B8F);
-          tft.drawRoundRect(3, 114, 234, 44, 4, WHITE);
-          tft.setCursor(38, 145);
-          tft.println("LOGGING ON");
-        }
-        else
-        {
-          tft.fillRoundRect(3, 114, 234, 44, 4, 0xB9C7);
-          tft.drawRoundRect(3, 114, 234, 44, 4, WHITE);
-          tft.setCursor(33, 145);
-          tft.println("LOGGING OFF");
-        }
-      }
-      else if ((x > 3 && x < 237) && (y > 214 && y < 258))  // device mode
-      {
-        page = 8;
-        drawDeviceModePage();
-      }
+void runWifiSetup() // AP mode portal for the WiFi credentials and ThingSpeak channel. Restarts the device
+{
+  tft.setFont(&FreeSans9pt7b);
+  tft.setTextSize(1);
+
+  tft.fillRoundRect(10, 30, 220, 260, 6, ILI9341_BLACK);
+  tft.drawRoundRect(10, 30, 220, 260, 6, ILI9341_WHITE);
+
+  tft.setCursor(50, 50);
+  tft.println("AP SETUP MODE");
+  tft.drawFastHLine(50, 53, 145, ILI9341_WHITE);
+  tft.setCursor(20, 80);
+  tft.println("With any WiFi capable");
+  tft.setCursor(20, 100);
+  tft.println("device, connect to");
+  tft.setCursor(20, 120);
+  tft.println("network \"GC20\" and ");
+  tft.setCursor(20, 140);
+  tft.println("browse to 192.168.4.1");
+  tft.setCursor(20, 160);
+  tft.println("Enter credentials");
+  tft.setCursor(20, 180);
+  tft.println("of your WiFi network");
+  tft.setCursor(20, 200);
+  tft.println("and the Channel ID and");
+  tft.setCursor(20, 220);
+  tft.println("write API key of your");
+  tft.setCursor(20, 240);
+  tft.println("ThingSpeak channel");
+
+  delay(100);
+  WiFiManager wifiManager;
+
+  WiFiManagerParameter channel_id("0", "Channel ID", settings.data.channelID, sizeof(settings.data.channelID) - 1); // create custom parameters for setup, filled in with what is saved
+  WiFiManagerParameter write_api("1", "Write API", settings.data.apiKey, sizeof(settings.data.apiKey) - 1);
+  char server[40];
+  snprintf(server, sizeof(server), settings.data.uploadPort == 80 ? "%s" : "%s:%u", settings.data.uploadHost, settings.data.uploadPort);
+  WiFiManagerParameter upload_server("2", "Upload server", server, sizeof(server) - 1); // host[:port], e.g. a stand-in server on the local network
+  char switchCpm[12];
+  snprintf(switchCpm, sizeof(switchCpm), "%lu", (unsigned long)settings.data.ttcSwitchCpm);
+  WiFiManagerParameter ttc_switch("3", "Time to count above CPM (0 = off)", switchCpm, sizeof(switchCpm) - 1);
+  wifiManager.addParameter(&channel_id);
+  wifiManager.addParameter(&write_api);
+  wifiManager.addParameter(&upload_server);
+  wifiManager.addParameter(&ttc_switch);
+
+  wifiManager.startConfigPortal("GC20");            // put the esp in AP mode for wifi setup, create a network with name "GC20"
+
+  if (channel_id.getValue()[0])                      // an empty field keeps the saved value
+    copyString(settings.data.channelID, channel_id.getValue(), sizeof(settings.data.channelID));
+  if (write_api.getValue()[0])
+    copyString(settings.data.apiKey, write_api.getValue(), sizeof(settings.data.apiKey));
+  if (upload_server.getValue()[0])
+  {
+    copyString(server, upload_server.getValue(), sizeof(server));
+    char *port = strchr(server, ':');
+    settings.data.uploadPort = port ? atoi(port + 1) : 80;
+    if (port)
+      *port = 0;
+    copyString(settings.data.uploadHost, server, sizeof(settings.data.uploadHost));
+  }
+  if (ttc_switch.getValue()[0])
+    settings.data.ttcSwitchCpm = strtoul(ttc_switch.getValue(), NULL, 10);
+  copyString(settings.data.ssid, WiFi.SSID().c_str(), sizeof(settings.data.ssid)); // retrieve ssid and password from the WifiManager library
+  copyString(settings.data.password, WiFi.psk().c_str(), sizeof(settings.data.password));
+  settings.data.wifiChannel = 0;                     // maybe another network, the next connect scans
+  settings.save();
+  flashLog.flush();
+
+  tft.setCursor(16, 265);
+  tft.println("Settings saved. Restarting");
+
+  delay(1000);
+  
+  ESP.reset();
+}
+
+void uploadLogs() // bulk upload of the logged data to ThingSpeak, a batch at a time. Restarts the device
+{
+  drawBlankDialogueBox();
+  tft.setCursor(38, 100);
+  tft.println("Connecting to Wifi..");
+  delay(100);
+  Serial.println(settings.data.ssid);
+
+  if (!wifiLink.up())
+    startWifi();
+  configTime(0, 0, "pool.ntp.org");     // dates the entries of this boot
+  unsigned long connectStart = millis();
+  while ((!wifiLink.up() || time(NULL) < CLOCK_VALID) && millis() - connectStart < UPLOAD_CONNECT_MILLIS) // Wait for the Wi-Fi and the clock
+  {
+    delay(50);
+    pollWifi();
+  }
+
+  flashLog.flush();
+  time_t now = time(NULL);
+  if (now >= CLOCK_VALID)
+    flashLog.setBootStart(now - millis() / 1000);
+  int status = 0;
+  uint32_t batches = 0;
+  uint32_t undated = 0;
+  while (wifiLink.up() && flashLog.pending())
+  {
+    if (batches)
+      delay(BULK_BATCH_MILLIS); // the server's rate limit
+    tft.fillRect(24, 150, 192, 60, ILI9341_BLACK);
+    tft.setCursor(36, 170);
+    tft.print(flashLog.pending());
+    tft.println(" entries left");
+    BulkBatch batch;
+    status = postBulkBatch(flashLog.sent(), batch);
+    Serial.println(status);
+    if (status < 200 || status > 299)
+      break; // not accepted, the entries stay unsent for the next try
+    flashLog.markSent(batch.end); // saved right away, an interrupted upload goes on from here
+    if (batch.relative)
+      undated += batch.entries;
+    batches++;
+  }
+
+  wifiLink.end();                       // turn off wifi
+  delay(1);
+
+  if (undated)
+  {
+    Serial.print(undated);
+    Serial.println(" log entries from boots without the clock sent with delta_t, dated back from the upload");
+    tft.fillRect(24, 150, 192, 60, ILI9341_BLACK);
+    tft.setCursor(36, 170);
+    tft.print(undated);
+    tft.println(" entries had no");
+    tft.setCursor(36, 190);
+    tft.println("clock, dated by upload");
+  }
+
+  if (flashLog.pending() == 0)
+  {
+    tft.setCursor(43, 230);
+    tft.println("Upload complete");
+  }
+  else
+  {
+    tft.setCursor(50, 230);
+    tft.println("Failed to upload");
+    if (status)
+    {
+      tft.setCursor(50, 250);
+      tft.print("HTTP ");
+      tft.println(status);
     }
   }
-  else if (page == 6) // timed count setup page
+  flashLog.flush();
+  tft.setCursor(43, 270);
+  tft.println("Resetting Device..");
+  delay(1000);
+  ESP.reset();
+}
+
+int postBulkBatch(uint32_t from, BulkBatch &batch) // one bulk update of at most BULK_MAX_ENTRIES from the log. HTTP status, 0 if there was none
+{
+  CountingPrint length;                     // first pass only measures the body for the Content-Length
+  {
+    PROFILE_SCOPE(PROFILE_JSON);
+    batch = writeBulkJson(length, flashLog, settings.data.apiKey, from, LOG_MILLIS / 1000);
+  }
+  if (batch.entries == 0)
+    return 0;                               // what is left is in damaged blocks, nothing to send
+
+  client.stop();
+#ifdef PROFILING
+  uint32_t postStart = ESP.getCycleCount();
+#endif
+  if (!client.connect(settings.data.uploadHost, settings.data.uploadPort))
+    return 0;
+
+  client.print("POST /channels/");
+  client.print(settings.data.channelID);
+  client.println("/bulk_update.json HTTP/1.1");
+  client.print("Host: ");
+  client.println(settings.data.uploadHost);
+  client.println("User-Agent: mw.doc.bulk-update (Arduino ESP8266)");
+  client.println("Connection: close");
+  client.println("Content-Type: application/json");
+  client.print("Content-Length: ");
+  client.println(length.count);
+  client.println();
+  BufferedPrint body(client);               // second pass streams the same bytes from the log
+  writeBulkJson(body, flashLog, settings.data.apiKey, from, LOG_MILLIS / 1000);
+  int status = 0;
+  if (body.send())
+  {
+    client.setTimeout(UPLOAD_RESPONSE_MILLIS);
+    status = readHttpStatus(client);
+  }
+  client.stop();
+#ifdef PROFILING
+  profiler.record(PROFILE_UPLOAD, ESP.getCycleCount() - postStart);
+#endif
+  return status;
+}
+
+void enterTimedCount()
+{
+  drawTimedCountPage();
+  drawTimedCountValue();
+}
+
+void touchTimedCount(int region, uint8_t event)
+{
+  bool step = region == REGION_PLUS || region == REGION_MINUS;
+  if (event != TOUCH_PRESS && !(step && event == TOUCH_REPEAT)) // holding + or - keeps stepping
+    return;
+
+  if (region == REGION_BACK)
+  {
+    showPage(PAGE_HOME);
+    core.currentCount = 0;
+    return;
+  }
+  else if (region == TIMED_COUNT_BEGIN)
+  {
+    showPage(timedCountMode ? PAGE_TIME_TO_COUNT : PAGE_TIMED_COUNT_RUNNING);
+    return;
+  }
+  else if (region == TIMED_COUNT_MODE) // switch between fixed time and fixed counts
+  {
+    timedCountMode = !timedCountMode;
+    drawTimedCountModeButton();
+  }
+  else if (region == REGION_PLUS)
   {
-    if (interval < 10)
+    if (timedCountMode)
     {
-      intervalSize = 1;
+      targetHundreds++;
+      if (targetHundreds >= 99)
+        targetHundreds = 99;
     }
-    else if (interval < 100)
+    else
     {
-      intervalSize = 2;
+      interval += 5;
+      if (interval >= 995)
+      {
+        interval = 995;
+      }
     }
-    else 
+  }
+  else if (region == REGION_MINUS)
+  {
+    if (timedCountMode)
     {
-      intervalSize = 3;
+      targetHundreds--;
+      if (targetHundreds <= 1)
+        targetHundreds = 1;
     }
-    
-    tft.setFont();
-    tft.setTextSize(3);
-    tft.setTextColor(ILI9341_WHITE, ILI9341_BLACK);
-    tft.setCursor((185 - (intervalSize - 1) * 11), 146);
-    tft.println(interval);
-
-    if (!ts.touched())
-      wasTouched = 0;
-    if (ts.touched() && !wasTouched)
+    else
     {
-      wasTouched = 1;
-      TS_Point p = ts.getPoint();
-      x = map(p.x, TS_MINX, TS_MAXX, 240, 0);
-      y = map(p.y, TS_MINY, TS_MAXY, 320, 0);
-
-      if ((x > 4 && x < 62) && (y > 271 && y < 315))
+      interval -= 5;
+      if (interval <= 5)
       {
-        page = 0;
-        drawHomePage();
-        currentCount = 0;
-        previousCount = 0;
-        for (int a = 0; a < 60; a++)
-        {
-          count[a] = 0; // counts need to be reset to prevent errorenous readings
-        }
-        for (int b = 0; b < 5; b++)
-        {
-          fastCount[b] = 0;
-        }
-        for (int c = 0; c < 180; c++)
-        {
-          slowCount[c] = 0;
-        }
+        interval = 5;
       }
-      else if ((x > 145 && x < 235) && (y > 271 && y < 315))
+    }
+  }
+  tft.fillRect(160, 130, 70, 40, ILI9341_BLACK);
+  drawTimedCountValue();
+}
+
+void drawTimedCountValue()
+{
+  int setupValue = timedCountMode ? targetHundreds : interval;
+  if (setupValue < 10)
+  {
+    intervalSize = 1;
+  }
+  else if (setupValue < 100)
+  {
+    intervalSize = 2;
+  }
+  else 
+  {
+    intervalSize = 3;
+  }
+
+  tft.setFont();
+  tft.setTextSize(3);
+  tft.setTextColor(ILI9341_WHITE, ILI9341_BLACK);
+  tft.setCursor((185 - (intervalSize - 1) * 11), 146);
+  tft.println(setupValue);
+}
+
+void enterTimedCountRunning()
+{
+  progress = 0;
+  drawTimedCountRunningPage(interval, intervalSize);
+}
+
+void tickTimedCountRunning(bool)
+{
+  elapsedTime = millis() - startMillis;
+  if(elapsedTime < intervalMillis)
+  {
+    if((millis() - previousMillis) >= 1000)
+    {
+      previousMillis = millis();
+
+      tft.setFont();
+      tft.setTextSize(3);
+      tft.setTextColor(ILI9341_WHITE, ILI9341_BLACK);
+      tft.setCursor(101, 181);
+      tft.println(core.currentCount);
+
+      char cpmText[16];
+      cpm = (uint64_t)core.currentCount * 60000000 / (1 + elapsedTime);
+      formatMilli(cpm, 2, 0, cpmText, sizeof(cpmText));
+      
+      tft.setCursor(101, 226);
+      tft.println(cpmText);
+
+      if(cpm < 10000)
       {
-        page = 7;
-        drawTimedCountRunningPage(interval, intervalSize);
+        tft.fillRect(170, 225, 50, 40, ILI9341_BLACK);
       }
-      else if ((x > 160 && x < 220) && (y > 70 && y < 120))
+      else if(cpm < 100000)
       {
-        interval += 5;
-        if (interval >= 995)
-        {
-          interval = 995;
-        }
-        tft.fillRect(160, 130, 70, 40, ILI9341_BLACK);
+        tft.fillRect(190, 225, 35, 40, ILI9341_BLACK);
       }
-      else if ((x > 160 && x < 220) && (y > 185 && y < 245))
+      else if(cpm < 1000000)
       {
-        interval -= 5;
-        if (interval <= 5)
-        {
-          interval = 5;
-        }
-        tft.fillRect(160, 130, 70, 40, ILI9341_BLACK);
+        tft.fillRect(209, 225, 18, 40, ILI9341_BLACK);
       }
     }
-  }
-  else if (page == 7) // timed count running page
-  {
-    elapsedTime = millis() - startMillis;
-    if(elapsedTime < intervalMillis)
+    int bar = map(elapsedTime, 0, intervalMillis, 0, 217);
+    if (bar != progress) // the bar only grows a pixel every few seconds on long counts
     {
-      if((millis() - previousMillis) >= 1000)
-      {
-        previousMillis = millis();
-
-        tft.setFont();
-        tft.setTextSize(3);
-        tft.setTextColor(ILI9341_WHITE, ILI9341_BLACK);
-        tft.setCursor(101, 181);
-        tft.println(currentCount);
-
-        cpm = float(currentCount) / float((1 + elapsedTime) / 60000.0);
-        
-        tft.setCursor(101, 226);
-        tft.println(cpm);
-
-        if(cpm < 10)
-        {
-          tft.fillRect(170, 225, 50, 40, ILI9341_BLACK);
-        }
-        else if(cpm < 100)
-        {
-          tft.fillRect(190, 225, 35, 40, ILI9341_BLACK);
-        }
-        else if(cpm < 1000)
-        {
-          tft.fillRect(209, 225, 18, 40, ILI9341_BLACK);
-        }
-      }
-      progress = map(elapsedTime, 0, intervalMillis, 0, 217);
+      progress = bar;
       tft.fillRect(12, 105, progress, 16, 0x25A6);
     }
-    else 
+  }
+  else 
+  {
+    if (completed == 0)
     {
-      if (completed == 0)
-      {
-        drawCloseButton();
-        completed = 1;
-      }
+      drawCloseButton();
+      completed = 1;
     }
-    
-    if (!ts.touched())
-      wasTouched = 0;
-    if (ts.touched() && !wasTouched)
-    {
-      wasTouched = 1;
-      TS_Point p = ts.getPoint();
-      x = map(p.x, TS_MINX, TS_MAXX, 240, 0);
-      y = map(p.y, TS_MINY, TS_MAXY, 320, 0);
+  }
+}
 
-      if ((x > 70 && x < 170) && (y > 271 && y < 315))
-      {
-        page = 0;
-        drawHomePage();
-        currentCount = 0;
-        previousCount = 0;
-        for (int a = 0; a < 60; a++)
-        {
-          count[a] = 0; // counts need to be reset to prevent errorenous readings
-        }
-        for (int b = 0; b < 5; b++)
-        {
-          fastCount[b] = 0;
-        }
-        for (int c = 0; c < 180; c++)
-        {
-          slowCount[c] = 0;
-        }
-      }
-    }
+void touchCountResult(int region, uint8_t event) // close button of the timed count and time to count pages
+{
+  if (event != TOUCH_PRESS)
+    return;
+  showPage(PAGE_HOME);
+  core.currentCount = 0;
+}
+
+void exitDeviceMode()
+{
+  settings.data.deviceMode = deviceMode;
+  settings.save();
+}
+
+void touchDeviceMode(int region, uint8_t event)
+{
+  if (event != TOUCH_PRESS)
+    return;
+
+  if (region == REGION_BACK)
+  {
+    showPage(PAGE_WIFI);
   }
-  else if (page == 8)          // device mode selection page
+  else if (region == DEVICE_MODE_COUNTER)
   {
-    if (!ts.touched())
-      wasTouched = 0;
-    if (ts.touched() && !wasTouched)
-    {
-      wasTouched = 1;
-      TS_Point p = ts.getPoint();
-      x = map(p.x, TS_MINX, TS_MAXX, 240, 0);
-      y = map(p.y, TS_MINY, TS_MAXY, 320, 0);
+    deviceMode = 0;
+    tft.setFont(&FreeSans12pt7b);
+    tft.fillRoundRect(4, 71, 232, 48, 4, 0x2A86);
+    tft.setCursor(13, 103);
+    tft.println("GEIGER COUNTER");
 
-      if ((x > 4 && x < 62) && (y > 271 && y < 315)) // back button
-      {
-        page = 5;
-        if (EEPROM.read(saveDeviceMode) != deviceMode) // check current EEPROM value and only write if new value is different
-        {
-          EEPROM.write(saveDeviceMode, deviceMode); 
-          EEPROM.commit();
-        }
-        drawWifiPage();
-      }
-      else if ((x > 4 && x < 234) && (y > 70 && y < 120))
-      {
-        deviceMode = 0;
-        tft.setFont(&FreeSans12pt7b);
-        tft.fillRoundRect(4, 71, 232, 48, 4, 0x2A86);
-        tft.setCursor(13, 103);
-        tft.println("GEIGER COUNTER");
+    tft.fillRoundRect(4, 128, 232, 48, 4, ILI9341_BLACK);
+    tft.setCursor(30, 160);
+    tft.println("MON. STATION");
+  }
+  else if (region == DEVICE_MODE_STATION)
+  {
+    deviceMode = 1;
+    tft.setFont(&FreeSans12pt7b);
+    tft.fillRoundRect(4, 71, 232, 48, 4, ILI9341_BLACK);
+    tft.setCursor(13, 103);
+    tft.println("GEIGER COUNTER");
 
-        tft.fillRoundRect(4, 128, 232, 48, 4, ILI9341_BLACK);
-        tft.setCursor(30, 160);
-        tft.println("MON. STATION");
+    tft.fillRoundRect(4, 128, 232, 48, 4, 0x2A86);
+    tft.setCursor(30, 160);
+    tft.println("MON. STATION");
+  }
+}
 
-      }
-      else if ((x > 4 && x < 234) && (y > 127 && y < 177))
-      {
-        deviceMode = 1;
-        tft.setFont(&FreeSans12pt7b);
-        tft.fillRoundRect(4, 71, 232, 48, 4, ILI9341_BLACK);
-        tft.setCursor(13, 103);
-        tft.println("GEIGER COUNTER");
+void enterTimeToCount()
+{
+  drawTimeToCountPage(targetHundreds * 100);
+}
 
-        tft.fillRoundRect(4, 128, 232, 48, 4, 0x2A86);
-        tft.setCursor(30, 160);
-        tft.println("MON. STATION");
+void exitTimeToCount()
+{
+  core.timedTtc.stop();
+}
 
-      }
+void tickTimeToCount(bool)
+{
+  if (core.timedTtc.running())
+  {
+    if((millis() - previousMillis) >= 1000)
+    {
+      previousMillis = millis();
+
+      tft.setFont();
+      tft.setTextSize(3);
+      tft.setTextColor(ILI9341_WHITE, ILI9341_BLACK);
+      tft.setCursor(101, 181);
+      tft.println(core.timedTtc.collected());
+
+      tft.setCursor(101, 226);
+      tft.println(core.timedTtc.runningCpm(core.deadTime.deadTimeNanos()));
+      tft.fillRect(210, 225, 20, 40, ILI9341_BLACK);
+
+      progress = map(core.timedTtc.collected(), 0, core.timedTtc.target(), 0, 217);
+      tft.fillRect(12, 105, progress, 16, 0x25A6);
+    }
+  }
+  else 
+  {
+    if (completed == 0)
+    {
+      tft.setFont();
+      tft.setTextSize(3);
+      tft.setTextColor(ILI9341_WHITE, ILI9341_BLACK);
+      tft.setCursor(101, 181);
+      tft.println(core.timedTtc.target());
+      tft.setCursor(101, 226);
+      tft.println(core.timedTtc.cpm(core.deadTime.deadTimeNanos()));
+      tft.fillRect(210, 225, 20, 40, ILI9341_BLACK);
+      tft.fillRect(12, 105, 217, 16, 0x25A6);
+
+      core.reportTimeToCount(core.timedTtc, "Timed");
+      drawCloseButton();
+      completed = 1;
     }
   }
 }
 
 void drawHomePage()
 {
+  doseWidget.invalidate(); // everything below is drawn over
+  cpmWidget.invalidate();
+  countsWidget.invalidate();
+  totalDoseWidget.invalidate();
 
   tft.fillRect(1, 21, 237, 298, ILI9341_BLACK);
   tft.drawRect(0, 0, tft.width(), tft.height(), ILI9341_WHITE);
@@ -1411,11 +1802,11 @@ void drawHomePage()
   tft.println("EFFECTIVE DOSE RATE:");
   tft.setCursor(165, 85);
   tft.setFont(&FreeSans12pt7b);
-  if (doseUnits == 0)
+  if (core.doseUnits == 0)
   {
     tft.println("uSv/hr");
   }
-  else if (doseUnits == 1)
+  else if (core.doseUnits == 1)
   {
     tft.println("mR/hr");
   }
@@ -1438,12 +1829,12 @@ void drawHomePage()
   tft.println("CUMULATIVE DOSE");
   tft.setCursor(7, 205);
   tft.println("Counts:");
-  if (doseUnits == 0)
+  if (core.doseUnits == 0)
   {
     tft.setCursor(34, 235);
     tft.println("uSv:");
   }
-  else if (doseUnits == 1)
+  else if (core.doseUnits == 1)
   {
     tft.setCursor(37, 235);
     tft.println("mR:");
@@ -1460,30 +1851,7 @@ void drawHomePage()
   tft.setCursor(70, 309);
   tft.println("COUNT");
 
-  if (integrationMode == 0)
-  {
-    tft.fillRoundRect(162, 259, 74, 57, 3, 0x2A86);
-    tft.setCursor(180, 283);
-    tft.println("INT");
-    tft.setCursor(177, 309);
-    tft.println("60 s");
-  }
-  else if (integrationMode == 1)
-  {
-    tft.fillRoundRect(162, 259, 74, 57, 3, 0x2A86);
-    tft.setCursor(180, 283);
-    tft.println("INT");
-    tft.setCursor(184, 309);
-    tft.println("5 s");
-  }
-  else if (integrationMode == 2)
-  {
-    tft.fillRoundRect(162, 259, 74, 57, 3, 0x2A86);
-    tft.setCursor(180, 283);
-    tft.println("INT");
-    tft.setCursor(169, 309);
-    tft.println("180 s");
-  }
+  drawIntegrationButton();
 
   if (ledSwitch)
   {
@@ -1575,13 +1943,13 @@ void drawUnitsPage()
   drawBackButton();
 
   tft.drawRoundRect(3, 70, 234, 50, 4, WHITE);
-  if (doseUnits == 0)
+  if (core.doseUnits == 0)
     tft.fillRoundRect(4, 71, 232, 48, 4, 0x2A86);
   tft.setCursor(30, 103);
   tft.println("Sieverts (uSv/hr)");
 
   tft.drawRoundRect(3, 127, 234, 50, 4, WHITE);
-  if (doseUnits == 1)
+  if (core.doseUnits == 1)
     tft.fillRoundRect(4, 128, 232, 48, 4, 0x2A86);
   tft.setCursor(47, 160);
   tft.println("Rems (mR/hr)");
@@ -1645,6 +2013,40 @@ void drawCalibrationPage()
   tft.setCursor(178, 232);
   tft.println("-");
   tft.setTextSize(1);
+
+  drawDeadTimeButton();
+}
+
+void drawCustomWindowPage()
+{
+  drawFrame();
+
+  tft.fillRoundRect(3, 23, 234, 40, 3, 0x3B8F);
+  tft.setFont(&FreeSans12pt7b);
+  tft.setCursor(22, 51);
+  tft.println("CUSTOM WINDOW");
+  tft.drawFastHLine(23, 55, 194, WHITE);
+
+  drawBackButton();
+
+  tft.setFont(&FreeSans9pt7b);
+  tft.setCursor(8, 154);
+  tft.println("Integration time");
+  tft.setCursor(8, 174);
+  tft.println("(INT on home)");
+
+  tft.drawRoundRect(160, 70, 60, 60, 4, ILI9341_WHITE);
+  tft.fillRoundRect(161, 71, 58, 58, 4, 0x2A86);
+  tft.drawRoundRect(160, 185, 60, 60, 4, ILI9341_WHITE);
+  tft.fillRoundRect(161, 186, 58, 58, 4, 0x2A86);
+
+  tft.setCursor(170, 113);
+  tft.setFont(&FreeSans12pt7b);
+  tft.setTextSize(3);
+  tft.println("+");
+  tft.setCursor(178, 232);
+  tft.println("-");
+  tft.setTextSize(1);
 }
 
 void drawWifiPage()
@@ -1689,11 +2091,13 @@ void drawWifiPage()
   tft.setCursor(35, 244);
   tft.println("DEVICE MODE");
 
-  if (addr > 2000)
+  uint32_t pending = flashLog.pending();
+  if (pending > 0)
   {
     tft.setFont(&FreeSans9pt7b);
-    tft.setCursor(80, 297);
-    tft.println("Log memory full"); 
+    tft.setCursor(40, 297);
+    tft.print(pending);
+    tft.println(" entries to upload");
   }
 }
 
@@ -1714,9 +2118,7 @@ void drawTimedCountPage()
   tft.println("TIMED COUNT");
   tft.drawFastHLine(35, 55, 163, WHITE);
 
-  tft.setFont(&FreeSans9pt7b);
-  tft.setCursor(5, 162);
-  tft.println("Duration (minutes):");
+  drawTimedCountModeButton();
 
   tft.drawRoundRect(160, 70, 60, 60, 4, ILI9341_WHITE);
   tft.fillRoundRect(161, 71, 58, 58, 4, 0x2A86);
@@ -1766,12 +2168,46 @@ void drawTimedCountRunningPage(int duration, int size)
   tft.setCursor(37, 245);
   tft.println("CPM:");
 
-  currentCount = 0;
+  core.currentCount = 0;
   startMillis = millis();
   intervalMillis = duration * 60000;
   completed = 0;
 }
 
+void drawTimeToCountPage(int target)
+{
+  drawFrame();
+
+  drawCancelButton();
+
+  tft.fillRoundRect(3, 23, 234, 40, 3, 0x3B8F);
+  tft.setFont(&FreeSans12pt7b);
+  tft.setTextSize(1);
+  tft.setCursor(22, 51);
+  tft.println("TIME TO COUNT");
+  tft.drawFastHLine(23, 55, 190, WHITE);
+
+  tft.drawRoundRect(3, 66, 234, 95, 4, ILI9341_WHITE);
+  tft.drawRect(10, 103, 220, 20, ILI9341_WHITE);
+  tft.drawRoundRect(3, 164, 234, 103, 4, ILI9341_WHITE);
+
+  tft.setCursor(58, 90);
+  tft.println("Progress:");
+  tft.setCursor(13, 150);
+  tft.println("Target:");
+  tft.setCursor(100, 150);
+  tft.println(target);
+  tft.setCursor(165, 150);
+  tft.println("cts");
+  tft.setCursor(15, 200);
+  tft.println("Counts:");
+  tft.setCursor(37, 245);
+  tft.println("CPM:");
+
+  core.timedTtc.start(target, false);
+  completed = 0;
+}
+
 void drawDeviceModePage()
 {
   drawFrame();
@@ -1807,11 +2243,178 @@ void drawDeviceModePage()
 
 void isr() // interrupt service routine
 {
-  if ((micros() - 200) > previousIntMicros){
-    currentCount++;
-    cumulativeCount++;
+  PROFILE_SCOPE(PROFILE_ISR);
+  uint32_t stamp = ESP.getCycleCount();
+  if (pulseQueue.pulse(stamp)) // the host simulator drives the same call
+    click(stamp);
+}
+
+void click(uint32_t stamp) // starts the click for a counted pulse, or switches to the tone at high rates
+{
+  uint32_t gap = stamp - lastPulseStamp;
+  lastPulseStamp = stamp;
+  if (gap > TONE_SILENCE_MICROS * cyclesPerMicro)
+    gap = TONE_SILENCE_MICROS * cyclesPerMicro; // a quiet spell shouldn't take many pulses to forget
+  pulseGap = pulseGap - pulseGap / 16 + gap / 16;
+
+  if (clickState == CLICK_TONE)
+    return; // the timer keeps the tone going as long as pulses keep coming
+  if (pulseGap < TONE_ENTER_MICROS * cyclesPerMicro)
+  {
+    clickState = CLICK_TONE;
+    timer1_enable(TIM_DIV16, TIM_EDGE, TIM_LOOP);
+    timer1_write(TIMER1_TICKS_PER_MICRO * 1000000 / (2 * TONE_HZ)); // two edges per period
+    digitalWrite(D3, ledSwitch); // the LED stays lit instead of flickering
+    return;
+  }
+  if (stamp - clickStamp < CLICK_HOLDOFF_MICROS * cyclesPerMicro)
+    return; // merged into the previous click
+  clickStamp = stamp;
+  if (!ledSwitch && !buzzerSwitch)
+    return;
+  digitalWrite(D3, ledSwitch);
+  digitalWrite(D0, buzzerSwitch);
+  clickState = CLICK_ON;
+  timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
+  timer1_write(CLICK_MICROS * TIMER1_TICKS_PER_MICRO);
+}
+
+void clickTimerIsr() // ends a click, or toggles the buzzer while in tone mode
+{
+  if (clickState == CLICK_TONE)
+  {
+    uint32_t silence = ESP.getCycleCount() - lastPulseStamp;
+    bool slow = pulseGap > TONE_EXIT_MICROS * cyclesPerMicro;
+    if (!slow && silence < TONE_SILENCE_MICROS * cyclesPerMicro)
+    {
+      toneHigh = !toneHigh;
+      digitalWrite(D0, buzzerSwitch && toneHigh);
+      digitalWrite(D3, ledSwitch);
+      return;
+    }
+    timer1_disable();
+    if (!slow)
+      pulseGap = TONE_EXIT_MICROS * cyclesPerMicro; // the average is stale after a silence. Safe, isr() can't preempt this one
+  }
+  digitalWrite(D3, LOW);
+  digitalWrite(D0, LOW);
+  clickState = CLICK_IDLE;
+}
+
+void binTimerIsr() // fires on exact one second boundaries, independent of how long loop() takes
+{
+  nextBinCycles += binCycles; // rearm relative to the previous boundary, not to now, so bins never drift
+  timer0_write(nextBinCycles);
+  binBoundaryTotal = pulseQueue.total();
+  binBoundarySeq++;
+}
+
+void HomeDisplay::showReading(const Reading &reading) // draws a closed bin's reading on the home page
+{
+  if (page != PAGE_HOME || displayAsleep)
+    return;
+  PROFILE_SCOPE(PROFILE_RENDER);
+
+  formatDoseRate(reading.doseRate, dose, sizeof(dose)); // fewer decimals as the dose rate grows
+  formatMilli(reading.totalDose, 2, 0, totalDoseText, sizeof(totalDoseText));
+
+  char countText[12];
+  snprintf(countText, sizeof(countText), "%lu", (unsigned long)reading.averageCount);
+  homeRenderStats.add(doseWidget.render(tft, dose)); // effective dose rate
+  homeRenderStats.add(cpmWidget.render(tft, countText));
+  snprintf(countText, sizeof(countText), "%lu", (unsigned long)reading.cumulativeCount);
+  homeRenderStats.add(countsWidget.render(tft, countText)); // total counts since reset
+  homeRenderStats.add(totalDoseWidget.render(tft, totalDoseText)); // cumulative dose
+  homeRenderStats.endFrame();
+  if (homeRenderStats.frames % RENDER_REPORT_FRAMES == 0)
+  {
+    Serial.print("Home page bytes per frame, last: ");
+    Serial.print(homeRenderStats.lastFrame);
+    Serial.print(" average: ");
+    Serial.print(homeRenderStats.totalBytes / homeRenderStats.frames);
+    Serial.print(" max: ");
+    Serial.println(homeRenderStats.maxFrame);
+  }
+
+  if (reading.doseLevel != previousDoseLevel) // only update alert level if it changed. This prevents flicker
+  {
+    if (reading.doseLevel == 0)
+    {
+      tft.drawRect(0, 0, tft.width(), tft.height(), ILI9341_WHITE);
+      tft.fillRoundRect(3, 94, 234, 21, 3, 0x2DC6);
+      tft.setCursor(15, 104);
+      tft.setFont(&FreeSans9pt7b);
+      tft.setTextColor(ILI9341_WHITE);
+      tft.setTextSize(1);
+      tft.println("NORMAL BACKGROUND");
+
+      previousDoseLevel = reading.doseLevel;
+    }
+    else if (reading.doseLevel == 1)
+    {
+      tft.drawRect(0, 0, tft.width(), tft.height(), ILI9341_WHITE);
+      tft.fillRoundRect(3, 94, 234, 21, 3, 0xCE40);
+      tft.setCursor(29, 104);
+      tft.setFont(&FreeSans9pt7b);
+      tft.setTextColor(ILI9341_WHITE);
+      tft.setTextSize(1);
+      tft.println("ELEVATED ACTIVITY");
+
+      previousDoseLevel = reading.doseLevel;
+    }
+    else if (reading.doseLevel == 2)
+    {
+      tft.drawRect(0, 0, tft.width(), tft.height(), ILI9341_RED);
+      tft.fillRoundRect(3, 94, 234, 21, 3, 0xB8A2);
+      tft.setCursor(17, 104);
+      tft.setFont(&FreeSans9pt7b);
+      tft.setTextColor(ILI9341_WHITE);
+      tft.setTextSize(1);
+      tft.println("HIGH RADIATION LEVEL");
+
+      previousDoseLevel = reading.doseLevel;
+    }
+    else if (reading.doseLevel == 3)
+    {
+      tft.drawRect(0, 0, tft.width(), tft.height(), ILI9341_RED);
+      tft.fillRoundRect(3, 94, 234, 21, 3, ILI9341_RED);
+      tft.setCursor(37, 104);
+      tft.setFont(&FreeSans9pt7b);
+      tft.setTextColor(ILI9341_WHITE);
+      tft.setTextSize(1);
+      tft.println("TUBE SATURATED");
+
+      previousDoseLevel = reading.doseLevel;
+    }
   }
-  previousIntMicros = micros();
+}
+
+void formatWindow(unsigned int seconds, char *label, size_t size)
+{
+  if (seconds >= 600 && seconds % 60 == 0)
+    snprintf(label, size, "%u m", seconds / 60); // long custom windows are shown in minutes
+  else
+    snprintf(label, size, "%u s", seconds);
+}
+
+void drawIntegrationButton()
+{
+  char label[8];
+  if (core.integrationMode == 4)
+    strcpy(label, "AUTO");
+  else
+    formatWindow(core.integrationSeconds(), label, sizeof(label));
+
+  tft.fillRoundRect(162, 259, 74, 57, 3, 0x2A86);
+  tft.setFont(&FreeSans12pt7b);
+  tft.setTextSize(1);
+  tft.setCursor(180, 283);
+  tft.println("INT");
+  if (core.integrationMode == 4)
+    tft.setCursor(168, 309);
+  else
+    tft.setCursor(184 - (strlen(label) - 3) * 8, 309); // keeps the label centred, "5 s" sits at 184
+  tft.println(label);
 }
 
 void drawBackButton(){
@@ -1870,6 +2473,50 @@ void drawFrame(){
   }
 }
 
+void drawDeadTimeButton()
+{
+  tft.fillRoundRect(70, 271, 166, 45, 3, 0x2A86);
+  tft.drawRoundRect(70, 271, 166, 45, 3, ILI9341_WHITE);
+  tft.setFont(&FreeSans9pt7b);
+  tft.setTextSize(1);
+  tft.setTextColor(ILI9341_WHITE);
+  tft.setCursor(76, 289);
+  tft.print("Dead time ");
+  tft.print((core.deadTime.deadTimeNanos() + 500) / 1000);
+  tft.println(" us");
+  tft.setCursor(76, 310);
+  if (core.deadTime.model == DEAD_TIME_NON_PARALYZABLE)
+    tft.println("Non-paralyzable");
+  else if (core.deadTime.model == DEAD_TIME_PARALYZABLE)
+    tft.println("Paralyzable");
+  else
+    tft.println("No correction");
+}
+
+void drawTimedCountModeButton()
+{
+  tft.fillRoundRect(70, 271, 72, 45, 3, 0x6269);
+  tft.drawRoundRect(70, 271, 72, 45, 3, ILI9341_WHITE);
+  tft.setFont(&FreeSans9pt7b);
+  tft.setTextSize(1);
+  tft.setTextColor(ILI9341_WHITE);
+
+  tft.fillRect(3, 140, 155, 30, ILI9341_BLACK);
+  tft.setCursor(5, 162);
+  if (timedCountMode)
+  {
+    tft.println("Counts (hundreds):");
+    tft.setCursor(82, 299);
+    tft.println("TIME");
+  }
+  else
+  {
+    tft.println("Duration (minutes):");
+    tft.setCursor(74, 299);
+    tft.println("COUNT");
+  }
+}
+
 void drawCancelButton()
 {
   tft.fillRoundRect(70, 271, 100, 45, 3, 0xB9C7);
@@ -1910,57 +2557,106 @@ void EEPROMWritelong(int address, long value) {
   EEPROM.write(address + 3, one);
 }
 
-void createJsonFile()
+void drawBlankDialogueBox()
 {
-  Serial.println(addr);
-  for (int i = 100; i < addr; i += 4)
-  {
-    int count = EEPROMReadlong(i);
-
-    int deltaT = 600;
-    strcat(jsonBuffer,"{\"delta_t\":");
-    size_t lengthT = String(deltaT).length();
-    char temp[10];
-    String(deltaT).toCharArray(temp,lengthT + 1);
-    strcat(jsonBuffer,temp);
-    strcat(jsonBuffer,",");
-
-    strcat(jsonBuffer, "\"field1\":");
-    lengthT = String(count).length();
-    String(count).toCharArray(temp, lengthT + 1);
+  tft.setFont(&FreeSans9pt7b);
+  tft.setTextSize(1);
 
-    strcat(jsonBuffer,temp);
-    strcat(jsonBuffer,"},");
+  tft.fillRoundRect(20, 50, 200, 220, 6, ILI9341_BLACK);
+  tft.drawRoundRect(20, 50, 200, 220, 6, ILI9341_WHITE);
 
-  }
-  size_t len = strlen(jsonBuffer);
-  jsonBuffer[len-1] = ']';
+}
 
+void copyString(char *to, const char *from, size_t size) // truncates to fit
+{
+  strncpy(to, from, size - 1);
+  to[size - 1] = 0;
 }
 
-void drawBlankDialogueBox()
+void readEepromString(int address, int lengthAddress, char *to, size_t size)
 {
-  tft.setFont(&FreeSans9pt7b);
-  tft.setTextSize(1);
+  size_t length = EEPROM.read(lengthAddress);
+  if (length >= size || length >= 20) // 20 byte slots, an erased length reads 255
+    length = 0;
+  for (size_t i = 0; i < length; i++)
+    to[i] = EEPROM.read(address + i);
+  to[length] = 0;
+}
 
-  tft.fillRoundRect(20, 50, 200, 220, 6, ILI9341_BLACK);
-  tft.drawRoundRect(20, 50, 200, 220, 6, ILI9341_WHITE);
+void importEepromSettings() // one time move of the settings older firmware kept at fixed EEPROM addresses
+{
+  if (EEPROM.read(saveUnits) > 1)
+    return; // erased sector, the older firmware never ran. Keep the defaults
+  settings.data.doseUnits = EEPROM.read(saveUnits);
+  settings.data.alarmThreshold = constrain(EEPROM.read(saveAlertThreshold), 2, 100);
+  settings.data.conversionFactor = max(EEPROM.read(saveCalibration), (uint8_t)1);
+  settings.data.deviceMode = EEPROM.read(saveDeviceMode) == 1;
+  settings.data.isLogging = EEPROM.read(saveLoggingMode) == 1;
+  readEepromString(10, saveSSIDLen, settings.data.ssid, sizeof(settings.data.ssid));
+  readEepromString(30, savePWLen, settings.data.password, sizeof(settings.data.password));
+  readEepromString(50, saveIDLen, settings.data.channelID, sizeof(settings.data.channelID));
+  readEepromString(70, saveAPILen, settings.data.apiKey, sizeof(settings.data.apiKey));
+  for (uint8_t r = 0; r < SETTINGS_RECORDS; r++)
+  {
+    int address = saveRecords + r * SETTINGS_RECORD_BYTES;
+    if (EEPROM.read(address) >= SETTINGS_RECORD_BYTES)
+      continue; // erased
+    for (uint8_t i = 0; i < SETTINGS_RECORD_BYTES && address + i < 4096; i++)
+      settings.data.records[r][i] = EEPROM.read(address + i);
+  }
+}
 
+void importEepromLog() // one time move of the 10 minute entries older firmware logged to the EEPROM
+{
+  long addr = EEPROMReadlong(96); // end of the logged data
+  if (addr <= 100 || addr > 2100)
+    return;
+  for (long i = 100; i < addr; i += 4)
+    flashLog.append((i - 96) / 4 * 600, EEPROMReadlong(i));
+  flashLog.startBoot(); // their times don't continue into this boot
+  EEPROMWritelong(96, 100);
+  EEPROM.commit();
 }
 
-void clearLogs()
+#ifdef DOSE_BENCHMARK
+void runDoseBenchmark() // cycle counts of the fixed-point dose pipeline against the float code it replaced
 {
-  for (int j = 100; j < 4000; j ++)
+  const int runs = 1000;
+  volatile uint32_t sink = 0;
+  char text[12];
+
+  uint32_t start = ESP.getCycleCount();
+  for (int r = 0; r < runs; r++)
   {
-    EEPROMWritelong(j, 0);
+    unsigned long observed = 20 + r * 37;
+    unsigned long corrected = ((observed) / (1 - 0.00000333 * float(observed)));
+    float rate = corrected / float(core.conversionFactor);
+    float total = (100000 + r) / (60 * float(core.conversionFactor));
+    if (rate < 10.0)
+      dtostrf(rate, 4, 2, text);
+    else if (rate < 100)
+      dtostrf(rate, 4, 1, text);
+    else
+      dtostrf(rate, 4, 0, text);
+    dtostrf(total, 4, 2, text);
+    sink += text[0];
   }
-  for (int k = 1; k < 1000; k++) // keep the first character in jsonBuffer: "["
+  uint32_t floatCycles = ESP.getCycleCount() - start;
+
+  start = ESP.getCycleCount();
+  for (int r = 0; r < runs; r++)
   {
-    jsonBuffer[k] = 0;
+    unsigned long observed = 20 + r * 37;
+    uint32_t corrected = correctNonParalyzable(observed, 200000);
+    formatDoseRate(doseRateMilli(corrected, core.conversionFactor, 0), text, sizeof(text));
+    formatMilli(totalDoseMilli(100000 + r, core.conversionFactor, 0), 2, 0, text, sizeof(text));
+    sink += text[0];
   }
-  addr = 100;
-  EEPROMWritelong(96, addr);
-  EEPROM.write(saveLoggingMode, 0);
-  EEPROM.commit();
-  isLogging = 0;
-}
\ No newline at end of file
+  uint32_t fixedCycles = ESP.getCycleCount() - start;
+
+  Serial.print("Dose pipeline cycles per update, float: ");
+  Serial.print(floatCycles / runs);
+  Serial.print(" fixed: ");
+  Serial.println(fixedCycles / runs);
+}
+#endif
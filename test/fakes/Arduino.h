@@ -0,0 +1,116 @@
+/*  Arduino core stand-in for the native tests
+    Just what the libraries use: millis() and the cycle counter on clocks the test moves, map(), Print
+    and Stream. A Stream reads from a string and times out at its end.
+*/
+#ifndef FAKE_ARDUINO_H
+#define FAKE_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+using std::max;
+using std::min;
+
+#define F_CPU 160000000L
+
+inline uint32_t fakeMillis = 0; // the tests set and advance this
+inline uint32_t fakeCycles = 0;
+
+inline uint32_t millis()
+{
+  return fakeMillis;
+}
+
+inline uint32_t micros()
+{
+  return fakeMillis * 1000;
+}
+
+inline void delay(uint32_t ms)
+{
+  fakeMillis += ms;
+}
+
+inline void yield()
+{
+}
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+class EspClass
+{
+public:
+  uint32_t getCycleCount() { return fakeCycles; }
+};
+
+inline EspClass ESP;
+
+struct IPAddress
+{
+  uint32_t address;
+  IPAddress(uint32_t address = 0) : address(address) {}
+};
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *data, size_t size)
+  {
+    size_t n = 0;
+    while (n < size && write(data[n]))
+      n++;
+    return n;
+  }
+  size_t print(const char *text) { return write((const uint8_t *)text, strlen(text)); }
+  size_t println(const char *text) { return print(text) + print("\r\n"); }
+  size_t println() { return print("\r\n"); }
+};
+
+class StringPrint : public Print // collects what is printed
+{
+public:
+  using Print::write;
+  size_t write(uint8_t c)
+  {
+    text += (char)c;
+    return 1;
+  }
+
+  std::string text;
+};
+
+class Stream : public Print
+{
+public:
+  Stream(const std::string &input = "") : input(input) {}
+  using Print::write;
+  size_t write(uint8_t) { return 1; }
+  int read() { return position < input.size() ? (uint8_t)input[position++] : -1; }
+  size_t readBytesUntil(char terminator, char *buffer, size_t length)
+  {
+    size_t n = 0;
+    while (n < length)
+    {
+      int c = read();
+      if (c < 0 || c == terminator)
+        break;
+      buffer[n++] = c;
+    }
+    return n;
+  }
+
+private:
+  std::string input;
+  size_t position = 0;
+};
+
+#endif
@@ -0,0 +1,76 @@
+/*  ESP8266WiFi stand-in for the native tests
+    WiFi plays one router on millis(): an attempt joins after a scan, or sooner with the right BSSID and channel,
+    and never with the wrong ones. The test switches the router off, moves it or drops the link.
+*/
+#ifndef FAKE_ESP8266_WIFI_H
+#define FAKE_ESP8266_WIFI_H
+
+#include <Arduino.h>
+
+#define FAKE_WIFI_SCAN_MILLIS 2500
+#define FAKE_WIFI_FAST_MILLIS 300
+
+enum wl_status_t
+{
+  WL_IDLE_STATUS,
+  WL_CONNECTED,
+  WL_DISCONNECTED
+};
+
+enum WiFiMode_t
+{
+  WIFI_OFF,
+  WIFI_STA
+};
+
+class ESP8266WiFiClass
+{
+public:
+  void begin(const char *, const char *, int32_t channel = 0, const uint8_t *bssid = nullptr)
+  {
+    begins++;
+    linked = false;
+    joining = channel == 0 || (channel == routerChannel && memcmp(bssid, routerBssid, 6) == 0);
+    if (channel)
+      fastBegins++;
+    joinAt = millis() + (channel ? FAKE_WIFI_FAST_MILLIS : FAKE_WIFI_SCAN_MILLIS);
+  }
+  wl_status_t status()
+  {
+    if (!routerUp)
+      linked = false;
+    else if (joining && (int32_t)(millis() - joinAt) >= 0)
+    {
+      joining = false;
+      linked = true;
+    }
+    return linked ? WL_CONNECTED : WL_DISCONNECTED;
+  }
+  uint8_t *BSSID() { return routerBssid; }
+  int32_t channel() { return routerChannel; }
+  void disconnect()
+  {
+    linked = false;
+    joining = false;
+  }
+  void persistent(bool) {}
+  void setAutoReconnect(bool) {}
+  void forceSleepWake() {}
+  void forceSleepBegin() {}
+  void mode(WiFiMode_t) {}
+
+  bool routerUp = true;
+  uint8_t routerBssid[6] = {2, 0, 0, 0, 0, 1};
+  int32_t routerChannel = 6;
+  bool linked = false;         // clear it to drop the link
+  uint32_t begins = 0;
+  uint32_t fastBegins = 0;
+
+private:
+  bool joining = false;
+  uint32_t joinAt = 0;
+};
+
+inline ESP8266WiFiClass WiFi;
+
+#endif
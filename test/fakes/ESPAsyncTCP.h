@@ -0,0 +1,71 @@
+/*  ESPAsyncTCP stand-in for the native tests
+    An AsyncClient keeps what is written and the handlers it was given. The test plays the network with the
+    fake...() calls on fakeClient, the client constructed last, and decides whether connect() succeeds and how much
+    room space() reports.
+*/
+#ifndef FAKE_ESP_ASYNC_TCP_H
+#define FAKE_ESP_ASYNC_TCP_H
+
+#include <Arduino.h>
+#include <lwip/dns.h>
+#include <functional>
+
+class AsyncClient;
+
+typedef std::function<void(void *, AsyncClient *)> AcConnectHandler;
+typedef std::function<void(void *, AsyncClient *, int8_t error)> AcErrorHandler;
+typedef std::function<void(void *, AsyncClient *, void *data, size_t length)> AcDataHandler;
+
+inline AsyncClient *fakeClient = nullptr;
+
+class AsyncClient
+{
+public:
+  AsyncClient() { fakeClient = this; }
+  bool connect(IPAddress, uint16_t) { return accepts; }
+  void close(bool = false) { closes++; }
+  size_t space() { return room; }
+  size_t write(const char *data, size_t size)
+  {
+    written.append(data, size);
+    return size;
+  }
+  void onConnect(AcConnectHandler handler, void *arg = nullptr)
+  {
+    connectHandler = handler;
+    connectArg = arg;
+  }
+  void onDisconnect(AcConnectHandler handler, void *arg = nullptr)
+  {
+    disconnectHandler = handler;
+    disconnectArg = arg;
+  }
+  void onError(AcErrorHandler handler, void *arg = nullptr)
+  {
+    errorHandler = handler;
+    errorArg = arg;
+  }
+  void onData(AcDataHandler handler, void *arg = nullptr)
+  {
+    dataHandler = handler;
+    dataArg = arg;
+  }
+
+  void fakeConnect() { connectHandler(connectArg, this); }
+  void fakeDisconnect() { disconnectHandler(disconnectArg, this); }
+  void fakeError(int8_t error) { errorHandler(errorArg, this, error); }
+  void fakeReceive(const char *data, size_t size) { dataHandler(dataArg, this, (void *)data, size); }
+
+  bool accepts = true;
+  size_t room = 100;
+  std::string written;
+  uint32_t closes = 0;
+
+private:
+  AcConnectHandler connectHandler, disconnectHandler;
+  AcErrorHandler errorHandler;
+  AcDataHandler dataHandler;
+  void *connectArg, *disconnectArg, *errorArg, *dataArg;
+};
+
+#endif
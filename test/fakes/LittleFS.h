@@ -0,0 +1,92 @@
+/*  LittleFS stand-in for the native tests
+    Files are byte vectors in a map the tests can look into, damage or clear. An open File shares its vector with the
+    map, so a write shows up at once, as with a single handle on the real filesystem.
+*/
+#ifndef FAKE_LITTLEFS_H
+#define FAKE_LITTLEFS_H
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+typedef std::vector<uint8_t> FakeFile;
+
+inline std::map<std::string, std::shared_ptr<FakeFile>> fakeFiles;
+
+class File
+{
+public:
+  size_t write(const uint8_t *data, size_t size)
+  {
+    if (file->size() < offset + size)
+      file->resize(offset + size);
+    memcpy(file->data() + offset, data, size);
+    offset += size;
+    return size;
+  }
+  size_t read(uint8_t *data, size_t size)
+  {
+    size_t n = min(size, file->size() - offset);
+    memcpy(data, file->data() + offset, n);
+    offset += n;
+    return n;
+  }
+  bool seek(uint32_t to)
+  {
+    if (to > file->size())
+      return false;
+    offset = to;
+    return true;
+  }
+  bool truncate(uint32_t size)
+  {
+    file->resize(size);
+    offset = min(offset, (size_t)size);
+    return true;
+  }
+  size_t size() const { return file->size(); }
+  size_t position() const { return offset; }
+  void close() { file.reset(); }
+  explicit operator bool() const { return (bool)file; }
+
+private:
+  friend class FS;
+  std::shared_ptr<FakeFile> file;
+  size_t offset = 0;
+};
+
+class FS
+{
+public:
+  bool begin() { return true; }
+  File open(const char *path, const char *mode)
+  {
+    File result;
+    auto found = fakeFiles.find(path);
+    if (mode[0] == 'r' && found == fakeFiles.end())
+      return result;
+    if (mode[0] == 'w' || found == fakeFiles.end())
+      found = fakeFiles.insert_or_assign(path, std::make_shared<FakeFile>()).first;
+    result.file = found->second;
+    if (mode[0] == 'a')
+      result.offset = result.file->size();
+    return result;
+  }
+  bool exists(const char *path) { return fakeFiles.count(path); }
+  bool remove(const char *path) { return fakeFiles.erase(path); }
+  bool rename(const char *from, const char *to)
+  {
+    auto found = fakeFiles.find(from);
+    if (found == fakeFiles.end())
+      return false;
+    fakeFiles[to] = found->second;
+    fakeFiles.erase(from);
+    return true;
+  }
+  bool mkdir(const char *) { return true; }
+};
+
+inline FS LittleFS;
+
+#endif
@@ -0,0 +1,25 @@
+/*  XPT2046_Touchscreen stand-in for the native tests
+    The test sets whether the panel is touched and where, in raw controller units.
+*/
+#ifndef FAKE_XPT2046_TOUCHSCREEN_H
+#define FAKE_XPT2046_TOUCHSCREEN_H
+
+#include <Arduino.h>
+
+struct TS_Point
+{
+  int16_t x, y, z;
+};
+
+class XPT2046_Touchscreen
+{
+public:
+  bool touched() { return pressed; }
+  bool tirqTouched() { return pressed; }
+  TS_Point getPoint() { return point; }
+
+  bool pressed = false;
+  TS_Point point = {2000, 2000, 1000};
+};
+
+#endif
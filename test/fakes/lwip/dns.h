@@ -0,0 +1,37 @@
+/*  lwIP DNS stand-in for the native tests
+    dns_gethostbyname() answers with fakeDnsAnswer. On ERR_OK the address is fakeDnsAddress at once, on
+    ERR_INPROGRESS the callback is kept for the test to call.
+*/
+#ifndef FAKE_LWIP_DNS_H
+#define FAKE_LWIP_DNS_H
+
+#include <stdint.h>
+
+typedef int8_t err_t;
+#define ERR_OK 0
+#define ERR_INPROGRESS -5
+#define ERR_ARG -16
+
+struct ip_addr_t
+{
+  uint32_t addr;
+};
+#define ip_addr_get_ip4_u32(address) ((address)->addr)
+
+typedef void (*dns_found_callback)(const char *name, const ip_addr_t *address, void *arg);
+
+inline err_t fakeDnsAnswer = ERR_INPROGRESS;
+inline uint32_t fakeDnsAddress = 0x0100007f;
+inline dns_found_callback fakeDnsCallback = nullptr;
+inline void *fakeDnsArg = nullptr;
+
+inline err_t dns_gethostbyname(const char *, ip_addr_t *address, dns_found_callback found, void *arg)
+{
+  fakeDnsCallback = found;
+  fakeDnsArg = arg;
+  if (fakeDnsAnswer == ERR_OK)
+    address->addr = fakeDnsAddress;
+  return fakeDnsAnswer;
+}
+
+#endif
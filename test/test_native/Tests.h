@@ -0,0 +1,61 @@
+/*  Native unit tests
+    Each file holds the tests of one module and a run function that main.cpp calls. Build and run with
+    pio test -e native
+*/
+#ifndef TESTS_H
+#define TESTS_H
+
+#include <stdint.h>
+#include <math.h>
+
+void runBinHistoryTests();
+void runPulseQueueTests();
+void runAdaptiveWindowTests();
+void runDeadTimeTests();
+void runTimeToCountTests();
+void runLogCodecTests();
+void runDoseMathTests();
+void runMeasurementCoreTests();
+void runSettingsTests();
+void runBulkUploadTests();
+void runSchedulerTests();
+void runFlashLogTests();
+void runOutboxTests();
+void runHttpUploaderTests();
+void runWifiLinkTests();
+void runTouchInputTests();
+void runProfilerTests();
+
+// xorshift64*, the same sequence on every machine so a failing case can be replayed
+class TestRandom
+{
+public:
+  explicit TestRandom(uint64_t seed) : state(seed * 2685821657736338717ULL + 1) {}
+
+  double uniform() // (0, 1)
+  {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return ((state * 2685821657736338717ULL >> 11) + 0.5) / 9007199254740992.0;
+  }
+
+  double exponential(double mean) { return -mean * log(uniform()); }
+
+  uint32_t poisson(double mean) // counts in one bin, by multiplying uniforms, fine for the small means used here
+  {
+    double limit = exp(-mean), product = uniform();
+    uint32_t n = 0;
+    while (product > limit)
+    {
+      product *= uniform();
+      n++;
+    }
+    return n;
+  }
+
+private:
+  uint64_t state;
+};
+
+#endif
@@ -0,0 +1,33 @@
+#include <unity.h>
+#include "Tests.h"
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  runBinHistoryTests();
+  runPulseQueueTests();
+  runAdaptiveWindowTests();
+  runDeadTimeTests();
+  runTimeToCountTests();
+  runLogCodecTests();
+  runDoseMathTests();
+  runMeasurementCoreTests();
+  runSettingsTests();
+  runBulkUploadTests();
+  runSchedulerTests();
+  runFlashLogTests();
+  runOutboxTests();
+  runHttpUploaderTests();
+  runWifiLinkTests();
+  runTouchInputTests();
+  runProfilerTests();
+  return UNITY_END();
+}
@@ -0,0 +1,85 @@
+#include <unity.h>
+#include "Tests.h"
+#include "AdaptiveWindow.h"
+
+static BinHistory history;
+static AdaptiveWindow window;
+
+static void start()
+{
+  history.reset();
+  window.reset();
+}
+
+static uint16_t feed(TestRandom &random, double cps, uint16_t seconds) // bins until the first detection, 0 if none
+{
+  uint16_t detectedAfter = 0;
+  for (uint16_t s = 1; s <= seconds; s++)
+  {
+    history.add(random.poisson(cps));
+    window.update(history);
+    if (window.changeDetected() && detectedAfter == 0)
+      detectedAfter = s;
+  }
+  return detectedAfter;
+}
+
+static void testWidensWhileStable()
+{
+  start();
+  TestRandom random(1);
+  TEST_ASSERT_EQUAL_UINT16(ADAPTIVE_MIN_SECONDS, window.seconds());
+  TEST_ASSERT_EQUAL_UINT16(0, feed(random, 0.5, 600)); // 10 minutes of background, no false alarm
+  TEST_ASSERT_EQUAL_UINT16(ADAPTIVE_MAX_SECONDS, window.seconds());
+}
+
+static void testFollowsStepUp()
+{
+  start();
+  TestRandom random(2);
+  feed(random, 0.5, 300);
+  uint16_t after = feed(random, 20, 60);
+  TEST_ASSERT_GREATER_THAN(0, after);
+  TEST_ASSERT_LESS_OR_EQUAL(5, after);
+  // the window was cut back to the bins since the change and has been growing again since
+  TEST_ASSERT_LESS_OR_EQUAL(60 + ADAPTIVE_MIN_SECONDS, window.seconds());
+  uint32_t cpm = history.cpm(window.seconds());
+  TEST_ASSERT_UINT32_WITHIN(200, 1200, cpm);
+}
+
+static void testFollowsStepDown()
+{
+  start();
+  TestRandom random(3);
+  feed(random, 20, 300);
+  uint16_t after = feed(random, 2, 60);
+  TEST_ASSERT_GREATER_THAN(0, after);
+  TEST_ASSERT_LESS_OR_EQUAL(10, after);
+  TEST_ASSERT_UINT32_WITHIN(40, 120, history.cpm(window.seconds()));
+}
+
+static void testIgnoresSmallChange()
+{
+  start();
+  TestRandom random(4);
+  feed(random, 10, 300);
+  TEST_ASSERT_EQUAL_UINT16(0, feed(random, 11, 120)); // 10 %, well inside what the test is tuned to ignore
+  TEST_ASSERT_EQUAL_UINT16(ADAPTIVE_MAX_SECONDS, window.seconds());
+}
+
+static void testEmptyWindow()
+{
+  start();
+  TestRandom random(5);
+  TEST_ASSERT_EQUAL_UINT16(0, feed(random, 0, 300)); // no counts at all stays defined
+  TEST_ASSERT_EQUAL_UINT16(ADAPTIVE_MAX_SECONDS, window.seconds());
+}
+
+void runAdaptiveWindowTests()
+{
+  RUN_TEST(testWidensWhileStable);
+  RUN_TEST(testFollowsStepUp);
+  RUN_TEST(testFollowsStepDown);
+  RUN_TEST(testIgnoresSmallChange);
+  RUN_TEST(testEmptyWindow);
+}
@@ -0,0 +1,79 @@
+#include <unity.h>
+#include "Tests.h"
+#include "BinHistory.h"
+
+static BinHistory history; // 14 kB, kept off the stack
+
+static void testWindows()
+{
+  history.reset();
+  for (uint32_t i = 1; i <= 100; i++)
+    history.add(i); // bin i holds i counts
+
+  TEST_ASSERT_EQUAL_UINT32(100, history.sum(1));
+  TEST_ASSERT_EQUAL_UINT32(100 + 99 + 98 + 97 + 96, history.sum(5));
+  TEST_ASSERT_EQUAL_UINT32(5050, history.sum(100));
+  TEST_ASSERT_EQUAL_UINT32((100 + 99 + 98 + 97 + 96) * 60 / 5, history.cpm(5));
+  TEST_ASSERT_EQUAL_UINT32(100, history.bin(0));
+  TEST_ASSERT_EQUAL_UINT32(61, history.bin(39));
+  TEST_ASSERT_EQUAL_UINT32(1, history.bin(99));
+}
+
+static void testWrapAround()
+{
+  history.reset();
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < 3 * BIN_HISTORY_SECONDS + 17; i++)
+  {
+    history.add(i % 7);
+    total += i % 7;
+  }
+  uint32_t last = 3 * BIN_HISTORY_SECONDS + 16;
+
+  TEST_ASSERT_EQUAL_UINT16(BIN_HISTORY_SECONDS, history.filled());
+  for (uint16_t age = 0; age < BIN_HISTORY_SECONDS; age += 97)
+    TEST_ASSERT_EQUAL_UINT32((last - age) % 7, history.bin(age));
+  uint32_t expected = 0;
+  for (uint32_t i = last + 1 - BIN_HISTORY_SECONDS; i <= last; i++)
+    expected += i % 7;
+  TEST_ASSERT_EQUAL_UINT32(expected, history.sum(BIN_HISTORY_SECONDS));
+  TEST_ASSERT_EQUAL_UINT32(expected, history.sum(BIN_HISTORY_SECONDS + 100)); // clamped
+  TEST_ASSERT_EQUAL_UINT32(0, history.bin(BIN_HISTORY_SECONDS));
+}
+
+static void testRunningTotalOverflow()
+{
+  // the totals wrap past 2^32 long before an hour of saturated counting ends, differences stay exact
+  history.reset();
+  for (uint32_t i = 0; i < BIN_HISTORY_SECONDS + 10; i++)
+    history.add(3000000);
+  TEST_ASSERT_EQUAL_UINT32(3000000, history.bin(0));
+  TEST_ASSERT_EQUAL_UINT32(1000 * 3000000u, history.sum(1000));
+  TEST_ASSERT_EQUAL_UINT32(3000000u * 60, history.cpm(1000));
+}
+
+static void testWarmUp()
+{
+  history.reset();
+  TEST_ASSERT_EQUAL_UINT32(0, history.cpm(60));
+  TEST_ASSERT_EQUAL_UINT32(0, history.bin(0));
+
+  for (uint8_t i = 0; i < 10; i++)
+    history.add(2);
+  TEST_ASSERT_EQUAL_UINT16(10, history.filled());
+  TEST_ASSERT_EQUAL_UINT32(20, history.sum(60));
+  TEST_ASSERT_EQUAL_UINT32(120, history.cpm(60)); // averaged over the 10 s collected, not read low
+  TEST_ASSERT_EQUAL_UINT32(0, history.bin(10));
+
+  history.reset();
+  TEST_ASSERT_EQUAL_UINT16(0, history.filled());
+  TEST_ASSERT_EQUAL_UINT32(0, history.sum(60));
+}
+
+void runBinHistoryTests()
+{
+  RUN_TEST(testWindows);
+  RUN_TEST(testWrapAround);
+  RUN_TEST(testRunningTotalOverflow);
+  RUN_TEST(testWarmUp);
+}
@@ -0,0 +1,179 @@
+#include <unity.h>
+#include "Tests.h"
+#include <BulkUpload.h>
+
+#define NOW 1800000000 // 2027-01-15 08:00:00 UTC
+
+static void logBoot(uint16_t count, uint32_t cpm, uint32_t start) // one power-on, start 0 if it never had the clock
+{
+  FlashLog log;
+  log.begin();
+  if (start)
+    log.setBootStart(start);
+  for (uint16_t i = 0; i < count; i++)
+    log.append(60 * (i + 1), cpm + i);
+  log.flush();
+}
+
+static uint32_t uploadAll(FlashLog &log, uint32_t &relative) // batches as uploadLogs() sends them, all accepted
+{
+  uint32_t sent = 0;
+  relative = 0;
+  while (log.pending())
+  {
+    StringPrint out;
+    BulkBatch batch = writeBulkJson(out, log, "KEY", log.sent(), 60);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, batch.entries);
+    log.markSent(batch.end);
+    sent += batch.entries;
+    if (batch.relative)
+      relative += batch.entries;
+  }
+  return sent;
+}
+
+static void testCreatedAtFromBootStart()
+{
+  fakeFiles.clear();
+  logBoot(3, 10, 0); // in the field, no clock
+  logBoot(2, 20, NOW - 200);
+  FlashLog log;
+  log.begin();
+  log.setBootStart(NOW - 330);
+  for (uint16_t i = 0; i < 5; i++)
+    log.append(60 * (i + 1), 30 + i);
+  log.flush();
+
+  StringPrint out;
+  BulkBatch batch = writeBulkJson(out, log, "KEY", log.sent(), 60);
+  TEST_ASSERT_TRUE(batch.relative);
+  TEST_ASSERT_EQUAL_UINT16(3, batch.entries);
+  TEST_ASSERT_EQUAL_UINT32(3, batch.end); // ends before the next boot
+  TEST_ASSERT_EQUAL_STRING("{\"write_api_key\":\"KEY\",\"updates\":["
+                           "{\"delta_t\":60,\"field1\":10},{\"delta_t\":60,\"field1\":11},{\"delta_t\":60,\"field1\":12}]}",
+                           out.text.c_str());
+
+  StringPrint dated;
+  batch = writeBulkJson(dated, log, "KEY", batch.end, 60);
+  TEST_ASSERT_FALSE(batch.relative);
+  TEST_ASSERT_EQUAL_UINT16(7, batch.entries); // boots with a start time share a batch
+  TEST_ASSERT_EQUAL_UINT32(log.end(), batch.end);
+  TEST_ASSERT_EQUAL_STRING("{\"write_api_key\":\"KEY\",\"updates\":["
+                           "{\"created_at\":\"2027-01-15 07:57:40 +0000\",\"field1\":20},"
+                           "{\"created_at\":\"2027-01-15 07:58:40 +0000\",\"field1\":21},"
+                           "{\"created_at\":\"2027-01-15 07:55:30 +0000\",\"field1\":30},"
+                           "{\"created_at\":\"2027-01-15 07:56:30 +0000\",\"field1\":31},"
+                           "{\"created_at\":\"2027-01-15 07:57:30 +0000\",\"field1\":32},"
+                           "{\"created_at\":\"2027-01-15 07:58:30 +0000\",\"field1\":33},"
+                           "{\"created_at\":\"2027-01-15 07:59:30 +0000\",\"field1\":34}]}",
+                           dated.text.c_str());
+}
+
+static void testEarlierBootsSurvive()
+{
+  fakeFiles.clear();
+  logBoot(1000, 10, 0); // logged in the field over several power-ons, more than one batch
+  logBoot(50, 10, 0);
+  FlashLog log;
+  log.begin();
+  log.setBootStart(NOW);
+  log.append(60, 40);
+  log.flush();
+  TEST_ASSERT_EQUAL_UINT32(1051, log.pending());
+
+  StringPrint out;
+  writeBulkJson(out, log, "KEY", log.sent(), 60); // a pass that was not accepted
+  TEST_ASSERT_EQUAL_UINT32(1051, log.pending());
+
+  uint32_t relative;
+  TEST_ASSERT_EQUAL_UINT32(1051, uploadAll(log, relative));
+  TEST_ASSERT_EQUAL_UINT32(1050, relative);
+  TEST_ASSERT_EQUAL_UINT32(0, log.pending());
+}
+
+static void testStartOfEmptyBootNotReused()
+{
+  fakeFiles.clear();
+  logBoot(10, 10, 0);
+  logBoot(0, 0, NOW - 1000); // had the clock but logged nothing, the next power-on gets the same number
+  FlashLog log;
+  log.begin();
+  TEST_ASSERT_EQUAL_UINT32(0, log.bootStart(log.currentBoot()));
+  log.append(60, 40);
+  log.flush();
+  uint32_t relative;
+  TEST_ASSERT_EQUAL_UINT32(11, uploadAll(log, relative));
+  TEST_ASSERT_EQUAL_UINT32(11, relative);
+}
+
+static void testPassesAgree()
+{
+  fakeFiles.clear();
+  FlashLog log;
+  log.begin();
+  log.setBootStart(NOW - 72000);
+  for (uint16_t i = 0; i < 1200; i++)
+    log.append(60 * (i + 1), 18 + i % 5);
+  log.flush();
+
+  CountingPrint length;
+  BulkBatch counted = writeBulkJson(length, log, "KEY", log.sent(), 60);
+  StringPrint out;
+  BufferedPrint body(out);
+  BulkBatch streamed = writeBulkJson(body, log, "KEY", log.sent(), 60);
+  TEST_ASSERT_TRUE(body.send());
+  TEST_ASSERT_EQUAL_UINT16(BULK_MAX_ENTRIES, counted.entries);
+  TEST_ASSERT_EQUAL_UINT32(BULK_MAX_ENTRIES, counted.end);
+  TEST_ASSERT_EQUAL_UINT32(counted.end, streamed.end);
+  TEST_ASSERT_EQUAL_UINT32(length.count, out.text.size());
+  TEST_ASSERT_EQUAL_UINT32(length.count, body.total());
+
+  log.markSent(counted.end);
+  BulkBatch rest = writeBulkJson(length, log, "KEY", log.sent(), 60);
+  TEST_ASSERT_EQUAL_UINT16(1200 - BULK_MAX_ENTRIES, rest.entries);
+  TEST_ASSERT_EQUAL_UINT32(1200, rest.end);
+}
+
+static void testOutboxJson()
+{
+  OutboxEntry entries[3] = {};
+  entries[0].time = NOW - 300;
+  entries[0].value = 25;
+  entries[2].time = NOW; // entries[1] has no time and is left out
+  entries[2].value = 26;
+  char out[200];
+  uint16_t used;
+  size_t length = writeOutboxJson(out, sizeof(out), "KEY", "field2", entries, 3, used);
+  TEST_ASSERT_EQUAL_UINT16(3, used);
+  TEST_ASSERT_EQUAL_STRING("{\"write_api_key\":\"KEY\",\"updates\":["
+                           "{\"created_at\":\"2027-01-15 07:55:00 +0000\",\"field2\":25},"
+                           "{\"created_at\":\"2027-01-15 08:00:00 +0000\",\"field2\":26}]}",
+                           out);
+  TEST_ASSERT_EQUAL_UINT32(strlen(out), length);
+
+  length = writeOutboxJson(out, 100, "KEY", "field2", entries, 3, used); // room for one
+  TEST_ASSERT_EQUAL_UINT16(2, used); // the undated entry is covered too, it can go with this request
+  TEST_ASSERT_EQUAL_UINT32(strlen(out), length);
+}
+
+static void testHttpStatus()
+{
+  Stream accepted("HTTP/1.1 202 Accepted\r\nContent-Length: 2\r\n\r\n{}");
+  TEST_ASSERT_EQUAL_INT(202, readHttpStatus(accepted));
+  Stream limited("HTTP/1.0 429 Too Many Requests\r\n");
+  TEST_ASSERT_EQUAL_INT(429, readHttpStatus(limited));
+  Stream silent;
+  TEST_ASSERT_EQUAL_INT(0, readHttpStatus(silent));
+  Stream garbage("hello\r\n");
+  TEST_ASSERT_EQUAL_INT(0, readHttpStatus(garbage));
+}
+
+void runBulkUploadTests()
+{
+  RUN_TEST(testCreatedAtFromBootStart);
+  RUN_TEST(testEarlierBootsSurvive);
+  RUN_TEST(testStartOfEmptyBootNotReused);
+  RUN_TEST(testPassesAgree);
+  RUN_TEST(testOutboxJson);
+  RUN_TEST(testHttpStatus);
+}
@@ -0,0 +1,104 @@
+#include <unity.h>
+#include "Tests.h"
+#include "DeadTime.h"
+
+#define CYCLES_PER_MICRO 160
+
+static DeadTime deadTime;
+
+// pulses as a non-paralyzable tube with the given dead time records them, on the cycle counter
+static void simulate(TestRandom &random, double cps, double tauMicros, uint32_t pulses, uint32_t start)
+{
+  double t = start / double(CYCLES_PER_MICRO); // us
+  for (uint32_t i = 0; i < pulses; i++)
+  {
+    deadTime.addPulse((uint32_t)(uint64_t)(t * CYCLES_PER_MICRO));
+    t += tauMicros + random.exponential(1e6 / cps);
+  }
+}
+
+static void testFitsSimulatedDeadTime()
+{
+  const double taus[] = {60, 150, 200, 420};
+  for (double tau : taus)
+  {
+    deadTime = DeadTime();
+    deadTime.begin(CYCLES_PER_MICRO);
+    TestRandom random((uint64_t)tau);
+    simulate(random, 1500, tau, 20000, 0xFFF00000u); // starts just before the cycle counter wraps
+    TEST_ASSERT_TRUE(deadTime.fit());
+    TEST_ASSERT_TRUE(deadTime.fitted());
+    TEST_ASSERT_FLOAT_WITHIN(DEAD_TIME_BIN_MICROS / 2.0, tau, deadTime.deadTimeMicros());
+    TEST_ASSERT_UINT32_WITHIN(DEAD_TIME_BIN_MICROS * 500, (uint32_t)(tau * 1000), deadTime.deadTimeNanos());
+  }
+}
+
+static void testNeedsEnoughSamples()
+{
+  deadTime = DeadTime();
+  deadTime.begin(CYCLES_PER_MICRO);
+  TestRandom random(7);
+  simulate(random, 1500, 150, DEAD_TIME_MIN_SAMPLES / 2, 0);
+  TEST_ASSERT_FALSE(deadTime.fit());
+  TEST_ASSERT_FALSE(deadTime.fitted());
+  TEST_ASSERT_EQUAL_UINT32(DEAD_TIME_DEFAULT_MICROS * 1000, deadTime.deadTimeNanos());
+}
+
+static void testResyncSkipsGap()
+{
+  deadTime = DeadTime();
+  deadTime.begin(CYCLES_PER_MICRO);
+  deadTime.addPulse(0);
+  deadTime.addPulse(100 * CYCLES_PER_MICRO);
+  TEST_ASSERT_EQUAL_UINT32(1, deadTime.samples());
+  deadTime.resync(); // timestamps were dropped, 50 us would not be a real interval
+  deadTime.addPulse(150 * CYCLES_PER_MICRO);
+  TEST_ASSERT_EQUAL_UINT32(1, deadTime.samples());
+  TEST_ASSERT_EQUAL_UINT32(0, deadTime.bin(5));
+}
+
+static void testRebaseKeepsInterval()
+{
+  deadTime = DeadTime();
+  deadTime.begin(CYCLES_PER_MICRO);
+  deadTime.addPulse(1000 * CYCLES_PER_MICRO);
+  // clock drops to 80 MHz at 1100 us, counter reads 5000 after the switch. Next pulse 200 us after the first
+  deadTime.rebase(1100 * CYCLES_PER_MICRO, 5000, 80);
+  deadTime.addPulse(5000 + 100 * 80);
+  TEST_ASSERT_EQUAL_UINT32(1, deadTime.bin(200 / DEAD_TIME_BIN_MICROS));
+}
+
+static void testRestoreBounds()
+{
+  deadTime = DeadTime();
+  deadTime.restore(185000);
+  TEST_ASSERT_EQUAL_UINT32(185000, deadTime.deadTimeNanos());
+  deadTime.restore(5);       // not a value fit() can produce
+  deadTime.restore(5000000);
+  TEST_ASSERT_EQUAL_UINT32(185000, deadTime.deadTimeNanos());
+}
+
+static void testSaturationHysteresis()
+{
+  deadTime = DeadTime();
+  deadTime.restore(200000);
+  // 1 / (e tau) is about 110 kCPM at 200 us
+  deadTime.updateSaturation(50000);
+  TEST_ASSERT_FALSE(deadTime.saturated());
+  deadTime.updateSaturation(100000);
+  TEST_ASSERT_TRUE(deadTime.saturated());
+  deadTime.updateSaturation(50000); // still above the exit level
+  TEST_ASSERT_TRUE(deadTime.saturated());
+  deadTime.updateSaturation(30000);
+  TEST_ASSERT_FALSE(deadTime.saturated());
+}
+
+void runDeadTimeTests()
+{
+  RUN_TEST(testFitsSimulatedDeadTime);
+  RUN_TEST(testNeedsEnoughSamples);
+  RUN_TEST(testResyncSkipsGap);
+  RUN_TEST(testRebaseKeepsInterval);
+  RUN_TEST(testRestoreBounds);
+  RUN_TEST(testSaturationHysteresis);
+}
@@ -0,0 +1,185 @@
+#include <unity.h>
+#include "Tests.h"
+#include "DoseMath.h"
+#include <stdio.h>
+
+static const uint32_t deadTimes[] = {0, 50000, 100000, 200000, 420000}; // ns
+static const uint32_t factors[] = {1, 100, 153, 175, 570, 1000, 8000};
+
+static double nonParalyzable(double cpm, double tauNanos)
+{
+  double busy = cpm * tauNanos / 6e10;
+  if (busy > 0.99)
+    busy = 0.99;
+  return cpm / (1 - busy);
+}
+
+static double paralyzable(double cpm, double tauNanos) // lower root of n exp(-n tau) = m, by bisection
+{
+  double y = cpm * tauNanos / 6e10;
+  if (tauNanos == 0)
+    return cpm;
+  if (y >= 0.368)
+    return 6e10 / tauNanos;
+  double low = 0, high = 1;
+  for (int i = 0; i < 100; i++)
+  {
+    double mid = (low + high) / 2;
+    if (mid * exp(-mid) < y)
+      low = mid;
+    else
+      high = mid;
+  }
+  return low * 6e10 / tauNanos;
+}
+
+// CPM from 0 up past saturation, about 40 points a decade
+template <typename F> static void sweepCpm(F check)
+{
+  check(0);
+  for (double cpm = 1; cpm < 4e7; cpm *= 1.06)
+    check((uint32_t)cpm);
+}
+
+static void testNonParalyzable()
+{
+  for (uint32_t tau : deadTimes)
+  {
+    sweepCpm([&](uint32_t cpm) {
+      double expected = nonParalyzable(cpm, tau);
+      TEST_ASSERT_FLOAT_WITHIN(0.5 + expected * 1e-9, expected, correctNonParalyzable(cpm, tau));
+    });
+  }
+}
+
+static void testParalyzable()
+{
+  for (uint32_t tau : deadTimes)
+  {
+    sweepCpm([&](uint32_t cpm) {
+      double expected = paralyzable(cpm, tau);
+      TEST_ASSERT_FLOAT_WITHIN(1, expected, correctParalyzable(cpm, tau)); // Q28 Newton solution, within a count right up to the peak
+    });
+  }
+}
+
+static void testCorrectionIsMonotonic()
+{
+  for (uint32_t tau : deadTimes)
+  {
+    uint32_t previousNp = 0, previousP = 0;
+    sweepCpm([&](uint32_t cpm) {
+      uint32_t np = correctNonParalyzable(cpm, tau);
+      uint32_t p = correctParalyzable(cpm, tau);
+      TEST_ASSERT_GREATER_OR_EQUAL(previousNp, np);
+      TEST_ASSERT_GREATER_OR_EQUAL(previousP, p);
+      TEST_ASSERT_GREATER_OR_EQUAL(cpm, np);
+      previousNp = np;
+      previousP = p;
+    });
+  }
+}
+
+static void testDoseRate()
+{
+  for (uint32_t factor : factors)
+  {
+    for (uint8_t units = 0; units < 2; units++)
+    {
+      sweepCpm([&](uint32_t cpm) {
+        double expected = cpm * 1000.0 / factor / (units ? 10 : 1); // thousandths of uSv/hr or mR/hr
+        if (expected > 4e9)
+          return;
+        TEST_ASSERT_FLOAT_WITHIN(0.5 + 1e-9 * expected, expected, doseRateMilli(cpm, factor, units));
+      });
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, doseRateMilli(1000, 0, false)); // unset factor
+}
+
+static void testTotalDose()
+{
+  for (uint32_t factor : factors)
+  {
+    for (uint8_t units = 0; units < 2; units++)
+    {
+      for (double c = 0; c < 4e9; c = c * 1.1 + 1)
+      {
+        uint32_t count = (uint32_t)c;
+        double expected = count * 1000.0 / (60.0 * factor) / (units ? 10 : 1);
+        if (expected > 4e9)
+          break;
+        TEST_ASSERT_FLOAT_WITHIN(0.5 + 1e-9 * expected, expected, totalDoseMilli(count, factor, units));
+      }
+    }
+  }
+}
+
+static void testPipeline()
+{
+  // observed CPM to displayed dose rate against the same chain in doubles, both unit systems
+  for (uint32_t factor : factors)
+  {
+    for (uint8_t units = 0; units < 2; units++)
+    {
+      sweepCpm([&](uint32_t cpm) {
+        double corrected = nonParalyzable(cpm, 200000);
+        double expected = corrected * 1000.0 / factor / (units ? 10 : 1);
+        if (expected > 4e9)
+          return;
+        uint32_t got = doseRateMilli(correctNonParalyzable(cpm, 200000), factor, units);
+        TEST_ASSERT_FLOAT_WITHIN(1 + 1000.0 / factor + expected * 1e-9, expected, got); // one count of rounding, scaled
+      });
+    }
+  }
+}
+
+static void testFormat()
+{
+  char got[16], expected[16];
+  for (uint8_t decimals = 0; decimals <= 3; decimals++)
+  {
+    double step = pow(10, 3 - decimals);
+    for (double milli = 0; milli < 4e9; milli = milli * 1.03 + 1)
+    {
+      uint32_t m = (uint32_t)milli;
+      double rounded = floor(m / step + 0.5) * step / 1000; // half up, exact to the printed digits
+      snprintf(expected, sizeof(expected), "%*.*f", 6, decimals, rounded);
+      formatMilli(m, decimals, 6, got, sizeof(got));
+      TEST_ASSERT_EQUAL_STRING(expected, got);
+    }
+  }
+  formatMilli(125, 2, 0, got, sizeof(got));
+  TEST_ASSERT_EQUAL_STRING("0.13", got); // half up, where printf would round to even
+  formatMilli(123456, 2, 4, got, 5);
+  TEST_ASSERT_EQUAL_STRING("123.", got); // cut at the buffer, always terminated
+}
+
+static void testFormatDoseRate()
+{
+  char out[8];
+  formatDoseRate(9994, out, sizeof(out));
+  TEST_ASSERT_EQUAL_STRING("9.99", out);
+  formatDoseRate(9999, out, sizeof(out));
+  TEST_ASSERT_EQUAL_STRING("10.00", out);
+  formatDoseRate(10000, out, sizeof(out));
+  TEST_ASSERT_EQUAL_STRING("10.0", out);
+  formatDoseRate(99949, out, sizeof(out));
+  TEST_ASSERT_EQUAL_STRING("99.9", out);
+  formatDoseRate(100000, out, sizeof(out));
+  TEST_ASSERT_EQUAL_STRING(" 100", out);
+  formatDoseRate(120, out, sizeof(out));
+  TEST_ASSERT_EQUAL_STRING("0.12", out);
+}
+
+void runDoseMathTests()
+{
+  RUN_TEST(testNonParalyzable);
+  RUN_TEST(testParalyzable);
+  RUN_TEST(testCorrectionIsMonotonic);
+  RUN_TEST(testDoseRate);
+  RUN_TEST(testTotalDose);
+  RUN_TEST(testPipeline);
+  RUN_TEST(testFormat);
+  RUN_TEST(testFormatDoseRate);
+}
@@ -0,0 +1,127 @@
+#include <unity.h>
+#include "Tests.h"
+#include <FlashLog.h>
+
+#define RING_ENTRIES 300000 // more than the segments hold, the ring wraps
+
+static void fillLog(uint32_t count)
+{
+  fakeFiles.clear();
+  FlashLog log;
+  log.begin();
+  for (uint32_t i = 0; i < count; i++)
+    log.append(i * 60, i);
+  log.flush();
+}
+
+static uint32_t readAll(FlashLog &log, uint32_t from, uint32_t &first, uint32_t &last) // checks the order, returns the count
+{
+  FlashLogReader reader(log, from);
+  LogEntry entry;
+  uint32_t count = 0;
+  while (reader.next(entry))
+  {
+    if (count)
+      TEST_ASSERT_GREATER_THAN_UINT32(last, entry.seq);
+    else
+      first = entry.seq;
+    TEST_ASSERT_EQUAL_UINT32(entry.seq, entry.cpm);
+    TEST_ASSERT_EQUAL_UINT32(entry.seq * 60, entry.seconds);
+    last = entry.seq;
+    count++;
+  }
+  return count;
+}
+
+static void testRingWraps()
+{
+  fillLog(RING_ENTRIES);
+  FlashLog log;
+  log.begin();
+  TEST_ASSERT_EQUAL_UINT32(RING_ENTRIES, log.end());
+  TEST_ASSERT_GREATER_THAN_UINT32(0, log.oldest()); // the first segments were reused
+  TEST_ASSERT_EQUAL_UINT32(RING_ENTRIES - log.oldest(), log.pending());
+  for (uint8_t s = 0; s < FLASH_LOG_SEGMENTS; s++)
+  {
+    char path[16];
+    snprintf(path, sizeof(path), "/log/seg%u", s);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(FLASH_LOG_SEGMENT_BYTES, fakeFiles[path]->size());
+  }
+
+  uint32_t first, last;
+  TEST_ASSERT_EQUAL_UINT32(RING_ENTRIES - log.oldest(), readAll(log, 0, first, last));
+  TEST_ASSERT_EQUAL_UINT32(log.oldest(), first);
+  TEST_ASSERT_EQUAL_UINT32(RING_ENTRIES - 1, last);
+  TEST_ASSERT_EQUAL_UINT32(10, readAll(log, RING_ENTRIES - 10, first, last));
+  TEST_ASSERT_EQUAL_UINT32(RING_ENTRIES - 10, first);
+}
+
+static void testReopenKeepsPlace()
+{
+  fillLog(1000);
+  {
+    FlashLog log;
+    log.begin();
+    log.markSent(990);
+    log.append(1000 * 60, 1000);
+    log.append(1001 * 60, 1001);
+    log.flush(); // a partial block
+  }
+  FlashLog log;
+  log.begin();
+  TEST_ASSERT_EQUAL_UINT32(1002, log.end());
+  TEST_ASSERT_EQUAL_UINT32(990, log.sent());
+  TEST_ASSERT_EQUAL_UINT32(12, log.pending());
+  TEST_ASSERT_EQUAL_UINT16(2, log.currentBoot()); // the fill, the appends, now
+
+  FlashLogReader reader(log, log.sent());
+  LogEntry entry;
+  uint32_t seq = 990;
+  while (reader.next(entry))
+  {
+    TEST_ASSERT_EQUAL_UINT32(seq, entry.seq);
+    TEST_ASSERT_EQUAL_UINT16(seq < 1000 ? 0 : 1, entry.boot);
+    seq++;
+  }
+  TEST_ASSERT_EQUAL_UINT32(1002, seq);
+}
+
+static void testBadBlockSkipped()
+{
+  fillLog(5000);
+  (*fakeFiles["/log/seg0"])[200] ^= 0xFF; // inside the second or third block
+  FlashLog log;
+  log.begin();
+  uint32_t first, last;
+  uint32_t count = readAll(log, 0, first, last);
+  TEST_ASSERT_EQUAL_UINT32(0, first);
+  TEST_ASSERT_EQUAL_UINT32(4999, last);
+  TEST_ASSERT_LESS_THAN_UINT32(5000, count);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(5000 - LOG_BLOCK_RECORDS, count); // one block lost, not the rest of the segment
+}
+
+static void testTornTailCut()
+{
+  fillLog(100);
+  FakeFile &segment = *fakeFiles["/log/seg0"];
+  size_t good = segment.size();
+  segment.insert(segment.end(), {0x12, 0x34, 0x56}); // power cut in the middle of a header
+  FlashLog log;
+  log.begin();
+  TEST_ASSERT_EQUAL_UINT32(good, segment.size());
+  TEST_ASSERT_EQUAL_UINT32(100, log.end());
+  log.append(100 * 60, 100);
+  log.flush();
+
+  uint32_t first, last;
+  TEST_ASSERT_EQUAL_UINT32(101, readAll(log, 0, first, last));
+  TEST_ASSERT_EQUAL_UINT32(100, last);
+}
+
+void runFlashLogTests()
+{
+  RUN_TEST(testRingWraps);
+  RUN_TEST(testReopenKeepsPlace);
+  RUN_TEST(testBadBlockSkipped);
+  RUN_TEST(testTornTailCut);
+}
@@ -0,0 +1,151 @@
+#include <unity.h>
+#include "Tests.h"
+#include <HttpUploader.h>
+
+static void poll(HttpUploader &uploader, uint32_t steps) // 10 ms apart, as loop() passes millis()
+{
+  for (uint32_t i = 0; i < steps; i++)
+  {
+    fakeMillis += 10;
+    uploader.poll(fakeMillis);
+  }
+}
+
+static void startConnected(HttpUploader &uploader, const char *request) // up to waiting for the status line
+{
+  fakeDnsAnswer = ERR_OK;
+  TEST_ASSERT_TRUE(uploader.start("192.168.1.2", 8080, request, strlen(request)));
+  poll(uploader, 1);
+  fakeClient->fakeConnect();
+  poll(uploader, 2);
+  TEST_ASSERT_EQUAL_INT(HTTP_AWAIT, uploader.current());
+}
+
+static void testRequest()
+{
+  fakeDnsAnswer = ERR_INPROGRESS;
+  std::string request(250, 'x');
+  HttpUploader uploader;
+  TEST_ASSERT_TRUE(uploader.start("api.example.com", 80, request.c_str(), request.size()));
+  TEST_ASSERT_TRUE(uploader.busy());
+  TEST_ASSERT_NULL(uploader.buffer());
+  TEST_ASSERT_FALSE(uploader.start("api.example.com", 80, "x", 1));
+  poll(uploader, 3);
+  TEST_ASSERT_EQUAL_INT(HTTP_RESOLVE, uploader.current());
+
+  ip_addr_t address = {0x0201a8c0};
+  fakeDnsCallback("api.example.com", &address, fakeDnsArg);
+  poll(uploader, 1);
+  TEST_ASSERT_EQUAL_INT(HTTP_CONNECT, uploader.current());
+  fakeClient->fakeConnect();
+  poll(uploader, 1);
+  TEST_ASSERT_EQUAL_INT(HTTP_SEND, uploader.current());
+  poll(uploader, 2);
+  TEST_ASSERT_EQUAL_UINT32(200, fakeClient->written.size()); // no more than space() at a time
+  poll(uploader, 1);
+  TEST_ASSERT_EQUAL_INT(HTTP_AWAIT, uploader.current());
+  TEST_ASSERT_TRUE(fakeClient->written == request);
+
+  const char *response = "HTTP/1.1 202 Accepted\r\nContent-Type: application/json\r\n\r\n{}";
+  fakeClient->fakeReceive(response, 7); // the status line split over two segments
+  poll(uploader, 1);
+  TEST_ASSERT_EQUAL_INT(HTTP_AWAIT, uploader.current());
+  fakeClient->fakeReceive(response + 7, strlen(response) - 7);
+  poll(uploader, 2);
+  TEST_ASSERT_TRUE(uploader.done());
+  TEST_ASSERT_EQUAL_INT(202, uploader.result());
+  TEST_ASSERT_EQUAL_INT(HTTP_IDLE, uploader.current());
+  TEST_ASSERT_NOT_NULL(uploader.buffer());
+}
+
+static void testDnsFailures()
+{
+  fakeDnsAnswer = ERR_INPROGRESS;
+  HttpUploader uploader;
+  uploader.start("api.example.com", 80, "x", 1);
+  poll(uploader, HTTP_RESOLVE_MILLIS / 10 + 1);
+  TEST_ASSERT_EQUAL_INT(HTTP_ERROR_DNS, uploader.result());
+
+  // the late answer to the lookup that timed out must not be taken for the next one
+  dns_found_callback late = fakeDnsCallback;
+  void *lateArg = fakeDnsArg;
+  uploader.start("other.example.com", 80, "x", 1);
+  ip_addr_t address = {0x0201a8c0};
+  late("api.example.com", &address, lateArg);
+  poll(uploader, 1);
+  TEST_ASSERT_EQUAL_INT(HTTP_RESOLVE, uploader.current());
+  fakeDnsCallback("other.example.com", NULL, fakeDnsArg); // not found
+  poll(uploader, 1);
+  TEST_ASSERT_EQUAL_INT(HTTP_ERROR_DNS, uploader.result());
+
+  fakeDnsAnswer = ERR_ARG;
+  uploader.start("", 80, "x", 1);
+  poll(uploader, 1);
+  TEST_ASSERT_EQUAL_INT(HTTP_ERROR_DNS, uploader.result());
+}
+
+static void testConnectFailures()
+{
+  fakeDnsAnswer = ERR_OK;
+  HttpUploader uploader;
+  uploader.start("192.168.1.2", 80, "x", 1);
+  poll(uploader, 1);
+  TEST_ASSERT_EQUAL_INT(HTTP_CONNECT, uploader.current());
+  poll(uploader, HTTP_CONNECT_MILLIS / 10 + 1);
+  TEST_ASSERT_EQUAL_INT(HTTP_ERROR_CONNECT, uploader.result());
+
+  uploader.start("192.168.1.2", 80, "x", 1);
+  poll(uploader, 1);
+  fakeClient->fakeError(-14); // refused
+  poll(uploader, 1);
+  TEST_ASSERT_EQUAL_INT(HTTP_ERROR_CONNECT, uploader.result());
+
+  fakeClient->accepts = false;
+  uploader.start("192.168.1.2", 80, "x", 1);
+  poll(uploader, 1);
+  TEST_ASSERT_EQUAL_INT(HTTP_ERROR_CONNECT, uploader.result());
+}
+
+static void testSendStalls()
+{
+  HttpUploader uploader;
+  fakeDnsAnswer = ERR_OK;
+  uploader.start("192.168.1.2", 80, "x", 1);
+  poll(uploader, 1);
+  fakeClient->room = 0; // the peer stopped reading
+  fakeClient->fakeConnect();
+  poll(uploader, HTTP_SEND_MILLIS / 10 + 2);
+  TEST_ASSERT_EQUAL_INT(HTTP_ERROR_SEND, uploader.result());
+}
+
+static void testResponseFailures()
+{
+  HttpUploader uploader;
+  startConnected(uploader, "x");
+  poll(uploader, HTTP_RESPONSE_MILLIS / 10 + 1);
+  TEST_ASSERT_EQUAL_INT(HTTP_ERROR_TIMEOUT, uploader.result());
+
+  startConnected(uploader, "x");
+  fakeClient->fakeDisconnect();
+  poll(uploader, 1);
+  TEST_ASSERT_EQUAL_INT(HTTP_ERROR_RESPONSE, uploader.result());
+
+  startConnected(uploader, "x");
+  fakeClient->fakeReceive("garbage\n", 8);
+  poll(uploader, 2);
+  TEST_ASSERT_EQUAL_INT(HTTP_ERROR_RESPONSE, uploader.result());
+
+  startConnected(uploader, "x");
+  fakeClient->fakeReceive("HTTP/1.1 429 Too Many Requests\r\n", 32);
+  poll(uploader, 2);
+  TEST_ASSERT_EQUAL_INT(429, uploader.result());
+}
+
+void runHttpUploaderTests()
+{
+  RUN_TEST(testRequest);
+  RUN_TEST(testDnsFailures);
+  RUN_TEST(testConnectFailures);
+  RUN_TEST(testSendStalls);
+  RUN_TEST(testResponseFailures);
+}
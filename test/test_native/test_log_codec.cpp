@@ -0,0 +1,117 @@
+#include <unity.h>
+#include "Tests.h"
+#include "LogBlock.h"
+#include <string.h>
+
+static LogSample samples[1000];
+static uint8_t buffer[1000 * LOG_CODEC_MAX_BYTES];
+
+static void fillTrace(TestRandom &random, uint16_t count)
+{
+  uint32_t seconds = 123456;
+  for (uint16_t i = 0; i < count; i++)
+  {
+    if (i % 97 == 50)
+      seconds += 3600; // logging paused
+    else
+      seconds += random.uniform() < 0.9 ? 60 : 1 + (uint32_t)(random.uniform() * 300);
+    samples[i].seconds = seconds;
+    samples[i].cpm = i % 211 == 0 ? 0xFFFFFFFFu : random.poisson(20);
+  }
+}
+
+static void testRoundTrip()
+{
+  TestRandom random(21);
+  fillTrace(random, 1000);
+  LogEncoder encoder(buffer, sizeof(buffer));
+  for (uint16_t i = 0; i < 1000; i++)
+    TEST_ASSERT_TRUE(encoder.add(samples[i]));
+  TEST_ASSERT_EQUAL_UINT16(1000, encoder.count());
+
+  LogDecoder decoder(buffer, encoder.size());
+  LogSample sample;
+  for (uint16_t i = 0; i < 1000; i++)
+  {
+    TEST_ASSERT_TRUE(decoder.next(sample));
+    TEST_ASSERT_EQUAL_UINT32(samples[i].seconds, sample.seconds);
+    TEST_ASSERT_EQUAL_UINT32(samples[i].cpm, sample.cpm);
+  }
+  TEST_ASSERT_FALSE(decoder.next(sample));
+}
+
+static void testEvenSpacingIsSmall()
+{
+  LogEncoder encoder(buffer, sizeof(buffer));
+  for (uint16_t i = 0; i < 640; i++)
+    encoder.add({60u * i, 20});
+  // 10 keyframes, the rest one byte for the step change and one for the CPM change
+  TEST_ASSERT_LESS_OR_EQUAL(10 * LOG_CODEC_MAX_BYTES + 630 * 2, encoder.size());
+}
+
+static void testFullBufferWritesNothing()
+{
+  uint8_t small[12];
+  LogEncoder encoder(small, sizeof(small));
+  TEST_ASSERT_TRUE(encoder.add({0x7FFFFFFF, 0x7FFFFFFF})); // 10 bytes
+  size_t used = encoder.size();
+  TEST_ASSERT_FALSE(encoder.add({0, 0xFFFFFFFF}));
+  TEST_ASSERT_EQUAL_UINT32(used, encoder.size());
+  TEST_ASSERT_EQUAL_UINT16(1, encoder.count());
+}
+
+static void testTruncatedInput()
+{
+  LogEncoder encoder(buffer, sizeof(buffer));
+  encoder.add({1000000, 300000});
+  LogDecoder decoder(buffer, encoder.size() - 1);
+  LogSample sample;
+  TEST_ASSERT_FALSE(decoder.next(sample));
+}
+
+static void testBlockRoundTripAndCrc()
+{
+  TestRandom random(22);
+  fillTrace(random, LOG_BLOCK_RECORDS);
+  LogBlockHeader header = {};
+  header.count = LOG_BLOCK_RECORDS;
+  header.boot = 7;
+  header.firstSeq = 4242;
+  uint8_t payload[LOG_BLOCK_MAX_PAYLOAD];
+  encodeLogBlock(header, samples, payload);
+
+  TEST_ASSERT_EQUAL_UINT16(header.bytes, logBlockPayload(header));
+  TEST_ASSERT_TRUE(logBlockCrcValid(header, payload));
+  LogSample decoded[LOG_BLOCK_RECORDS];
+  TEST_ASSERT_EQUAL_UINT8(LOG_BLOCK_RECORDS, decodeLogBlock(header, payload, decoded));
+  TEST_ASSERT_EQUAL_MEMORY(samples, decoded, sizeof(decoded));
+
+  payload[3] ^= 0x10;
+  TEST_ASSERT_FALSE(logBlockCrcValid(header, payload));
+  payload[3] ^= 0x10;
+  header.firstSeq++;
+  TEST_ASSERT_FALSE(logBlockCrcValid(header, payload)); // the header is covered too
+}
+
+static void testRawBlock()
+{
+  LogBlockHeader header = {LOG_BLOCK_MAGIC, LOG_BLOCK_RAW, 2, 1, 0, 0, 0};
+  LogSample raw[2] = {{10, 20}, {70, 25}};
+  TEST_ASSERT_EQUAL_UINT16(2 * sizeof(LogSample), logBlockPayload(header));
+  LogSample decoded[LOG_BLOCK_RECORDS];
+  TEST_ASSERT_EQUAL_UINT8(2, decodeLogBlock(header, (const uint8_t *)raw, decoded));
+  TEST_ASSERT_EQUAL_UINT32(70, decoded[1].seconds);
+
+  header.magic = 0xFFFF; // erased flash
+  TEST_ASSERT_EQUAL_UINT16(0, logBlockPayload(header));
+}
+
+void runLogCodecTests()
+{
+  RUN_TEST(testRoundTrip);
+  RUN_TEST(testEvenSpacingIsSmall);
+  RUN_TEST(testFullBufferWritesNothing);
+  RUN_TEST(testTruncatedInput);
+  RUN_TEST(testBlockRoundTripAndCrc);
+  RUN_TEST(testRawBlock);
+}
@@ -0,0 +1,129 @@
+#include <unity.h>
+#include "Tests.h"
+#include "MeasurementCore.h"
+#include <string.h>
+
+class TestClock : public Clock
+{
+public:
+  uint32_t millis() { return now; }
+  uint32_t cyclesPerMicro() { return 1; }
+  uint32_t now = 0;
+};
+
+class TestPulses : public PulseSource
+{
+public:
+  PulseSnapshot snapshot() { return queue.snapshot(); }
+  uint16_t drain(uint32_t *out, uint16_t maxCount) { return queue.drain(out, maxCount); }
+  void boundary(uint32_t &sequence, uint32_t &total)
+  {
+    sequence = boundarySeq;
+    total = boundaryTotal;
+  }
+
+  PulseQueue queue;
+  uint32_t boundarySeq = 0;
+  uint32_t boundaryTotal = 0;
+};
+
+class NoStorage : public Storage
+{
+public:
+  bool load(StorageRecord, void *, size_t) { return false; }
+  void save(StorageRecord, const void *, size_t) {}
+};
+
+class TestDisplay : public DisplaySink
+{
+public:
+  void showReading(const Reading &) {}
+  void report(const char *line)
+  {
+    reports++;
+    strncpy(last, line, sizeof(last) - 1);
+  }
+
+  uint16_t reports = 0;
+  char last[128] = "";
+};
+
+static TestClock clock;
+static TestPulses pulses;
+static NoStorage storage;
+static TestDisplay display;
+static MeasurementCore core;
+
+static void start()
+{
+  clock = TestClock();
+  pulses = TestPulses();
+  display = TestDisplay();
+  core = MeasurementCore();
+  core.begin(clock, pulses, storage, display);
+}
+
+static void testOverflowReportedAfterRebase()
+{
+  start();
+  for (uint32_t i = 1; i <= PULSE_QUEUE_SIZE + 9; i++)
+    pulses.queue.push(i * 1000);
+  core.rebaseClock(1000000, 1000000, 1); // runs with interrupts off on the device, must not print
+  TEST_ASSERT_EQUAL_UINT16(0, display.reports);
+  core.update();
+  TEST_ASSERT_EQUAL_UINT16(1, display.reports);
+  TEST_ASSERT_EQUAL_STRING("Pulse queue overflow: 10", display.last);
+  core.update();
+  TEST_ASSERT_EQUAL_UINT16(1, display.reports); // once
+}
+
+static void testCustomWindowClamped()
+{
+  start();
+  core.integrationMode = 3;
+  core.customWindow = 0;
+  TEST_ASSERT_EQUAL_UINT(CUSTOM_WINDOW_MIN_SECONDS, core.integrationSeconds());
+  core.customWindow = 7200;
+  TEST_ASSERT_EQUAL_UINT(BIN_HISTORY_SECONDS, core.integrationSeconds());
+  core.customWindow = 900;
+  TEST_ASSERT_EQUAL_UINT(900, core.integrationSeconds());
+}
+
+static void testTimeToCountSwitchOnRate()
+{
+  // Poisson pulses at 1000 cps. Above the switch rate the reading comes from the combined blocks and stays there
+  // every second, whether or not a block completed since the last refresh
+  start();
+  core.ttcSwitchCpm = 30000;
+  TestRandom random(31);
+  uint32_t stamp = 0;
+  for (uint32_t second = 1; second <= 120; second++)
+  {
+    for (uint16_t p = 0; p < 1000; p++)
+    {
+      stamp += 1 + (uint32_t)random.exponential(999);
+      pulses.queue.push(stamp);
+      if (p % 250 == 249)
+        core.update(); // drained well before the queue fills
+    }
+    clock.now = second * 1000;
+    pulses.boundaryTotal = pulses.queue.total();
+    pulses.boundarySeq++;
+    core.update();
+    if (second > 60)
+    {
+      TEST_ASSERT_TRUE(core.reading.timeToCount);
+      TEST_ASSERT_UINT32_WITHIN(1500, 60000, core.reading.averageCount); // 0.4 % counting error over 60 s, and the fitted dead time
+    }
+  }
+  core.ttcSwitchCpm = 0; // off
+  core.refresh();
+  TEST_ASSERT_FALSE(core.reading.timeToCount);
+}
+
+void runMeasurementCoreTests()
+{
+  RUN_TEST(testOverflowReportedAfterRebase);
+  RUN_TEST(testCustomWindowClamped);
+  RUN_TEST(testTimeToCountSwitchOnRate);
+}
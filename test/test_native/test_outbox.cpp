@@ -0,0 +1,96 @@
+#include <unity.h>
+#include "Tests.h"
+#include <Outbox.h>
+
+#define OVERFILL 84 // pushed beyond the capacity, the oldest are overwritten
+
+static void fillOutbox()
+{
+  fakeFiles.clear();
+  Outbox outbox;
+  TEST_ASSERT_TRUE(outbox.begin());
+  TEST_ASSERT_EQUAL_UINT32(0, outbox.pending());
+  for (uint32_t i = 0; i < OUTBOX_CAPACITY + OVERFILL; i++)
+    TEST_ASSERT_TRUE(outbox.push(1800000000 + i * 300, i * 300, 1000 + i));
+  TEST_ASSERT_EQUAL_UINT32(OUTBOX_CAPACITY, outbox.pending());
+  TEST_ASSERT_EQUAL_UINT32(OUTBOX_CAPACITY * sizeof(OutboxEntry), fakeFiles["/outbox"]->size());
+}
+
+static void testOverwritesOldest()
+{
+  fillOutbox();
+  Outbox outbox;
+  outbox.begin();
+  TEST_ASSERT_EQUAL_UINT32(OUTBOX_CAPACITY, outbox.pending());
+  OutboxEntry entries[24];
+  TEST_ASSERT_EQUAL_UINT16(24, outbox.read(entries, 24));
+  for (uint16_t i = 0; i < 24; i++)
+  {
+    TEST_ASSERT_EQUAL_UINT32(OVERFILL + 1 + i, entries[i].seq);
+    TEST_ASSERT_EQUAL_UINT32(1000 + OVERFILL + i, entries[i].value);
+  }
+  TEST_ASSERT_FALSE(outbox.thisBoot(entries[0]));
+}
+
+static void testPopPersists()
+{
+  fillOutbox();
+  {
+    Outbox outbox;
+    outbox.begin();
+    outbox.pop(10);
+    TEST_ASSERT_EQUAL_UINT32(OUTBOX_CAPACITY - 10, outbox.pending());
+    TEST_ASSERT_TRUE(outbox.push(0, 5, 7)); // before SNTP
+  }
+  Outbox outbox;
+  outbox.begin();
+  TEST_ASSERT_EQUAL_UINT32(OUTBOX_CAPACITY - 9, outbox.pending());
+  OutboxEntry entry;
+  outbox.read(&entry, 1);
+  TEST_ASSERT_EQUAL_UINT32(1000 + OVERFILL + 10, entry.value);
+
+  outbox.pop(OUTBOX_CAPACITY); // more than pending
+  TEST_ASSERT_EQUAL_UINT32(0, outbox.pending());
+  TEST_ASSERT_EQUAL_UINT16(0, outbox.read(&entry, 1));
+  outbox.push(1800000000, 10, 8);
+  outbox.read(&entry, 1);
+  TEST_ASSERT_TRUE(outbox.thisBoot(entry));
+  TEST_ASSERT_EQUAL_UINT32(8, entry.value);
+}
+
+static void testBadRecord()
+{
+  fillOutbox();
+  uint32_t seq = OVERFILL + 2; // the second pending entry
+  (*fakeFiles["/outbox"])[(seq - 1) % OUTBOX_CAPACITY * sizeof(OutboxEntry) + offsetof(OutboxEntry, value)] ^= 1;
+  Outbox outbox;
+  outbox.begin();
+  OutboxEntry entries[3];
+  TEST_ASSERT_EQUAL_UINT16(3, outbox.read(entries, 3));
+  TEST_ASSERT_EQUAL_UINT32(seq - 1, entries[0].seq);
+  TEST_ASSERT_EQUAL_UINT32(0, entries[1].seq); // comes back blank, the caller pops it unsent
+  TEST_ASSERT_EQUAL_UINT32(0, entries[1].time);
+  TEST_ASSERT_EQUAL_UINT32(seq + 1, entries[2].seq);
+}
+
+static void testBadSentMarkIgnored()
+{
+  fillOutbox();
+  {
+    Outbox outbox;
+    outbox.begin();
+    outbox.pop(100);
+  }
+  (*fakeFiles["/outbox.sent"])[0] ^= 1;
+  Outbox outbox;
+  outbox.begin();
+  TEST_ASSERT_EQUAL_UINT32(OUTBOX_CAPACITY, outbox.pending()); // sent again rather than lost
+}
+
+void runOutboxTests()
+{
+  RUN_TEST(testOverwritesOldest);
+  RUN_TEST(testPopPersists);
+  RUN_TEST(testBadRecord);
+  RUN_TEST(testBadSentMarkIgnored);
+}
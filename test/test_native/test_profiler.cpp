@@ -0,0 +1,58 @@
+#include <unity.h>
+#include "Tests.h"
+#include <Profiler.h>
+
+static void testMicrosAtEitherClock()
+{
+  Profiler profiler;
+  profiler.record(PROFILE_ISR, 1600); // 10 µs at 160 MHz
+  profiler.setClock(80);
+  profiler.record(PROFILE_ISR, 800);  // 10 µs at 80 MHz
+  profiler.record(PROFILE_ISR, 2400);
+  profiler.setClock(160);
+  profiler.record(PROFILE_ISR, 4800);
+  const SectionStats &s = profiler.section(PROFILE_ISR);
+  TEST_ASSERT_EQUAL_UINT32(4, s.count);
+  TEST_ASSERT_EQUAL_UINT32(10, s.min);
+  TEST_ASSERT_EQUAL_UINT32(30, s.max);
+  TEST_ASSERT_EQUAL_UINT32(80, s.total);
+  TEST_ASSERT_EQUAL_UINT16(2, s.histogram[3]); // 10 µs
+  TEST_ASSERT_EQUAL_UINT16(2, s.histogram[4]); // 30 µs
+}
+
+static void testScope()
+{
+  Profiler profiler;
+  fakeCycles = 0xFFFFF000; // the counter wraps inside the scope
+  {
+    ProfileScope scope(profiler, PROFILE_LOOP);
+    fakeCycles += 160000;
+  }
+  TEST_ASSERT_EQUAL_UINT32(1000, profiler.section(PROFILE_LOOP).max);
+
+  StringPrint out;
+  profiler.report(out);
+  TEST_ASSERT_EQUAL_STRING("loop   n 1 us 1000/1000/1000 | 9:1\r\n", out.text.c_str());
+}
+
+static void testRounding()
+{
+  Profiler profiler;
+  for (uint32_t mhz = 80; mhz <= 160; mhz += 80)
+  {
+    profiler.setClock(mhz);
+    for (uint32_t micros = 0; micros < 100000; micros += 997)
+    {
+      profiler.reset();
+      profiler.record(PROFILE_BIN, micros * mhz + mhz - 1); // just short of the next µs
+      TEST_ASSERT_EQUAL_UINT32(micros, profiler.section(PROFILE_BIN).max);
+    }
+  }
+}
+
+void runProfilerTests()
+{
+  RUN_TEST(testMicrosAtEitherClock);
+  RUN_TEST(testScope);
+  RUN_TEST(testRounding);
+}
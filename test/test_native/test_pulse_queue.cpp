@@ -0,0 +1,114 @@
+#include <unity.h>
+#include "Tests.h"
+#include "PulseQueue.h"
+#include <atomic>
+#include <thread>
+
+static PulseQueue queue;
+
+static void testWrap()
+{
+  queue = PulseQueue();
+  uint32_t out[100];
+  uint32_t next = 1, expected = 1;
+  for (uint16_t round = 0; round < 50; round++) // 50 x 73 pushes goes round the ring several times
+  {
+    for (uint8_t i = 0; i < 73; i++)
+      queue.push(next++);
+    TEST_ASSERT_EQUAL_UINT16(73, queue.pending());
+    uint16_t n = queue.drain(out, 100);
+    TEST_ASSERT_EQUAL_UINT16(73, n);
+    for (uint16_t i = 0; i < n; i++)
+      TEST_ASSERT_EQUAL_UINT32(expected++, out[i]);
+  }
+  TEST_ASSERT_EQUAL_UINT16(0, queue.pending());
+  TEST_ASSERT_EQUAL_UINT32(next - 1, queue.snapshot().total);
+  TEST_ASSERT_EQUAL_UINT32(0, queue.snapshot().overflows);
+}
+
+static void testDrainLimit()
+{
+  queue = PulseQueue();
+  uint32_t out[10];
+  for (uint32_t i = 0; i < 25; i++)
+    queue.push(i);
+  TEST_ASSERT_EQUAL_UINT16(10, queue.drain(out, 10));
+  TEST_ASSERT_EQUAL_UINT32(9, out[9]);
+  TEST_ASSERT_EQUAL_UINT16(15, queue.pending());
+  TEST_ASSERT_EQUAL_UINT16(10, queue.drain(out, 10));
+  TEST_ASSERT_EQUAL_UINT32(10, out[0]);
+}
+
+static void testOverflow()
+{
+  queue = PulseQueue();
+  for (uint32_t i = 1; i <= 600; i++)
+    queue.push(i);
+
+  PulseSnapshot s = queue.snapshot();
+  TEST_ASSERT_EQUAL_UINT32(600, s.total); // every pulse is counted
+  TEST_ASSERT_EQUAL_UINT32(600 - (PULSE_QUEUE_SIZE - 1), s.overflows); // one slot stays empty
+  TEST_ASSERT_EQUAL_UINT32(600, s.lastStamp);
+  TEST_ASSERT_EQUAL_UINT16(PULSE_QUEUE_SIZE - 1, queue.pending());
+
+  static uint32_t out[PULSE_QUEUE_SIZE];
+  uint16_t n = queue.drain(out, PULSE_QUEUE_SIZE);
+  TEST_ASSERT_EQUAL_UINT16(PULSE_QUEUE_SIZE - 1, n);
+  TEST_ASSERT_EQUAL_UINT32(1, out[0]); // the oldest are kept, the newest timestamps are dropped
+  TEST_ASSERT_EQUAL_UINT32(PULSE_QUEUE_SIZE - 1, out[n - 1]);
+
+  queue.push(601); // room again after the drain
+  TEST_ASSERT_EQUAL_UINT16(1, queue.drain(out, PULSE_QUEUE_SIZE));
+  TEST_ASSERT_EQUAL_UINT32(601, out[0]);
+}
+
+static void testLockout()
+{
+  queue = PulseQueue();
+  queue.lockout = 100;
+  TEST_ASSERT_TRUE(queue.pulse(1000));
+  TEST_ASSERT_FALSE(queue.pulse(1050)); // ringing
+  TEST_ASSERT_FALSE(queue.pulse(1120)); // measured from the previous edge, not the previous pulse
+  TEST_ASSERT_TRUE(queue.pulse(1300));
+  TEST_ASSERT_TRUE(queue.pulse(0xFFFFFFF0u));
+  TEST_ASSERT_TRUE(queue.pulse(200)); // across the cycle counter wrap
+  TEST_ASSERT_FALSE(queue.pulse(250));
+  TEST_ASSERT_EQUAL_UINT32(4, queue.snapshot().total);
+}
+
+static void testSnapshotConsistent()
+{
+  // a writer thread stands in for the ISR. The stamp of pulse n is n and nothing is drained, so a consistent
+  // snapshot always has lastStamp == total and the overflows that follow from it
+  queue = PulseQueue();
+  const uint32_t pulses = 2000000;
+  std::atomic<bool> done(false);
+  std::thread writer([&] {
+    for (uint32_t i = 1; i <= pulses; i++)
+      queue.push(i);
+    done = true;
+  });
+
+  uint32_t reads = 0, previous = 0;
+  while (!done || reads == 0)
+  {
+    PulseSnapshot s = queue.snapshot();
+    uint32_t overflows = s.total > PULSE_QUEUE_SIZE - 1 ? s.total - (PULSE_QUEUE_SIZE - 1) : 0;
+    TEST_ASSERT_EQUAL_UINT32(s.total, s.lastStamp);
+    TEST_ASSERT_EQUAL_UINT32(overflows, s.overflows);
+    TEST_ASSERT_GREATER_OR_EQUAL(previous, s.total);
+    previous = s.total;
+    reads++;
+  }
+  writer.join();
+  TEST_ASSERT_EQUAL_UINT32(pulses, queue.snapshot().total);
+}
+
+void runPulseQueueTests()
+{
+  RUN_TEST(testWrap);
+  RUN_TEST(testDrainLimit);
+  RUN_TEST(testOverflow);
+  RUN_TEST(testLockout);
+  RUN_TEST(testSnapshotConsistent);
+}
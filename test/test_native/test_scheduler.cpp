@@ -0,0 +1,91 @@
+#include <unity.h>
+#include "Tests.h"
+#include <Scheduler.h>
+
+static uint32_t fastRuns;
+static uint32_t slowRuns;
+static uint32_t lastFastRun;
+
+static void fastTask()
+{
+  fastRuns++;
+  lastFastRun = millis();
+}
+
+static void slowTask()
+{
+  slowRuns++;
+}
+
+static void resetTasks(uint32_t start)
+{
+  fakeMillis = start;
+  fastRuns = 0;
+  slowRuns = 0;
+}
+
+static void testPeriodicRuns()
+{
+  resetTasks(0);
+  Scheduler scheduler;
+  int8_t fast = scheduler.add("fast", fastTask, 100, 20, 0);
+  int8_t slow = scheduler.add("slow", slowTask, 5000, 100, 5000); // the wheel goes round several times between runs
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.untilNext());
+  for (; fakeMillis < 20000; fakeMillis += 3)
+    scheduler.run();
+  TEST_ASSERT_EQUAL_UINT32(200, fastRuns);
+  TEST_ASSERT_EQUAL_UINT32(3, slowRuns); // at 5, 10 and 15 s
+  TEST_ASSERT_LESS_THAN_UINT32(3, scheduler.task(fast).maxLate);
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.task(fast).overruns);
+  TEST_ASSERT_EQUAL_UINT32(0, scheduler.task(slow).skipped);
+}
+
+static void testLateRunSkipsMissedPeriods()
+{
+  resetTasks(1000);
+  Scheduler scheduler;
+  int8_t fast = scheduler.add("fast", fastTask, 100, 20, 0);
+  scheduler.run();
+  fakeMillis = 1350; // loop() was held up, runs due at 1100, 1200 and 1300 were missed
+  scheduler.run();
+  TEST_ASSERT_EQUAL_UINT32(2, fastRuns);
+  TEST_ASSERT_EQUAL_UINT32(1, scheduler.task(fast).overruns);
+  TEST_ASSERT_EQUAL_UINT32(250, scheduler.task(fast).maxLate);
+  TEST_ASSERT_EQUAL_UINT32(2, scheduler.task(fast).skipped);
+  TEST_ASSERT_EQUAL_UINT32(50, scheduler.untilNext()); // back on the grid at 1400, no burst to catch up
+  fakeMillis = 1400;
+  scheduler.run();
+  TEST_ASSERT_EQUAL_UINT32(3, fastRuns);
+  TEST_ASSERT_EQUAL_UINT32(1400, lastFastRun);
+}
+
+static void testSparseCalls()
+{
+  resetTasks(0xFFFFF000); // millis() wraps during the test
+  Scheduler scheduler;
+  scheduler.add("fast", fastTask, 300, 20, 0);
+  for (uint8_t i = 0; i < 20; i++)
+  {
+    scheduler.run();
+    fakeMillis += 1000; // more than a turn of the wheel between calls
+  }
+  TEST_ASSERT_EQUAL_UINT32(20, fastRuns);
+}
+
+static void testFull()
+{
+  resetTasks(0);
+  Scheduler scheduler;
+  for (uint8_t i = 0; i < SCHEDULER_MAX_TASKS; i++)
+    TEST_ASSERT_EQUAL_INT(i, scheduler.add("task", slowTask, 1000, 0, 0));
+  TEST_ASSERT_EQUAL_INT(-1, scheduler.add("task", slowTask, 1000, 0, 0));
+  TEST_ASSERT_EQUAL_UINT8(SCHEDULER_MAX_TASKS, scheduler.count());
+}
+
+void runSchedulerTests()
+{
+  RUN_TEST(testPeriodicRuns);
+  RUN_TEST(testLateRunSkipsMissedPeriods);
+  RUN_TEST(testSparseCalls);
+  RUN_TEST(testFull);
+}
@@ -0,0 +1,102 @@
+#include <unity.h>
+#include "Tests.h"
+#include <Settings.h>
+#include <Crc32.h>
+#include <stddef.h>
+
+static void testDefaultsWithoutRecord()
+{
+  fakeFiles.clear();
+  Settings settings;
+  TEST_ASSERT_FALSE(settings.load());
+  TEST_ASSERT_EQUAL_UINT16(175, settings.data.conversionFactor);
+  TEST_ASSERT_EQUAL_UINT16(600, settings.data.customWindow);
+}
+
+static void testRoundTrip()
+{
+  fakeFiles.clear();
+  Settings settings;
+  settings.data.conversionFactor = 1000;
+  strcpy(settings.data.ssid, "net");
+  TEST_ASSERT_TRUE(settings.save());
+  uint32_t blob = 42;
+  settings.saveRecord(0, &blob, sizeof(blob));
+  TEST_ASSERT_FALSE(fakeFiles.count("/settings.tmp"));
+
+  Settings loaded;
+  TEST_ASSERT_TRUE(loaded.load());
+  TEST_ASSERT_EQUAL_UINT16(1000, loaded.data.conversionFactor);
+  TEST_ASSERT_EQUAL_STRING("net", loaded.data.ssid);
+  uint32_t read = 0;
+  TEST_ASSERT_TRUE(loaded.loadRecord(0, &read, sizeof(read)));
+  TEST_ASSERT_EQUAL_UINT32(42, read);
+  TEST_ASSERT_FALSE(loaded.loadRecord(1, &read, sizeof(read)));
+  TEST_ASSERT_FALSE(loaded.loadRecord(0, &read, 2)); // stored with another size
+}
+
+static void testUnchangedNotRewritten()
+{
+  fakeFiles.clear();
+  Settings settings;
+  settings.save();
+  std::shared_ptr<FakeFile> before = fakeFiles["/settings"];
+  Settings loaded;
+  loaded.load();
+  TEST_ASSERT_TRUE(loaded.save());
+  TEST_ASSERT_TRUE(fakeFiles["/settings"] == before);
+  loaded.data.alarmThreshold++;
+  TEST_ASSERT_TRUE(loaded.save());
+  TEST_ASSERT_FALSE(fakeFiles["/settings"] == before);
+}
+
+static void testCorruptRecord()
+{
+  fakeFiles.clear();
+  Settings settings;
+  settings.data.conversionFactor = 1000;
+  settings.save();
+  (*fakeFiles["/settings"])[sizeof(SettingsHeader) + 4] ^= 1;
+  Settings loaded;
+  TEST_ASSERT_FALSE(loaded.load());
+  TEST_ASSERT_EQUAL_UINT16(175, loaded.data.conversionFactor);
+}
+
+static void testShorterOlderRecord()
+{
+  fakeFiles.clear();
+  Settings settings;
+  settings.data.alarmThreshold = 9;
+  settings.data.customWindow = 60;
+  settings.save();
+
+  // cut back to what version 3 wrote, before customWindow
+  FakeFile &file = *fakeFiles["/settings"];
+  SettingsHeader header;
+  memcpy(&header, file.data(), sizeof(header));
+  header.version = 3;
+  header.bytes = offsetof(SettingsData, customWindow);
+  file.resize(sizeof(header) + header.bytes);
+  header.crc = crc32(file.data() + sizeof(header), header.bytes, crc32(&header, offsetof(SettingsHeader, crc)));
+  memcpy(file.data(), &header, sizeof(header));
+
+  Settings loaded;
+  TEST_ASSERT_TRUE(loaded.load());
+  TEST_ASSERT_EQUAL_UINT8(9, loaded.data.alarmThreshold);
+  TEST_ASSERT_EQUAL_UINT16(600, loaded.data.customWindow);
+  TEST_ASSERT_EQUAL_UINT32(30000, loaded.data.ttcSwitchCpm);
+
+  TEST_ASSERT_TRUE(loaded.save()); // rewritten in the current layout although nothing changed
+  memcpy(&header, fakeFiles["/settings"]->data(), sizeof(header));
+  TEST_ASSERT_EQUAL_UINT8(SETTINGS_VERSION, header.version);
+  TEST_ASSERT_EQUAL_UINT16(sizeof(SettingsData), header.bytes);
+}
+
+void runSettingsTests()
+{
+  RUN_TEST(testDefaultsWithoutRecord);
+  RUN_TEST(testRoundTrip);
+  RUN_TEST(testUnchangedNotRewritten);
+  RUN_TEST(testCorruptRecord);
+  RUN_TEST(testShorterOlderRecord);
+}
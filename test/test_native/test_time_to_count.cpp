@@ -0,0 +1,158 @@
+#include <unity.h>
+#include "Tests.h"
+#include "TimeToCount.h"
+
+#define CYCLES_PER_MICRO 160
+
+static TimeToCount ttc;
+
+static void testEvenPulses()
+{
+  ttc = TimeToCount();
+  ttc.begin(CYCLES_PER_MICRO);
+  ttc.start(101, false);
+  uint32_t stamp = 0xFFFF0000u; // wraps during the block
+  for (uint8_t i = 0; i < 101; i++)
+  {
+    ttc.addPulse(stamp);
+    stamp += 1000 * CYCLES_PER_MICRO; // 1 ms apart
+  }
+  TEST_ASSERT_EQUAL_UINT32(1, ttc.results());
+  TEST_ASSERT_FALSE(ttc.running());
+  TEST_ASSERT_EQUAL_UINT32(100000, ttc.durationMicros());
+  TEST_ASSERT_EQUAL_UINT32(99 * 60000000ULL / 100000, ttc.cpm(0)); // (k - 1) / T
+  // 100 intervals of 50 us dead time leave 95 ms live
+  TEST_ASSERT_EQUAL_UINT32((99 * 60000000ULL + 47500) / 95000, ttc.cpm(50000));
+  TEST_ASSERT_FLOAT_WITHIN(1e-4, 1 / sqrt(98.0), ttc.relativeError());
+}
+
+static void testRepeatChainsBlocks()
+{
+  ttc = TimeToCount();
+  ttc.begin(CYCLES_PER_MICRO);
+  ttc.start(11, true);
+  uint32_t stamp = 0;
+  for (uint8_t i = 0; i < 31; i++) // the last pulse of a block starts the next, so 3 blocks of 10 intervals
+  {
+    ttc.addPulse(stamp);
+    stamp += (i < 11 ? 1000 : 2000) * CYCLES_PER_MICRO;
+  }
+  TEST_ASSERT_EQUAL_UINT32(3, ttc.results());
+  TEST_ASSERT_TRUE(ttc.running());
+  TEST_ASSERT_EQUAL_UINT32(20000, ttc.durationMicros());
+  TEST_ASSERT_EQUAL_UINT16(1, ttc.collected());
+}
+
+static void testPoissonMean()
+{
+  ttc = TimeToCount();
+  ttc.begin(CYCLES_PER_MICRO);
+  ttc.start(100, true);
+  TestRandom random(11);
+  const double cps = 500;
+  double t = 0;
+  uint64_t sum = 0;
+  uint32_t blocks = 0, seen = 0;
+  while (blocks < 400)
+  {
+    ttc.addPulse((uint32_t)(uint64_t)(t * CYCLES_PER_MICRO));
+    t += random.exponential(1e6 / cps);
+    if (ttc.results() != seen)
+    {
+      seen = ttc.results();
+      sum += ttc.cpm(0);
+      blocks++;
+    }
+  }
+  TEST_ASSERT_UINT32_WITHIN(cps * 60 * 0.01, cps * 60, sum / blocks); // unbiased, 0.5 % expected spread of the mean
+}
+
+static void testRunningEstimate()
+{
+  ttc = TimeToCount();
+  ttc.begin(CYCLES_PER_MICRO);
+  ttc.start(1000, false);
+  ttc.addPulse(0);
+  ttc.addPulse(1000 * CYCLES_PER_MICRO);
+  TEST_ASSERT_EQUAL_UINT32(0, ttc.runningCpm(0)); // too few intervals
+  for (uint8_t i = 2; i <= 10; i++)
+    ttc.addPulse(i * 1000 * CYCLES_PER_MICRO);
+  TEST_ASSERT_EQUAL_UINT32(9 * 60000000ULL / 10000, ttc.runningCpm(0));
+  TEST_ASSERT_EQUAL_UINT32(0, ttc.results());
+}
+
+static void testResyncAndRebase()
+{
+  ttc = TimeToCount();
+  ttc.begin(CYCLES_PER_MICRO);
+  ttc.start(3, false);
+  ttc.addPulse(0);
+  ttc.addPulse(1000 * CYCLES_PER_MICRO);
+  ttc.resync(); // lost pulses, the block starts over
+  TEST_ASSERT_EQUAL_UINT16(0, ttc.collected());
+
+  ttc.addPulse(5000 * CYCLES_PER_MICRO);
+  ttc.addPulse(6000 * CYCLES_PER_MICRO);
+  ttc.rebase(6500 * CYCLES_PER_MICRO, 100, 80); // 160 to 80 MHz half a millisecond after the last pulse
+  ttc.addPulse(100 + 500 * 80);
+  TEST_ASSERT_EQUAL_UINT32(1, ttc.results());
+  TEST_ASSERT_EQUAL_UINT32(2000, ttc.durationMicros());
+}
+
+static void testSetTargetBelowCollected()
+{
+  ttc = TimeToCount();
+  ttc.begin(CYCLES_PER_MICRO);
+  ttc.start(100, true);
+  for (uint8_t i = 0; i < 20; i++)
+    ttc.addPulse(i * 1000 * CYCLES_PER_MICRO);
+  ttc.setTarget(10); // already past it, the block ends on the next pulse
+  ttc.addPulse(20 * 1000 * CYCLES_PER_MICRO);
+  TEST_ASSERT_EQUAL_UINT32(1, ttc.results());
+  TEST_ASSERT_EQUAL_UINT16(20, ttc.intervals());
+  TEST_ASSERT_EQUAL_UINT16(10, ttc.target());
+}
+
+static void testHistoryCombinesWindow()
+{
+  static TimeToCountHistory history;
+  history = TimeToCountHistory();
+  ttc = TimeToCount();
+  ttc.begin(CYCLES_PER_MICRO);
+  ttc.start(11, true);
+  uint32_t seen = 0;
+  for (uint32_t i = 0; i <= 40; i++) // 4 blocks of 10 intervals, 1 ms apart. Block b ends at (b + 1) * 10 ms
+  {
+    ttc.addPulse(i * 1000 * CYCLES_PER_MICRO);
+    if (ttc.results() != seen)
+    {
+      seen = ttc.results();
+      history.add(ttc, i);
+    }
+  }
+
+  uint32_t cpm, intervals;
+  TEST_ASSERT_TRUE(history.combine(40, 100, 0, cpm, intervals));
+  TEST_ASSERT_EQUAL_UINT32(40, intervals);
+  TEST_ASSERT_EQUAL_UINT32(39 * 60000000ULL / 40000, cpm); // one 40 interval block
+  TEST_ASSERT_TRUE(history.combine(40, 15, 0, cpm, intervals)); // only the blocks that ended at 30 and 40 ms
+  TEST_ASSERT_EQUAL_UINT32(20, intervals);
+  TEST_ASSERT_FALSE(history.combine(100, 15, 0, cpm, intervals)); // none ended in the last 15 ms
+
+  for (uint32_t i = 0; i < TTC_HISTORY_BLOCKS + 5; i++) // the ring keeps the newest blocks
+    history.add(ttc, 1000 + i);
+  TEST_ASSERT_TRUE(history.combine(2000, 5000, 0, cpm, intervals));
+  TEST_ASSERT_EQUAL_UINT32(TTC_HISTORY_BLOCKS * 10, intervals);
+  TEST_ASSERT_FLOAT_WITHIN(1e-6, 1 / sqrt(TTC_HISTORY_BLOCKS * 10 - 2.0), timeToCountError(intervals));
+}
+
+void runTimeToCountTests()
+{
+  RUN_TEST(testEvenPulses);
+  RUN_TEST(testRepeatChainsBlocks);
+  RUN_TEST(testPoissonMean);
+  RUN_TEST(testRunningEstimate);
+  RUN_TEST(testResyncAndRebase);
+  RUN_TEST(testSetTargetBelowCollected);
+  RUN_TEST(testHistoryCombinesWindow);
+}
@@ -0,0 +1,68 @@
+#include <unity.h>
+#include "Tests.h"
+#include <TouchInput.h>
+#include <algorithm>
+#include <string>
+
+static XPT2046_Touchscreen panel;
+
+static std::string events(TouchInput &input, bool pressed, uint32_t millis) // polls every 10 ms, returns P R L and r
+{
+  panel.pressed = pressed;
+  std::string seen;
+  for (uint32_t t = 0; t < millis; t += 10)
+  {
+    fakeMillis += 10;
+    input.poll(fakeMillis);
+    TouchEvent event;
+    while (input.next(event))
+      seen += "PRLr"[event.type];
+  }
+  return seen;
+}
+
+static void testTap()
+{
+  fakeMillis = 1000;
+  TouchInput input(panel, 0, 4000, 0, 4000, 240, 320);
+  TEST_ASSERT_EQUAL_STRING("P", events(input, true, 150).c_str()); // the press comes at touch-down
+  TEST_ASSERT_EQUAL_STRING("R", events(input, false, 100).c_str());
+}
+
+static void testHold()
+{
+  fakeMillis = 1000;
+  TouchInput input(panel, 0, 4000, 0, 4000, 240, 320);
+  std::string held = events(input, true, TOUCH_LONG_PRESS_MILLIS + 50);
+  held.erase(std::remove(held.begin(), held.end(), 'r'), held.end()); // the repeats don't matter here
+  TEST_ASSERT_EQUAL_STRING("PL", held.c_str()); // the press before anything tells a hold from a tap
+  TEST_ASSERT_EQUAL_STRING("R", events(input, false, 100).c_str());
+}
+
+static void testShortDipIsNoRelease()
+{
+  fakeMillis = 1000;
+  TouchInput input(panel, 0, 4000, 0, 4000, 240, 320);
+  events(input, true, 100);
+  TEST_ASSERT_EQUAL_STRING("", events(input, false, TOUCH_RELEASE_MILLIS - 20).c_str());
+  TEST_ASSERT_EQUAL_STRING("", events(input, true, 100).c_str());
+}
+
+static void testCancel()
+{
+  fakeMillis = 1000;
+  TouchInput input(panel, 0, 4000, 0, 4000, 240, 320);
+  events(input, true, 100);
+  input.cancel(); // a page change: nothing more from this touch, not even its release
+  TEST_ASSERT_EQUAL_STRING("", events(input, true, TOUCH_LONG_PRESS_MILLIS).c_str());
+  TEST_ASSERT_EQUAL_STRING("", events(input, false, 100).c_str());
+  TEST_ASSERT_EQUAL_STRING("P", events(input, true, 100).c_str());
+}
+
+void runTouchInputTests()
+{
+  RUN_TEST(testTap);
+  RUN_TEST(testHold);
+  RUN_TEST(testShortDipIsNoRelease);
+  RUN_TEST(testCancel);
+}
@@ -0,0 +1,111 @@
+#include <unity.h>
+#include "Tests.h"
+#include <WifiLink.h>
+
+static void poll(WifiLink &link, uint32_t millis) // every 10 ms, as from loop()
+{
+  for (uint32_t t = 0; t < millis; t += 10)
+  {
+    fakeMillis += 10;
+    link.poll(fakeMillis);
+  }
+}
+
+static void resetRouter()
+{
+  WiFi = ESP8266WiFiClass();
+  fakeMillis = 0;
+}
+
+static void testScanThenCache()
+{
+  resetRouter();
+  WifiLink link;
+  WifiCache empty = {};
+  link.begin("net", "secret", empty);
+  poll(link, FAKE_WIFI_SCAN_MILLIS + 100);
+  TEST_ASSERT_TRUE(link.up());
+  TEST_ASSERT_EQUAL_UINT32(1, link.connects);
+  TEST_ASSERT_EQUAL_UINT32(0, link.fastAttempts);
+  TEST_ASSERT_TRUE(link.cacheChanged());
+  TEST_ASSERT_FALSE(link.cacheChanged()); // once
+  TEST_ASSERT_EQUAL_UINT8(6, link.cache().channel);
+  TEST_ASSERT_EQUAL_MEMORY(WiFi.routerBssid, link.cache().bssid, 6);
+
+  WiFi.linked = false; // dropped, back at once with the cache
+  poll(link, 1000);
+  TEST_ASSERT_TRUE(link.up());
+  TEST_ASSERT_EQUAL_UINT32(1, link.drops);
+  TEST_ASSERT_EQUAL_UINT32(1, link.fastConnects);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(FAKE_WIFI_FAST_MILLIS + 20, link.lastConnectMillis);
+  TEST_ASSERT_FALSE(link.cacheChanged());
+}
+
+static void testRouterMoved()
+{
+  resetRouter();
+  WifiLink link;
+  WifiCache cached = {{2, 0, 0, 0, 0, 1}, 6};
+  WiFi.routerChannel = 11;
+  link.begin("net", "secret", cached);
+  poll(link, WIFI_FAST_CONNECT_MILLIS + FAKE_WIFI_SCAN_MILLIS + 100); // the cached attempt fails, a scan follows
+  TEST_ASSERT_TRUE(link.up());
+  TEST_ASSERT_EQUAL_UINT32(2, link.attempts);
+  TEST_ASSERT_EQUAL_UINT32(0, link.fastConnects);
+  TEST_ASSERT_TRUE(link.cacheChanged());
+  TEST_ASSERT_EQUAL_UINT8(11, link.cache().channel);
+}
+
+static void testBackoff()
+{
+  resetRouter();
+  WifiLink link;
+  WifiCache empty = {};
+  link.begin("net", "secret", empty);
+  poll(link, FAKE_WIFI_SCAN_MILLIS + 100);
+  WiFi.routerUp = false;
+  uint32_t before = WiFi.begins;
+  poll(link, 600000);
+  TEST_ASSERT_FALSE(link.up());
+  // a pair of attempts, cached then scan, per round: after 1, 2, 4 ... 256 s, then every 300 s
+  TEST_ASSERT_LESS_THAN_UINT32(24, WiFi.begins - before);
+  TEST_ASSERT_GREATER_THAN_UINT32(10, WiFi.begins - before);
+
+  WiFi.routerUp = true;
+  poll(link, WIFI_BACKOFF_MAX_MILLIS + WIFI_CONNECT_MILLIS + 1000);
+  TEST_ASSERT_TRUE(link.up());
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(FAKE_WIFI_FAST_MILLIS + 20, link.lastConnectMillis); // the cache first, no scan
+
+  WiFi.routerUp = false; // a short outage starts again from the shortest wait
+  poll(link, WIFI_FAST_CONNECT_MILLIS + WIFI_CONNECT_MILLIS + 100);
+  WiFi.routerUp = true;
+  poll(link, WIFI_BACKOFF_MIN_MILLIS + FAKE_WIFI_FAST_MILLIS + 100);
+  TEST_ASSERT_TRUE(link.up());
+}
+
+static void testEndAndReport()
+{
+  resetRouter();
+  WifiLink link;
+  WifiCache empty = {};
+  link.begin("net", "secret", empty);
+  poll(link, FAKE_WIFI_SCAN_MILLIS + 100);
+  link.end();
+  uint32_t before = WiFi.begins;
+  poll(link, 10000);
+  TEST_ASSERT_FALSE(link.up());
+  TEST_ASSERT_EQUAL_UINT32(before, WiFi.begins); // off stays off
+
+  StringPrint out;
+  link.report(out);
+  TEST_ASSERT_EQUAL_STRING("wifi down: 1/1 connects (0/0 fast), 0 drops, connect ms last 2500 min 2500 avg 2500 max 2500\r\n",
+                           out.text.c_str());
+}
+
+void runWifiLinkTests()
+{
+  RUN_TEST(testScanThenCache);
+  RUN_TEST(testRouterMoved);
+  RUN_TEST(testBackoff);
+  RUN_TEST(testEndAndReport);
+}